@@ -1,5 +1,7 @@
 #!/bin/bash
-# Download WMATA Rail GTFS static data and extract shapes
+# Download WMATA Rail GTFS static data to data/gtfs.zip, where the server and gtfs_geojson read it
+# the archive is read in place, there is no need to extract it; run from the folder the server runs in
+# the download goes to a .part file first, so a running server never sees a partial archive
 # Usage: ./get.sh YOUR_API_KEY
 set -e 
 
@@ -10,9 +12,9 @@ fi
 
 API_KEY="$1"
 GTFS_URL="https://api.wmata.com/gtfs/rail-gtfs-static.zip"
-OUTPUT_DIR="gtfs"
+OUTPUT_DIR="data"
 ZIP_FILE="gtfs.zip"
 
 mkdir -p "$OUTPUT_DIR"
-curl -# -L -H "api_key: ${API_KEY}" -o "${OUTPUT_DIR}/${ZIP_FILE}" "${GTFS_URL}"
-unzip -q -o "${OUTPUT_DIR}/${ZIP_FILE}" -d "${OUTPUT_DIR}"
+curl -# -f -L -H "api_key: ${API_KEY}" -o "${OUTPUT_DIR}/${ZIP_FILE}.part" "${GTFS_URL}"
+mv -f "${OUTPUT_DIR}/${ZIP_FILE}.part" "${OUTPUT_DIR}/${ZIP_FILE}"
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <algorithm>
+#include "api.hh"
+#include "plan.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// ApiResource::ApiResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ApiResource::ApiResource(api_kind_t kind_, const std::shared_ptr<const train_update_t>& trains_,
+  const std::shared_ptr<const reference_data_t>& reference_, const std::function<std::chrono::seconds()>& refresh_) :
+  kind(kind_),
+  trains(trains_),
+  reference(reference_),
+  refresh(refresh_)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// ApiResource::~ApiResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ApiResource::~ApiResource()
+{
+  beingDeleted();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// ApiResource::handleRequest
+// called concurrently from the server threads; the snapshot is held for the whole request, so a
+// publication cannot swap it while its bytes are written
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ApiResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+  if (kind == api_trains)
+  {
+    std::shared_ptr<const train_update_t> update = std::atomic_load(&trains);
+    if (!update)
+    {
+      send_error(response, 503, "no train update published yet");
+      return;
+    }
+    const json_body_t* body = &update->trains;
+    const std::string* line = request.getParameter("line");
+    if (line)
+    {
+      std::map<std::string, json_body_t>::const_iterator it = update->lines.find(*line);
+      if (it == update->lines.end())
+      {
+        send_error(response, 404, "unknown line");
+        return;
+      }
+      body = &it->second;
+    }
+
+    //cacheable until the next publication is due
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    long long age = std::max(0LL, (now - update->time) / 1000);
+    long long max_age = std::max(0LL, static_cast<long long>(refresh().count()) - age);
+    send_json_body(request, response, *body, max_age);
+    return;
+  }
+
+  std::shared_ptr<const reference_data_t> data = std::atomic_load(&reference);
+  if (!data)
+  {
+    send_error(response, 503, "stations are loading");
+    return;
+  }
+  if (kind == api_stations)
+  {
+    send_json_body(request, response, data->stations, 3600);
+    return;
+  }
+
+  //api_lines: the code is the rest of the path, /api/lines/RD
+  std::string code = request.pathInfo();
+  code.erase(0, code.find_first_not_of('/'));
+  std::map<std::string, json_body_t>::const_iterator it = data->lines.find(code);
+  if (it == data->lines.end())
+  {
+    send_error(response, 404, "unknown line");
+    return;
+  }
+  send_json_body(request, response, it->second, 3600);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// send_json_body
+// 304 when If-None-Match names the body's ETag, else the body, gzip compressed when the client
+// accepts it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void send_json_body(const Wt::Http::Request& request, Wt::Http::Response& response, const json_body_t& body, long long max_age)
+{
+  response.addHeader("ETag", body.etag);
+  response.addHeader("Cache-Control", "public, max-age=" + std::to_string(max_age));
+  response.addHeader("Vary", "Accept-Encoding");
+  response.addHeader("Access-Control-Allow-Origin", "*");
+
+  std::string if_none_match = request.headerValue("If-None-Match");
+  if (!if_none_match.empty() && (if_none_match == "*" || if_none_match.find(body.etag) != std::string::npos))
+  {
+    response.setStatus(304);
+    return;
+  }
+
+  response.setStatus(200);
+  response.setMimeType("application/json");
+  bool gzip = !body.json_gz.empty() && request.headerValue("Accept-Encoding").find("gzip") != std::string::npos;
+  const std::string& data = gzip ? body.json_gz : body.json;
+  if (gzip)
+  {
+    response.addHeader("Content-Encoding", "gzip");
+  }
+  response.setContentLength(data.size());
+  response.out().write(data.data(), static_cast<std::streamsize>(data.size()));
+}
@@ -0,0 +1,63 @@
+#ifndef API_HH
+#define API_HH
+
+#include <string>
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <Wt/WResource.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include "update.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// reference_data_t
+// bodies of /api/stations and /api/lines/{code}; rendered at startup, and again when a GTFS reload
+// changes a line
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct reference_data_t
+{
+  json_body_t stations;
+  std::map<std::string, json_body_t> lines; //GeoJSON by line code
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// ApiResource
+// session-free JSON API for boards and services that do not need the map; no WApplication is created
+//   GET /api/trains[?line=RD]   train positions of the last update, of all lines or of one
+//   GET /api/stations           stations of every line
+//   GET /api/lines/{code}       GeoJSON of a line
+// every body is rendered once when it is published, so a request only picks one: 304 for a
+// matching If-None-Match, the gzip copy for clients that accept it, and a max-age that lasts until
+// the next publication is due (refresh() after the last one for trains, an hour for the rest)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum api_kind_t
+{
+  api_trains,
+  api_stations,
+  api_lines
+};
+
+class ApiResource : public Wt::WResource
+{
+public:
+  ApiResource(api_kind_t kind, const std::shared_ptr<const train_update_t>& trains,
+    const std::shared_ptr<const reference_data_t>& reference, const std::function<std::chrono::seconds()>& refresh);
+  virtual ~ApiResource();
+
+protected:
+  virtual void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+  api_kind_t kind;
+  const std::shared_ptr<const train_update_t>& trains; //read with std::atomic_load
+  const std::shared_ptr<const reference_data_t>& reference; //read with std::atomic_load
+  std::function<std::chrono::seconds()> refresh; //expected time between two train publications
+};
+
+void send_json_body(const Wt::Http::Request& request, Wt::Http::Response& response, const json_body_t& body, long long max_age);
+
+#endif
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <limits>
+#include "calendar.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// days_from_date
+// yyyymmdd to days since 1970-01-01 (proleptic Gregorian)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t days_from_date(int32_t date)
+{
+  int32_t y = date / 10000;
+  int32_t m = (date / 100) % 100;
+  int32_t d = date % 100;
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// date_from_days
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t date_from_days(int32_t days)
+{
+  days += 719468;
+  int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int32_t doe = days - era * 146097;
+  int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t y = yoe + era * 400;
+  int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int32_t mp = (5 * doy + 2) / 153;
+  int32_t d = doy - (153 * mp + 2) / 5 + 1;
+  int32_t m = mp < 10 ? mp + 3 : mp - 9;
+  y += m <= 2;
+  return y * 10000 + m * 100 + d;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_date
+// struct tm to yyyymmdd
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t gtfs_date(const struct tm& tm)
+{
+  return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// add_days
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t add_days(int32_t date, int nbr_days)
+{
+  return date_from_days(days_from_date(date) + nbr_days);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// weekday
+// 0 monday .. 6 sunday of a day number; 1970-01-01 was a thursday
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int weekday(int32_t days)
+{
+  return static_cast<int>(((days % 7) + 7 + 3) % 7);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// day_of_week
+// 0 monday .. 6 sunday, the bit order of calendar_table_t::days
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int day_of_week(int32_t date)
+{
+  return weekday(days_from_date(date));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::service_calendar_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+service_calendar_t::service_calendar_t() :
+  gtfs(nullptr),
+  first_day(0),
+  days(0),
+  words(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::build
+// weekly patterns of calendar.txt first, then calendar_dates.txt additions and removals in file
+// order; returns -1 if the feed defines no service dates
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int service_calendar_t::build(const gtfs_t& feed)
+{
+  gtfs = &feed;
+  const calendar_table_t& calendar = gtfs->calendar;
+  const calendar_date_table_t& dates = gtfs->calendar_dates;
+  const size_t nbr_services = gtfs->services.size();
+
+  int32_t lo = std::numeric_limits<int32_t>::max();
+  int32_t hi = std::numeric_limits<int32_t>::min();
+  for (size_t idx = 0; idx < calendar.size(); ++idx)
+  {
+    if (calendar.start_date[idx] > 0 && calendar.end_date[idx] >= calendar.start_date[idx])
+    {
+      lo = std::min(lo, days_from_date(calendar.start_date[idx]));
+      hi = std::max(hi, days_from_date(calendar.end_date[idx]));
+    }
+  }
+  for (size_t idx = 0; idx < dates.size(); ++idx)
+  {
+    if (dates.date[idx] > 0)
+    {
+      lo = std::min(lo, days_from_date(dates.date[idx]));
+      hi = std::max(hi, days_from_date(dates.date[idx]));
+    }
+  }
+
+  first_day = lo <= hi ? lo : 0;
+  days = lo <= hi ? hi - lo + 1 : 0;
+  words = (static_cast<size_t>(days) + 63) / 64;
+  bits.assign(nbr_services * words, 0);
+
+  for (size_t idx = 0; idx < calendar.size(); ++idx)
+  {
+    if (calendar.start_date[idx] <= 0 || calendar.end_date[idx] < calendar.start_date[idx])
+    {
+      continue;
+    }
+    int32_t end = days_from_date(calendar.end_date[idx]);
+    for (int32_t day = days_from_date(calendar.start_date[idx]); day <= end; ++day)
+    {
+      if (calendar.days[idx] & (1 << weekday(day)))
+      {
+        set(calendar.service[idx], day, true);
+      }
+    }
+  }
+  for (size_t idx = 0; idx < dates.size(); ++idx)
+  {
+    if (dates.date[idx] > 0)
+    {
+      set(dates.service[idx], days_from_date(dates.date[idx]), dates.exception_type[idx] == 1);
+    }
+  }
+
+  //trips of each service, in trip order
+  trip_offsets.assign(nbr_services + 1, 0);
+  for (size_t trip = 0; trip < gtfs->trips.size(); ++trip)
+  {
+    uint32_t service = gtfs->trips.service[trip];
+    if (service < nbr_services)
+    {
+      ++trip_offsets[service + 1];
+    }
+  }
+  for (size_t idx = 1; idx < trip_offsets.size(); ++idx)
+  {
+    trip_offsets[idx] += trip_offsets[idx - 1];
+  }
+  trip_list.resize(trip_offsets.back());
+  std::vector<uint32_t> fill(trip_offsets.begin(), trip_offsets.end() - 1);
+  for (uint32_t trip = 0; trip < gtfs->trips.size(); ++trip)
+  {
+    uint32_t service = gtfs->trips.service[trip];
+    if (service < nbr_services)
+    {
+      trip_list[fill[service]++] = trip;
+    }
+  }
+
+  return days > 0 ? 0 : -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::set
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void service_calendar_t::set(uint32_t service, int32_t day, bool value)
+{
+  if (service >= gtfs->services.size() || day < first_day || day - first_day >= days)
+  {
+    return;
+  }
+  size_t bit = static_cast<size_t>(day - first_day);
+  uint64_t& word = bits[service * words + bit / 64];
+  uint64_t mask = static_cast<uint64_t>(1) << (bit % 64);
+  word = value ? word | mask : word & ~mask;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t service_calendar_t::memory() const
+{
+  return bits.capacity() * sizeof(uint64_t) + (trip_offsets.capacity() + trip_list.capacity()) * sizeof(uint32_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::first_date
+// first and last day of the validity window as yyyymmdd, 0 if empty
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t service_calendar_t::first_date() const
+{
+  return days > 0 ? date_from_days(first_day) : 0;
+}
+
+int32_t service_calendar_t::last_date() const
+{
+  return days > 0 ? date_from_days(first_day + days - 1) : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::active
+// true if service runs on date (yyyymmdd)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool service_calendar_t::active(uint32_t service, int32_t date) const
+{
+  if (!gtfs || service >= gtfs->services.size())
+  {
+    return false;
+  }
+  int32_t day = days_from_date(date) - first_day;
+  if (day < 0 || day >= days)
+  {
+    return false;
+  }
+  size_t bit = static_cast<size_t>(day);
+  return (bits[service * words + bit / 64] >> (bit % 64)) & 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::services_on
+// active[service] is 1 if the service runs on date
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void service_calendar_t::services_on(int32_t date, std::vector<uint8_t>& active) const
+{
+  if (!gtfs)
+  {
+    active.clear();
+    return;
+  }
+  const size_t nbr_services = gtfs->services.size();
+  active.assign(nbr_services, 0);
+  int32_t day = days_from_date(date) - first_day;
+  if (day < 0 || day >= days)
+  {
+    return;
+  }
+  size_t bit = static_cast<size_t>(day);
+  for (size_t service = 0; service < nbr_services; ++service)
+  {
+    active[service] = static_cast<uint8_t>((bits[service * words + bit / 64] >> (bit % 64)) & 1);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::service_trips
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+range_t service_calendar_t::service_trips(uint32_t service) const
+{
+  if (trip_offsets.empty() || service >= trip_offsets.size() - 1)
+  {
+    return range_t{ 0, 0 };
+  }
+  return range_t{ trip_offsets[service], trip_offsets[service + 1] };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t::trips_on
+// append the trips running on date, grouped by service; returns the number appended
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t service_calendar_t::trips_on(int32_t date, std::vector<uint32_t>& trips) const
+{
+  size_t nbr_trips = 0;
+  int32_t day = days_from_date(date) - first_day;
+  if (!gtfs || day < 0 || day >= days)
+  {
+    return 0;
+  }
+  size_t bit = static_cast<size_t>(day);
+  for (uint32_t service = 0; service + 1 < trip_offsets.size(); ++service)
+  {
+    if ((bits[service * words + bit / 64] >> (bit % 64)) & 1)
+    {
+      trips.insert(trips.end(), trip_list.begin() + trip_offsets[service], trip_list.begin() + trip_offsets[service + 1]);
+      nbr_trips += trip_offsets[service + 1] - trip_offsets[service];
+    }
+  }
+  return nbr_trips;
+}
@@ -0,0 +1,57 @@
+#ifndef CALENDAR_HH
+#define CALENDAR_HH
+
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include "gtfs.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_calendar_t
+// calendar.txt and calendar_dates.txt compiled into one bitset per service_id, one bit per day of
+// the feed's validity window (the span of every start, end and exception date)
+// active() is a single bit test; dates outside the window are inactive
+// the trips of each service are listed once at build(), so the trips running on a date are the
+// concatenation of a few ranges
+// the gtfs_t must outlive the service_calendar_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class service_calendar_t
+{
+public:
+  service_calendar_t();
+  int build(const gtfs_t& feed);
+  size_t memory() const;
+  int32_t first_date() const;
+  int32_t last_date() const;
+  size_t nbr_days() const { return static_cast<size_t>(days); }
+
+  bool active(uint32_t service, int32_t date) const;
+  void services_on(int32_t date, std::vector<uint8_t>& active) const;
+  range_t service_trips(uint32_t service) const; //into trip_list, ascending
+  size_t trips_on(int32_t date, std::vector<uint32_t>& trips) const;
+
+  std::vector<uint32_t> trip_list;
+
+private:
+  const gtfs_t* gtfs;
+  int32_t first_day; //days since 1970-01-01 of bit 0
+  int32_t days;
+  size_t words; //64 bit words per service
+  std::vector<uint64_t> bits; //service s is bits[s * words .. (s + 1) * words)
+  std::vector<uint32_t> trip_offsets;
+  void set(uint32_t service, int32_t day, bool value);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// dates
+// GTFS dates are yyyymmdd integers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t gtfs_date(const struct tm& tm);
+int32_t days_from_date(int32_t date);
+int32_t date_from_days(int32_t days);
+int32_t add_days(int32_t date, int nbr_days);
+int day_of_week(int32_t date);
+
+#endif
@@ -0,0 +1,514 @@
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "csv.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap_file_t::mmap_file_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+mmap_file_t::mmap_file_t() :
+  buf(nullptr),
+  len(0),
+#ifdef _WIN32
+  file(INVALID_HANDLE_VALUE),
+  mapping(nullptr)
+#else
+  fd(-1)
+#endif
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap_file_t::~mmap_file_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+mmap_file_t::~mmap_file_t()
+{
+  close();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap_file_t::open
+// an empty file opens successfully with size() 0 and data() nullptr
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int mmap_file_t::open(const std::string& file_name)
+{
+  close();
+
+#ifdef _WIN32
+  file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return -1;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size))
+  {
+    close();
+    return -1;
+  }
+  len = static_cast<size_t>(file_size.QuadPart);
+  if (len == 0)
+  {
+    return 0;
+  }
+
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    close();
+    return -1;
+  }
+
+  buf = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!buf)
+  {
+    close();
+    return -1;
+  }
+#else
+  fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close();
+    return -1;
+  }
+  len = static_cast<size_t>(st.st_size);
+  if (len == 0)
+  {
+    return 0;
+  }
+
+  void* ptr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr == MAP_FAILED)
+  {
+    close();
+    return -1;
+  }
+  buf = static_cast<const char*>(ptr);
+  madvise(ptr, len, MADV_SEQUENTIAL);
+#endif
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap_file_t::close
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mmap_file_t::close()
+{
+#ifdef _WIN32
+  if (buf)
+  {
+    UnmapViewOfFile(buf);
+  }
+  if (mapping)
+  {
+    CloseHandle(mapping);
+  }
+  if (file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(file);
+  }
+  mapping = nullptr;
+  file = INVALID_HANDLE_VALUE;
+#else
+  if (buf)
+  {
+    munmap(const_cast<char*>(buf), len);
+  }
+  if (fd >= 0)
+  {
+    ::close(fd);
+  }
+  fd = -1;
+#endif
+  buf = nullptr;
+  len = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::csv_reader_t
+// reads the header record
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+csv_reader_t::csv_reader_t(const char* data, size_t size) :
+  input(data ? data : "", data ? size : 0),
+  body(0),
+  pos(0),
+  nbr_line(0),
+  nbr_newline(0)
+{
+  if (input.size() >= 3 && std::memcmp(input.data(), "\xEF\xBB\xBF", 3) == 0)
+  {
+    pos = 3;
+  }
+
+  read_record(header);
+  header_unescaped.swap(unescaped);
+  body = pos;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::csv_reader_t
+// reader over the byte range [begin, end) of parent's input, with parent's header
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+csv_reader_t::csv_reader_t(const csv_reader_t& parent, size_t begin, size_t end) :
+  input(parent.input.substr(begin, end - begin)),
+  body(0),
+  pos(0),
+  nbr_line(0),
+  nbr_newline(0),
+  header(parent.header)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::split
+// boundaries of nbr_chunks ranges covering the records after the header
+// returns nbr_chunks + 1 offsets (fewer for small inputs); chunk i is [result[i], result[i + 1])
+// boundaries fall after a line break that is outside a quoted field; quote parity is tracked
+// with memchr, which is much cheaper than tokenizing; when the input holds an odd number of
+// quotes the parity cannot be trusted and a single chunk is returned
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<size_t> csv_reader_t::split(size_t nbr_chunks) const
+{
+  std::vector<size_t> bounds;
+  const char* data = input.data();
+  const size_t size = input.size();
+  bounds.push_back(body);
+
+  if (nbr_chunks == 0)
+  {
+    nbr_chunks = 1;
+  }
+
+  const size_t step = (size - body) / nbr_chunks;
+  size_t cursor = body;
+  bool in_quote = false;
+
+  for (size_t idx = 1; idx < nbr_chunks && step > 0; ++idx)
+  {
+    size_t target = body + idx * step;
+    if (target <= cursor)
+    {
+      continue;
+    }
+
+    while (cursor < target)
+    {
+      const void* quote = std::memchr(data + cursor, '"', target - cursor);
+      if (!quote)
+      {
+        cursor = target;
+        break;
+      }
+      in_quote = !in_quote;
+      cursor = static_cast<const char*>(quote) - data + 1;
+    }
+
+    while (cursor < size)
+    {
+      char c = data[cursor++];
+      if (c == '"')
+      {
+        in_quote = !in_quote;
+      }
+      else if (c == '\n' && !in_quote)
+      {
+        break;
+      }
+    }
+
+    if (cursor >= size)
+    {
+      break;
+    }
+    bounds.push_back(cursor);
+  }
+
+  //the tokenizer reads a quote inside an unquoted field as text, parity does not; an odd count at
+  //the end means a stray quote may have moved the boundaries, so parse the body as one chunk
+  if (bounds.size() > 1)
+  {
+    while (cursor < size)
+    {
+      const void* quote = std::memchr(data + cursor, '"', size - cursor);
+      if (!quote)
+      {
+        break;
+      }
+      in_quote = !in_quote;
+      cursor = static_cast<const char*>(quote) - data + 1;
+    }
+    if (in_quote)
+    {
+      bounds.resize(1);
+    }
+  }
+
+  bounds.push_back(size);
+  return bounds;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::chunk
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+csv_reader_t csv_reader_t::chunk(size_t begin, size_t end) const
+{
+  return csv_reader_t(*this, begin, end);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::column
+// index of a header column, -1 if the file does not have it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int csv_reader_t::column(std::string_view name) const
+{
+  for (size_t idx = 0; idx < header.size(); ++idx)
+  {
+    if (header[idx] == name)
+    {
+      return static_cast<int>(idx);
+    }
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::next
+// advance to the next record; false at end of input
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool csv_reader_t::next()
+{
+  unescaped.clear();
+  return read_record(fields);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::field
+// empty for a missing column (idx -1) or a short record
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string_view csv_reader_t::field(int idx) const
+{
+  if (idx < 0 || static_cast<size_t>(idx) >= fields.size())
+  {
+    return std::string_view();
+  }
+  return fields[idx];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::in_input
+// true if a field points into the input buffer, false for an unescaped copy that next() releases
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool csv_reader_t::in_input(std::string_view str) const
+{
+  return str.data() >= input.data() && str.data() + str.size() <= input.data() + input.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::to_double
+// returns value when the field is missing or not a number
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double csv_reader_t::to_double(int idx, double value) const
+{
+  std::string_view str = field(idx);
+  if (!str.empty() && str[0] == '+')
+  {
+    str.remove_prefix(1);
+  }
+  if (str.empty())
+  {
+    return value;
+  }
+
+#if defined(__cpp_lib_to_chars)
+  double result = 0.0;
+  std::from_chars_result res = std::from_chars(str.data(), str.data() + str.size(), result);
+  if (res.ec != std::errc())
+  {
+    return value;
+  }
+  return result;
+#else
+  //no floating point from_chars in this standard library
+  char tmp[64];
+  if (str.size() >= sizeof(tmp))
+  {
+    return value;
+  }
+  std::memcpy(tmp, str.data(), str.size());
+  tmp[str.size()] = '\0';
+  char* end = nullptr;
+  double result = std::strtod(tmp, &end);
+  if (end == tmp)
+  {
+    return value;
+  }
+  return result;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::to_int
+// returns value when the field is missing or not a number
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int csv_reader_t::to_int(int idx, int value) const
+{
+  std::string_view str = field(idx);
+  if (!str.empty() && str[0] == '+')
+  {
+    str.remove_prefix(1);
+  }
+  int result = 0;
+  std::from_chars_result res = std::from_chars(str.data(), str.data() + str.size(), result);
+  if (str.empty() || res.ec != std::errc())
+  {
+    return value;
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t::read_record
+// RFC 4180: fields separated by ',', records by CRLF or LF
+// a quoted field may contain ',', line breaks and "" for a literal quote
+// characters between a closing quote and the next delimiter are ignored
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool csv_reader_t::read_record(std::vector<std::string_view>& record)
+{
+  record.clear();
+  const char* begin = input.data();
+  const size_t end = input.size();
+
+  //skip blank lines
+  while (pos < end && (input[pos] == '\r' || input[pos] == '\n'))
+  {
+    if (input[pos] == '\n')
+    {
+      ++nbr_newline;
+    }
+    ++pos;
+  }
+  if (pos >= end)
+  {
+    return false;
+  }
+  nbr_line = nbr_newline + 1;
+
+  while (true)
+  {
+    if (input[pos] == '"')
+    {
+      size_t start = ++pos;
+      bool escaped = false;
+      while (pos < end)
+      {
+        if (input[pos] == '"')
+        {
+          if (pos + 1 < end && input[pos + 1] == '"')
+          {
+            escaped = true;
+            pos += 2;
+            continue;
+          }
+          break;
+        }
+        if (input[pos] == '\n')
+        {
+          ++nbr_newline;
+        }
+        ++pos;
+      }
+
+      std::string_view value(begin + start, pos - start);
+      if (pos < end)
+      {
+        ++pos;
+      }
+
+      if (escaped)
+      {
+        unescaped.emplace_back();
+        std::string& str = unescaped.back();
+        str.reserve(value.size());
+        for (size_t idx = 0; idx < value.size(); ++idx)
+        {
+          str += value[idx];
+          if (value[idx] == '"')
+          {
+            ++idx;
+          }
+        }
+        value = str;
+      }
+
+      while (pos < end && input[pos] != ',' && input[pos] != '\n' && input[pos] != '\r')
+      {
+        ++pos;
+      }
+      record.push_back(value);
+    }
+    else
+    {
+      size_t start = pos;
+      while (pos < end && input[pos] != ',' && input[pos] != '\n' && input[pos] != '\r')
+      {
+        ++pos;
+      }
+      record.push_back(std::string_view(begin + start, pos - start));
+    }
+
+    if (pos < end && input[pos] == ',')
+    {
+      ++pos;
+      if (pos >= end)
+      {
+        record.push_back(std::string_view());
+        return true;
+      }
+      continue;
+    }
+
+    if (pos < end && input[pos] == '\r')
+    {
+      ++pos;
+    }
+    if (pos < end && input[pos] == '\n')
+    {
+      ++pos;
+      ++nbr_newline;
+    }
+    return true;
+  }
+}
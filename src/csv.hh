@@ -0,0 +1,78 @@
+#ifndef CSV_HH
+#define CSV_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap_file_t
+// read-only memory mapping of a whole file
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class mmap_file_t
+{
+public:
+  mmap_file_t();
+  ~mmap_file_t();
+  int open(const std::string& file_name);
+  void close();
+  const char* data() const { return buf; }
+  size_t size() const { return len; }
+
+private:
+  mmap_file_t(const mmap_file_t&) = delete;
+  mmap_file_t& operator=(const mmap_file_t&) = delete;
+  const char* buf;
+  size_t len;
+#ifdef _WIN32
+  void* file;
+  void* mapping;
+#else
+  int fd;
+#endif
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_reader_t
+// RFC 4180 tokenizer over a memory buffer (typically a mmap_file_t)
+// the first record is the header; column() resolves header names to indices once
+// fields are string_views into the buffer; only quoted fields with escaped quotes ("")
+// are copied, into storage that stays valid until the next call to next()
+// a UTF-8 BOM, CRLF line endings and blank lines are accepted
+// split() and chunk() cut the records after the header into newline-aligned ranges that can be
+// tokenized on separate threads; chunk readers share the header of the reader that made them,
+// which must outlive them, and report line() relative to the chunk start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class csv_reader_t
+{
+public:
+  csv_reader_t(const char* data, size_t size);
+  int column(std::string_view name) const;
+  bool next();
+  size_t size() const { return fields.size(); }
+  std::string_view field(int idx) const;
+  double to_double(int idx, double value = 0.0) const;
+  int to_int(int idx, int value = 0) const;
+  size_t line() const { return nbr_line; }
+  bool in_input(std::string_view str) const;
+  std::vector<size_t> split(size_t nbr_chunks) const;
+  csv_reader_t chunk(size_t begin, size_t end) const;
+
+private:
+  csv_reader_t(const csv_reader_t& parent, size_t begin, size_t end);
+  bool read_record(std::vector<std::string_view>& record);
+  std::string_view input;
+  size_t body;
+  size_t pos;
+  size_t nbr_line;
+  size_t nbr_newline;
+  std::vector<std::string_view> header;
+  std::vector<std::string_view> fields;
+  std::deque<std::string> header_unescaped;
+  std::deque<std::string> unescaped;
+};
+
+#endif
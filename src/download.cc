@@ -0,0 +1,937 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include "asio.hpp"
+#include "asio/ssl.hpp"
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include "download.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// make_download
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+download_t make_download(const std::string& name, const std::string& host, const std::string& path,
+  const std::string& accept, const std::string& api_key, const std::string& filename)
+{
+  download_t download;
+  download.name = name;
+  download.host = host;
+  download.port = "443";
+  download.path = path;
+  download.accept = accept;
+  download.api_key = api_key;
+  download.filename = filename;
+  download.max_age = cache_max_age(path);
+  download.stream = false;
+  download.status = 0;
+  download.attempts = 0;
+  download.ms = 0;
+  download.received = 0;
+  download.size = 0;
+  download.resumed = 0;
+  download.cached = false;
+  return download;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_atomic
+// write to filename.tmp, then rename over filename
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int write_atomic(const std::string& filename, const std::string& data)
+{
+  std::string tmp = filename + ".tmp";
+  std::ofstream ofs(tmp, std::ios::binary);
+  if (!ofs.is_open())
+  {
+    return -1;
+  }
+  ofs.write(data.data(), data.size());
+  ofs.close();
+  std::error_code ec;
+  if (!ofs)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+  std::filesystem::rename(tmp, filename, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// file_sha256
+// lowercase hex SHA-256 of a file, read in fixed size blocks
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int file_sha256(const std::string& file_name, std::string& hex)
+{
+  hex.clear();
+  FILE* file = std::fopen(file_name.c_str(), "rb");
+  if (!file)
+  {
+    return -1;
+  }
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+  std::vector<char> block(64 * 1024);
+  size_t size;
+  while ((size = std::fread(block.data(), 1, block.size(), file)) > 0)
+  {
+    EVP_DigestUpdate(ctx, block.data(), size);
+  }
+  bool failed = std::ferror(file) != 0;
+  std::fclose(file);
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_size = 0;
+  EVP_DigestFinal_ex(ctx, digest, &digest_size);
+  EVP_MD_CTX_free(ctx);
+  if (failed)
+  {
+    return -1;
+  }
+  const char* digits = "0123456789abcdef";
+  for (unsigned int idx = 0; idx < digest_size; ++idx)
+  {
+    hex += digits[digest[idx] >> 4];
+    hex += digits[digest[idx] & 15];
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// read_text
+// small side files (.part.etag); empty if absent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string read_text(const std::string& file_name)
+{
+  std::ifstream ifs(file_name);
+  std::string text;
+  std::getline(ifs, text);
+  return text;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// body framing
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const size_t read_size = 64 * 1024;
+
+enum chunk_state_t
+{
+  chunk_size_line,
+  chunk_data,
+  chunk_data_end,
+  chunk_trailer,
+  chunk_done
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t
+// state shared by the attempts of one download_all() call; lives on its stack, and is only
+// touched from the io_context thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct download_session_t;
+
+struct download_run_t
+{
+  download_run_t(std::vector<download_t>& downloads_, const download_options_t& options_) :
+    ssl(asio::ssl::context::tlsv12_client),
+    downloads(downloads_),
+    options(options_),
+    next(0),
+    active(0),
+    failed(0)
+  {
+    ssl.set_default_verify_paths();
+    start.resize(downloads.size());
+  }
+  asio::io_context io;
+  asio::ssl::context ssl;
+  std::vector<download_t>& downloads;
+  download_options_t options;
+  std::vector<std::chrono::steady_clock::time_point> start;
+  size_t next;
+  size_t active;
+  int failed;
+  void start_next();
+  void attempt(size_t idx);
+  void attempt_done(download_session_t& session, const std::string& error);
+  bool cacheable(size_t idx) const;
+  void finish(size_t idx);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t
+// one attempt: resolve, connect, TLS handshake, request, headers, body until the server closes
+// a timer bounds the whole attempt; when it fires the socket is closed and the pending operation
+// fails with operation_aborted
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct download_session_t : public std::enable_shared_from_this<download_session_t>
+{
+  download_session_t(download_run_t& run_, size_t idx_) :
+    run(run_),
+    idx(idx_),
+    resolver(run_.io),
+    sock(run_.io, run_.ssl),
+    timer(run_.io),
+    buffer(read_size),
+    received(0),
+    status(0),
+    content_length(-1),
+    chunked(false),
+    chunk_state(chunk_size_line),
+    chunk_left(0),
+    part(nullptr),
+    offset(0),
+    written(0),
+    total(-1),
+    network(false),
+    restart(false),
+    write_error(false),
+    timed_out(false),
+    done(false)
+  {
+  }
+  ~download_session_t()
+  {
+    if (part)
+    {
+      std::fclose(part);
+    }
+  }
+  download_run_t& run;
+  size_t idx;
+  asio::ip::tcp::resolver resolver;
+  asio::ssl::stream<asio::ip::tcp::socket> sock;
+  asio::steady_timer timer;
+  asio::streambuf sbuf;
+  std::vector<char> buffer;
+  std::string request;
+  std::string validators;
+  std::string body;
+  std::string etag;
+  std::string last_modified;
+  size_t received;
+  int status;
+  long long content_length;
+  bool chunked;
+  chunk_state_t chunk_state;
+  uint64_t chunk_left;
+  std::string chunk_line;
+  FILE* part; //filename.part of a streamed download, open while the body is read
+  std::string part_path;
+  uint64_t offset; //bytes already in filename.part when the request was sent
+  uint64_t written; //body bytes of this attempt
+  long long total; //full size from Content-Range of a 206
+  bool network; //failed in transport, worth a retry
+  bool restart; //the resume was refused and filename.part removed, start again from byte 0
+  bool write_error;
+  bool timed_out;
+  bool done;
+
+  void start();
+  void read_headers();
+  int open_part();
+  void read_body();
+  int consume(const char* data, size_t size);
+  bool take_line(const char* data, size_t size, size_t& pos);
+  int write_body(const char* data, size_t size);
+  void complete();
+  void finish(const std::string& error);
+  void fail(const asio::error_code& ec, const char* step);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::start()
+{
+  const download_t& download = run.downloads[idx];
+
+  //resume a streamed download left by an earlier attempt; If-Range makes the server send the
+  //whole body instead if it changed since
+  std::string range;
+  if (download.stream)
+  {
+    part_path = download.filename + ".part";
+    std::string part_etag = read_text(part_path + ".etag");
+    std::error_code ec;
+    uintmax_t part_size = std::filesystem::file_size(part_path, ec);
+    if (!ec && part_size > 0 && !part_etag.empty())
+    {
+      offset = part_size;
+      range = "Range: bytes=" + std::to_string(offset) + "-\r\nIf-Range: " + part_etag + "\r\n";
+      validators.clear();
+    }
+  }
+
+  std::stringstream http;
+  http << "GET " << download.path << " HTTP/1.1\r\n";
+  http << "Host: " << download.host << "\r\n";
+  http << "Accept: " << (download.accept.empty() ? "*/*" : download.accept) << "\r\n";
+  if (validators.empty())
+  {
+    http << "Cache-Control: no-cache\r\n";
+  }
+  http << validators;
+  http << range;
+  if (!download.api_key.empty())
+  {
+    http << "api_key: " << download.api_key << "\r\n";
+  }
+  http << "Connection: close\r\n\r\n";
+  request = http.str();
+
+  std::shared_ptr<download_session_t> self = shared_from_this();
+  timer.expires_after(run.options.timeout);
+  timer.async_wait([self](const asio::error_code& ec)
+    {
+      if (!ec && !self->done)
+      {
+        asio::error_code ignored;
+        self->timed_out = true;
+        self->resolver.cancel();
+        self->sock.lowest_layer().close(ignored);
+      }
+    });
+
+  resolver.async_resolve(download.host, download.port, [self](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results)
+    {
+      if (ec)
+      {
+        self->fail(ec, "resolve");
+        return;
+      }
+      asio::async_connect(self->sock.lowest_layer(), results, [self](const asio::error_code& ec, const asio::ip::tcp::endpoint&)
+        {
+          if (ec)
+          {
+            self->fail(ec, "connect");
+            return;
+          }
+          asio::error_code ignored;
+          self->sock.lowest_layer().set_option(asio::ip::tcp::no_delay(true), ignored);
+
+          //Server Name Indication (SNI)
+          ::SSL_set_tlsext_host_name(self->sock.native_handle(), self->run.downloads[self->idx].host.c_str());
+          self->sock.set_verify_mode(asio::ssl::verify_none);
+          self->sock.async_handshake(asio::ssl::stream_base::client, [self](const asio::error_code& ec)
+            {
+              if (ec)
+              {
+                self->fail(ec, "handshake");
+                return;
+              }
+              asio::async_write(self->sock, asio::buffer(self->request), [self](const asio::error_code& ec, size_t)
+                {
+                  if (ec)
+                  {
+                    self->fail(ec, "write");
+                    return;
+                  }
+                  self->read_headers();
+                });
+            });
+        });
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::read_headers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::read_headers()
+{
+  std::shared_ptr<download_session_t> self = shared_from_this();
+  asio::async_read_until(sock, sbuf, "\r\n\r\n", [self](const asio::error_code& ec, size_t header_size)
+    {
+      if (ec)
+      {
+        self->fail(ec, "headers");
+        return;
+      }
+
+      self->received += header_size;
+      std::string text(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + header_size);
+      self->sbuf.consume(header_size);
+      std::vector<std::string> header;
+      std::istringstream lines(text);
+      std::string line;
+      while (std::getline(lines, line) && line != "\r")
+      {
+        header.push_back(line);
+      }
+
+      self->status = http_status(header);
+      std::string length = http_header_value(header, "Content-Length");
+      if (!length.empty())
+      {
+        self->content_length = std::atoll(length.c_str());
+      }
+      self->chunked = http_header_value(header, "Transfer-Encoding").find("chunked") != std::string::npos;
+      self->etag = http_header_value(header, "ETag");
+      self->last_modified = http_header_value(header, "Last-Modified");
+      if (self->status == 206)
+      {
+        //Content-Range: bytes first-last/total
+        std::string content_range = http_header_value(header, "Content-Range");
+        size_t slash = content_range.find('/');
+        self->total = slash == std::string::npos ? -1 : std::atoll(content_range.c_str() + slash + 1);
+        if (content_range.compare(0, 6, "bytes ") != 0 || std::strtoull(content_range.c_str() + 6, nullptr, 10) != self->offset)
+        {
+          self->finish("unexpected Content-Range " + content_range);
+          return;
+        }
+      }
+
+      if (self->status >= 200 && self->status <= 299 && self->run.downloads[self->idx].stream && self->open_part() != 0)
+      {
+        self->finish("cannot write " + self->part_path);
+        return;
+      }
+
+      //the body bytes read along with the header
+      std::string head(asio::buffers_begin(self->sbuf.data()), asio::buffers_end(self->sbuf.data()));
+      self->sbuf.consume(self->sbuf.size());
+      self->received += head.size();
+      if (self->consume(head.data(), head.size()) != 0)
+      {
+        self->finish(self->write_error ? "cannot write " + self->part_path : "malformed chunked body");
+        return;
+      }
+      self->read_body();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::open_part
+// a 206 appends to filename.part, anything else starts it over; the ETag is kept next to it so an
+// interrupted transfer can be resumed, even by a later run
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int download_session_t::open_part()
+{
+  std::error_code ec;
+  if (status == 206)
+  {
+    part = std::fopen(part_path.c_str(), "ab");
+    return part ? 0 : -1;
+  }
+  offset = 0;
+  part = std::fopen(part_path.c_str(), "wb");
+  if (!part)
+  {
+    return -1;
+  }
+  if (etag.empty())
+  {
+    std::filesystem::remove(part_path + ".etag", ec);
+    return 0;
+  }
+  return write_atomic(part_path + ".etag", etag + "\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::read_body
+// Connection: close, so the body ends when the server closes the stream
+// read in fixed size blocks, so a streamed download uses the same memory whatever its size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::read_body()
+{
+  std::shared_ptr<download_session_t> self = shared_from_this();
+  sock.async_read_some(asio::buffer(buffer), [self](const asio::error_code& ec, size_t size)
+    {
+      self->received += size;
+      if (self->consume(self->buffer.data(), size) != 0)
+      {
+        self->finish(self->write_error ? "cannot write " + self->part_path : "malformed chunked body");
+        return;
+      }
+      if (!ec)
+      {
+        self->read_body();
+      }
+      else if (ec == asio::error::eof || ec == asio::ssl::error::stream_truncated)
+      {
+        self->complete();
+      }
+      else
+      {
+        self->fail(ec, "body");
+      }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::consume
+// body bytes as they arrive, decoding Transfer-Encoding: chunked on the fly
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int download_session_t::consume(const char* data, size_t size)
+{
+  if (!chunked)
+  {
+    return write_body(data, size);
+  }
+  size_t pos = 0;
+  while (pos < size && chunk_state != chunk_done)
+  {
+    if (chunk_state == chunk_data)
+    {
+      size_t part_size = static_cast<size_t>(std::min<uint64_t>(chunk_left, size - pos));
+      if (write_body(data + pos, part_size) != 0)
+      {
+        return -1;
+      }
+      pos += part_size;
+      chunk_left -= part_size;
+      if (chunk_left == 0)
+      {
+        chunk_state = chunk_data_end;
+      }
+      continue;
+    }
+    if (!take_line(data, size, pos))
+    {
+      if (chunk_line.size() > 1024)
+      {
+        return -1;
+      }
+      continue;
+    }
+    if (chunk_state == chunk_size_line)
+    {
+      char* end = nullptr;
+      chunk_left = std::strtoull(chunk_line.c_str(), &end, 16);
+      if (end == chunk_line.c_str())
+      {
+        return -1;
+      }
+      chunk_state = chunk_left > 0 ? chunk_data : chunk_trailer;
+    }
+    else if (chunk_state == chunk_data_end)
+    {
+      if (!chunk_line.empty())
+      {
+        return -1;
+      }
+      chunk_state = chunk_size_line;
+    }
+    else if (chunk_line.empty())
+    {
+      chunk_state = chunk_done;
+    }
+    chunk_line.clear();
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::take_line
+// append data up to the next '\n' to chunk_line; true once the line is complete, without its "\r\n"
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool download_session_t::take_line(const char* data, size_t size, size_t& pos)
+{
+  const char* eol = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+  size_t end = eol ? static_cast<size_t>(eol - data) : size;
+  chunk_line.append(data + pos, end - pos);
+  pos = eol ? end + 1 : size;
+  if (eol && !chunk_line.empty() && chunk_line.back() == '\r')
+  {
+    chunk_line.pop_back();
+  }
+  return eol != nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::write_body
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int download_session_t::write_body(const char* data, size_t size)
+{
+  if (part)
+  {
+    if (std::fwrite(data, 1, size, part) != size)
+    {
+      write_error = true;
+      return -1;
+    }
+  }
+  else
+  {
+    body.append(data, size);
+  }
+  written += size;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::complete
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::complete()
+{
+  //a 304 has no body, whatever its Content-Length says
+  if (status == 304 && !validators.empty())
+  {
+    finish("");
+    return;
+  }
+  if ((chunked && chunk_state != chunk_done) || (!chunked && content_length >= 0 && written < static_cast<uint64_t>(content_length)))
+  {
+    network = true;
+    finish("truncated body");
+    return;
+  }
+  //416: the Range of a resume cannot be served, for example the part is as long as or longer than
+  //the file; keeping the part would fail the same way on every run, so drop it and start over
+  if (status == 416 && offset > 0)
+  {
+    std::error_code ec;
+    std::filesystem::remove(part_path + ".etag", ec);
+    std::filesystem::remove(part_path, ec);
+    restart = !ec;
+    finish("HTTP 416 for bytes " + std::to_string(offset) + "-, restarting from 0");
+    return;
+  }
+  if (status < 200 || status > 299)
+  {
+    finish("HTTP " + std::to_string(status));
+    return;
+  }
+  if (!part)
+  {
+    finish("");
+    return;
+  }
+
+  const download_t& download = run.downloads[idx];
+  bool closed = std::fclose(part) == 0;
+  part = nullptr;
+  std::error_code ec;
+  if (!closed)
+  {
+    finish("cannot write " + part_path);
+    return;
+  }
+  if (total >= 0 && offset + written != static_cast<uint64_t>(total))
+  {
+    network = true;
+    finish("truncated body");
+    return;
+  }
+  if (!download.sha256.empty())
+  {
+    std::string hex;
+    if (file_sha256(part_path, hex) != 0 || hex != download.sha256)
+    {
+      //never resume from a corrupt part
+      std::filesystem::remove(part_path, ec);
+      std::filesystem::remove(part_path + ".etag", ec);
+      finish("SHA-256 mismatch");
+      return;
+    }
+  }
+  std::filesystem::rename(part_path, download.filename, ec);
+  if (ec)
+  {
+    finish("cannot write " + download.filename);
+    return;
+  }
+  std::filesystem::remove(part_path + ".etag", ec);
+  finish("");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::fail
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::fail(const asio::error_code& ec, const char* step)
+{
+  network = true;
+  if (timed_out)
+  {
+    finish(std::string("timeout (") + step + ")");
+    return;
+  }
+  finish(std::string(step) + ": " + ec.message());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_session_t::finish
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_session_t::finish(const std::string& error)
+{
+  if (done)
+  {
+    return;
+  }
+  done = true;
+  timer.cancel();
+  asio::error_code ignored;
+  sock.lowest_layer().close(ignored);
+  if (part)
+  {
+    //what was written stays in filename.part for the next attempt
+    std::fclose(part);
+    part = nullptr;
+  }
+  run.attempt_done(*this, error);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t::start_next
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_run_t::start_next()
+{
+  while (active < options.max_parallel && next < downloads.size())
+  {
+    size_t idx = next++;
+    ++active;
+    start[idx] = std::chrono::steady_clock::now();
+    download_t& download = downloads[idx];
+    cache_entry_t entry;
+    std::string key = download.host + download.path;
+    if (cacheable(idx) && options.cache->load(key, entry) == 0 && options.cache->fresh(entry, download.max_age) &&
+      (download.stream || options.cache->read(key, download.body) == 0))
+    {
+      download.cached = true;
+      download.size = entry.size;
+      finish(idx);
+      continue;
+    }
+    attempt(idx);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t::attempt
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_run_t::attempt(size_t idx)
+{
+  ++downloads[idx].attempts;
+  std::shared_ptr<download_session_t> session = std::make_shared<download_session_t>(*this, idx);
+  cache_entry_t entry;
+  if (cacheable(idx) && options.cache->load(downloads[idx].host + downloads[idx].path, entry) == 0)
+  {
+    session->validators = options.cache->conditional_headers(entry);
+  }
+  session->start();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t::attempt_done
+// store the result, or schedule a retry; a download keeps its parallel slot while it waits
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_run_t::attempt_done(download_session_t& session, const std::string& error)
+{
+  size_t idx = session.idx;
+  download_t& download = downloads[idx];
+  download.status = session.status;
+  download.error = error;
+  download.received += session.received;
+  download.resumed = session.status == 206 ? session.offset : 0;
+
+  //without the part the next attempt sends no Range, so this happens at most once
+  if (session.restart)
+  {
+    std::cout << download.name << ": " << error << std::endl;
+    attempt(idx);
+    return;
+  }
+
+  bool retry = !error.empty() && (session.network || session.status == 429 || session.status >= 500);
+  if (retry && download.attempts < options.max_attempts)
+  {
+    std::chrono::milliseconds delay = options.backoff * (1 << (download.attempts - 1));
+    std::cout << download.name << ": " << error << ", retry in " << delay.count() << " ms" << std::endl;
+    std::shared_ptr<asio::steady_timer> wait = std::make_shared<asio::steady_timer>(io, delay);
+    wait->async_wait([this, idx, wait](const asio::error_code&)
+      {
+        attempt(idx);
+      });
+    return;
+  }
+
+  if (error.empty())
+  {
+    std::string key = download.host + download.path;
+    if (session.status == 304)
+    {
+      cache_entry_t entry;
+      download.cached = true;
+      if (options.cache->load(key, entry) != 0 || (!download.stream && options.cache->read(key, download.body) != 0))
+      {
+        download.error = "cached body missing";
+      }
+      download.size = entry.size;
+      options.cache->revalidated(key, session.etag, session.last_modified);
+    }
+    else if (download.stream)
+    {
+      download.size = session.offset + session.written;
+      if (cacheable(idx))
+      {
+        options.cache->store_file(key, download.filename, session.etag, session.last_modified);
+      }
+    }
+    else
+    {
+      download.body.swap(session.body);
+      download.size = download.body.size();
+      if (cacheable(idx))
+      {
+        options.cache->store(key, download.body, session.etag, session.last_modified);
+      }
+    }
+  }
+  finish(idx);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t::cacheable
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool download_run_t::cacheable(size_t idx) const
+{
+  return options.cache && downloads[idx].max_age.count() >= 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_run_t::finish
+// write the output file and free the parallel slot; a streamed body is already in place
+// a body served from the cache is only written when the file on disk does not already match it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_run_t::finish(size_t idx)
+{
+  download_t& download = downloads[idx];
+  if (download.error.empty() && !download.filename.empty() && (download.cached || !download.stream))
+  {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(download.filename, ec);
+    bool current = download.cached && !ec && size == download.size;
+    if (!current)
+    {
+      int result = download.stream ? options.cache->copy(download.host + download.path, download.filename) :
+        write_atomic(download.filename, download.body);
+      if (result != 0)
+      {
+        download.error = "cannot write " + download.filename;
+      }
+    }
+  }
+  if (!download.error.empty())
+  {
+    ++failed;
+  }
+  download.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start[idx]).count();
+  --active;
+  start_next();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_all
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int download_all(std::vector<download_t>& downloads, const download_options_t& options)
+{
+  for (size_t idx = 0; idx < downloads.size(); ++idx)
+  {
+    downloads[idx].status = 0;
+    downloads[idx].attempts = 0;
+    downloads[idx].ms = 0;
+    downloads[idx].received = 0;
+    downloads[idx].size = 0;
+    downloads[idx].resumed = 0;
+    downloads[idx].cached = false;
+    downloads[idx].body.clear();
+    downloads[idx].error.clear();
+  }
+
+  download_options_t run_options = options;
+  if (run_options.max_parallel == 0)
+  {
+    run_options.max_parallel = 1;
+  }
+  if (run_options.max_attempts < 1)
+  {
+    run_options.max_attempts = 1;
+  }
+
+  try
+  {
+    download_run_t run(downloads, run_options);
+    run.start_next();
+    run.io.run();
+    return run.failed;
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+  return static_cast<int>(downloads.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_report
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void download_report(const std::vector<download_t>& downloads, double total_ms, std::ostream& os)
+{
+  os << std::left << std::setw(24) << "request" << std::right
+    << std::setw(8) << "status"
+    << std::setw(10) << "attempts"
+    << std::setw(12) << "KB"
+    << std::setw(12) << "received"
+    << std::setw(12) << "ms" << "  result" << std::endl;
+  double sum_ms = 0;
+  size_t sum_received = 0;
+  for (size_t idx = 0; idx < downloads.size(); ++idx)
+  {
+    const download_t& download = downloads[idx];
+    std::string result = download.error;
+    if (result.empty())
+    {
+      result = !download.cached ? "ok" : download.status == 304 ? "not modified" : "cached";
+      if (download.resumed > 0)
+      {
+        result += ", resumed at " + std::to_string(download.resumed);
+      }
+    }
+    os << std::left << std::setw(24) << download.name << std::right
+      << std::setw(8) << download.status
+      << std::setw(10) << download.attempts
+      << std::setw(12) << download.size / 1024
+      << std::setw(12) << download.received
+      << std::setw(12) << std::fixed << std::setprecision(1) << download.ms
+      << "  " << result << std::endl;
+    sum_ms += download.ms;
+    sum_received += download.received;
+  }
+  os << std::left << std::setw(54) << "total (bytes received, sum of requests)" << std::right
+    << std::setw(12) << sum_received << std::setw(12) << sum_ms << std::endl;
+  os << std::left << std::setw(66) << "total (wall clock)" << std::right << std::setw(12) << total_ms << std::endl;
+}
@@ -0,0 +1,75 @@
+#ifndef DOWNLOAD_HH
+#define DOWNLOAD_HH
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+#include <stdint.h>
+#include "http_cache.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_t
+// one HTTPS GET: the request fields are filled by the caller, the rest by download_all()
+// a successful body (status 2xx) is kept in body and, when filename is set, written to
+// filename.tmp and renamed over filename, so readers never see a partial file
+// a stream download writes the body to filename.part as it arrives and renames it when complete;
+// memory stays flat whatever the size, and an interrupted transfer resumes with a Range request;
+// a 416 answer to that request discards filename.part and the download starts over from byte 0
+// with a cache, max_age >= 0 makes the download cacheable: a fresh copy is used as is, a stale one
+// is revalidated and a 304 answer is served from disk (cached is then true)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct download_t
+{
+  std::string name; //label in the report
+  std::string host;
+  std::string port;
+  std::string path;
+  std::string accept;
+  std::string api_key;
+  std::string filename;
+  std::chrono::seconds max_age; //cache_max_age(path) by default
+  bool stream; //needs filename; body stays empty
+  std::string sha256; //expected digest (lowercase hex) of a stream download, checked when set
+
+  int status; //HTTP status of the last attempt, 0 if none was received
+  int attempts;
+  double ms; //first attempt to completion, including retries
+  size_t received; //bytes read from the network, headers included
+  uint64_t size; //body size
+  uint64_t resumed; //bytes kept from an earlier interrupted transfer
+  bool cached;
+  std::string body;
+  std::string error; //empty on success
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_options_t
+// a failed attempt (network error, timeout, 429 or 5xx) is retried after backoff, doubled on each
+// retry, until max_attempts; other 4xx responses are not retried
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct download_options_t
+{
+  size_t max_parallel = 4;
+  std::chrono::milliseconds timeout = std::chrono::seconds(30); //per attempt, connect to last byte
+  int max_attempts = 3;
+  std::chrono::milliseconds backoff = std::chrono::milliseconds(500);
+  http_cache_t* cache = nullptr;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// download_all
+// runs every download concurrently on one asio io_context, at most max_parallel at a time
+// returns the number of downloads that failed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+download_t make_download(const std::string& name, const std::string& host, const std::string& path,
+  const std::string& accept, const std::string& api_key, const std::string& filename);
+int download_all(std::vector<download_t>& downloads, const download_options_t& options = download_options_t());
+void download_report(const std::vector<download_t>& downloads, double total_ms, std::ostream& os);
+int write_atomic(const std::string& filename, const std::string& data);
+int file_sha256(const std::string& file_name, std::string& hex);
+
+#endif
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include "csv.hh"
+#include "zip.hh"
+#include "feed.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tables read by gtfs_t::load; a change to any of them triggers a reload
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* feed_tables[] =
+{
+  "feed_info.txt", "agency.txt", "levels.txt", "stops.txt", "routes.txt", "calendar.txt",
+  "calendar_dates.txt", "trips.txt", "shapes.txt", "stop_times.txt", "pathways.txt"
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// hash_bytes
+// 64 bit FNV-1a
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t hash_bytes(const char* data, size_t size)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t idx = 0; idx < size; ++idx)
+  {
+    hash ^= static_cast<unsigned char>(data[idx]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_path
+// the archive gtfs_dir.zip when present, read in place; else gtfs_dir itself
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string feed_path(const std::string& gtfs_dir)
+{
+  if (is_zip_path(gtfs_dir))
+  {
+    return gtfs_dir;
+  }
+  std::ifstream zip(gtfs_dir + ".zip", std::ios::binary);
+  return zip.is_open() ? gtfs_dir + ".zip" : gtfs_dir;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// hash_tables
+// content hash of every feed table, in a directory or a .zip archive; 0 for a missing table
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::map<std::string, uint64_t> hash_tables(const std::string& gtfs_dir)
+{
+  std::map<std::string, uint64_t> hashes;
+  if (is_zip_path(gtfs_dir))
+  {
+    //an archive already stores a CRC-32 per member; an unreadable archive hashes as all absent
+    zip_reader_t zip;
+    bool valid = zip.open(gtfs_dir) == 0;
+    for (size_t idx = 0; idx < sizeof(feed_tables) / sizeof(feed_tables[0]); ++idx)
+    {
+      size_t entry = valid ? zip.find(feed_tables[idx]) : zip_npos;
+      uint64_t hash = 0;
+      if (entry != zip_npos)
+      {
+        hash = ((static_cast<uint64_t>(zip.entry(entry).crc) << 32) ^ zip.entry(entry).size) | 1;
+      }
+      hashes[feed_tables[idx]] = hash;
+    }
+    return hashes;
+  }
+
+  for (size_t idx = 0; idx < sizeof(feed_tables) / sizeof(feed_tables[0]); ++idx)
+  {
+    mmap_file_t file;
+    uint64_t hash = 0;
+    if (file.open(gtfs_dir + "/" + feed_tables[idx]) == 0)
+    {
+      hash = hash_bytes(file.data(), file.size()) | 1;
+    }
+    hashes[feed_tables[idx]] = hash;
+  }
+  return hashes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// build_feed
+// load gtfs_dir and derive calendar, schedule, pathways, planner and line geometry
+// line geometry is only regenerated when trips, routes or shapes changed since previous; the
+// names of lines whose GeoJSON differs from previous are returned in changed_lines
+// returns nullptr if the directory has no usable feed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<feed_t> build_feed(const std::string& gtfs_dir, const feed_t* previous, std::vector<std::string>& changed_lines)
+{
+  changed_lines.clear();
+  std::shared_ptr<feed_t> feed = std::make_shared<feed_t>();
+  feed->table_hash = hash_tables(gtfs_dir);
+  feed->version = previous ? previous->version + 1 : 1;
+
+  if (feed->gtfs.load(gtfs_dir) < 0)
+  {
+    return nullptr;
+  }
+  feed->calendar.build(feed->gtfs);
+  feed->schedule.build(feed->gtfs, feed->calendar);
+  feed->pathways.build(feed->gtfs);
+  feed->raptor.build(feed->gtfs, feed->calendar, &feed->pathways);
+
+  const char* line_tables[] = { "trips.txt", "routes.txt", "shapes.txt" };
+  bool lines_changed = previous == nullptr;
+  for (size_t idx = 0; idx < sizeof(line_tables) / sizeof(line_tables[0]) && !lines_changed; ++idx)
+  {
+    std::map<std::string, uint64_t>::const_iterator it = previous->table_hash.find(line_tables[idx]);
+    lines_changed = it == previous->table_hash.end() || it->second != feed->table_hash[line_tables[idx]];
+  }
+
+  if (!lines_changed)
+  {
+    feed->lines = previous->lines;
+    return feed;
+  }
+
+  for (uint32_t route = 0; route < feed->gtfs.routes.size(); ++route)
+  {
+    std::string geojson = route_geojson(feed->gtfs, route);
+    if (geojson.empty())
+    {
+      continue;
+    }
+    std::string name = route_name(feed->gtfs, route);
+    if (!previous || previous->lines.count(name) == 0 || previous->lines.at(name) != geojson)
+    {
+      changed_lines.push_back(name);
+    }
+    feed->lines[name].swap(geojson);
+  }
+  return feed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::feed_watcher_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+feed_watcher_t::feed_watcher_t(const std::string& gtfs_dir_, std::chrono::seconds interval_) :
+  gtfs_dir(gtfs_dir_),
+  interval(interval_),
+  stopping(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::~feed_watcher_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+feed_watcher_t::~feed_watcher_t()
+{
+  stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::current
+// snapshot of the published feed, nullptr before the first load
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const feed_t> feed_watcher_t::current() const
+{
+  return std::atomic_load(&feed);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::load
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int feed_watcher_t::load()
+{
+  std::vector<std::string> changed_lines;
+  std::shared_ptr<const feed_t> next = build_feed(feed_path(gtfs_dir), nullptr, changed_lines);
+  if (!next)
+  {
+    return -1;
+  }
+  std::atomic_store(&feed, next);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::check
+// reload if a table changed; returns true if a new feed was published
+// a feed whose files change again while it is being read (a download in progress) is dropped
+// and picked up by a later check
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool feed_watcher_t::check()
+{
+  std::shared_ptr<const feed_t> previous = current();
+  std::string path = feed_path(gtfs_dir);
+  std::map<std::string, uint64_t> hashes = hash_tables(path);
+  if (previous && hashes == previous->table_hash)
+  {
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::string> changed_lines;
+  std::shared_ptr<const feed_t> next = build_feed(path, previous.get(), changed_lines);
+  if (!next || next->table_hash != hashes || hash_tables(path) != hashes)
+  {
+    return false;
+  }
+
+  std::atomic_store(&feed, next);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "GTFS feed " << next->version << " from " << path << " (" << next->gtfs.feed_info.start_date << "-"
+    << next->gtfs.feed_info.end_date << ") loaded in " << elapsed.count() << " ms, changed:";
+  for (std::map<std::string, uint64_t>::const_iterator it = hashes.begin(); it != hashes.end(); ++it)
+  {
+    if (!previous || previous->table_hash.at(it->first) != it->second)
+    {
+      std::cout << " " << it->first;
+    }
+  }
+  for (size_t idx = 0; idx < changed_lines.size(); ++idx)
+  {
+    std::cout << " line_" << changed_lines[idx];
+  }
+  std::cout << std::endl;
+
+  if (on_swap)
+  {
+    on_swap(*next, changed_lines);
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void feed_watcher_t::start()
+{
+  if (thread.joinable())
+  {
+    return;
+  }
+  stopping = false;
+  thread = std::thread(&feed_watcher_t::run, this);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::stop
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void feed_watcher_t::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  if (thread.joinable())
+  {
+    thread.join();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t::run
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void feed_watcher_t::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!cv.wait_for(lock, interval, [this]() { return stopping; }))
+  {
+    lock.unlock();
+    try
+    {
+      check();
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "GTFS reload: " << e.what() << std::endl;
+    }
+    lock.lock();
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef FEED_HH
+#define FEED_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <stdint.h>
+#include "gtfs.hh"
+#include "calendar.hh"
+#include "schedule.hh"
+#include "pathways.hh"
+#include "raptor.hh"
+#include "line_geojson.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_t
+// a loaded GTFS feed with everything derived from it
+// immutable once published; calendar, schedule, pathways and raptor point into gtfs and each
+// other, so a feed_t never moves
+// lines maps a route name ("RD") to its FeatureCollection, for routes with shapes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct feed_t
+{
+  gtfs_t gtfs;
+  service_calendar_t calendar;
+  schedule_t schedule;
+  pathways_t pathways;
+  raptor_t raptor;
+  std::map<std::string, std::string> lines;
+  std::map<std::string, uint64_t> table_hash; //table file name -> content hash, 0 if absent
+  uint64_t version;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// feed_watcher_t
+// owns the current feed_t and replaces it when the feed directory (or .zip archive) changes
+// the path is resolved with feed_path() on every load and check, so an archive that appears next
+// to the directory after startup replaces it
+// load() reads the feed once; start() then checks the table hashes every interval on a background
+// thread and, when any changed, builds a complete new feed_t off to the side and publishes it with
+// an atomic shared_ptr store; readers take current() once per request and keep that snapshot
+// on_swap(feed, changed_lines) runs on the watcher thread after each swap
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class feed_watcher_t
+{
+public:
+  feed_watcher_t(const std::string& gtfs_dir, std::chrono::seconds interval = std::chrono::seconds(60));
+  ~feed_watcher_t();
+  int load();
+  void start();
+  void stop();
+  bool check();
+  std::shared_ptr<const feed_t> current() const;
+  std::function<void(const feed_t&, const std::vector<std::string>&)> on_swap;
+
+private:
+  feed_watcher_t(const feed_watcher_t&) = delete;
+  feed_watcher_t& operator=(const feed_watcher_t&) = delete;
+  std::string gtfs_dir;
+  std::chrono::seconds interval;
+  std::shared_ptr<const feed_t> feed;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping;
+  void run();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string feed_path(const std::string& gtfs_dir);
+std::shared_ptr<feed_t> build_feed(const std::string& gtfs_dir, const feed_t* previous, std::vector<std::string>& changed_lines);
+std::map<std::string, uint64_t> hash_tables(const std::string& gtfs_dir);
+
+#endif
@@ -28,6 +28,16 @@ int geojson_t::convert(const char* file_name)
   std::string json = buf.str();
   file.close();
 
+  return parse(json);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//geojson_t::parse
+//parse GeoJSON text already in memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int geojson_t::parse(const std::string& json)
+{
   try
   {
     Wt::Json::Object root;
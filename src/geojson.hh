@@ -77,6 +77,7 @@ public:
   {
   }
   int convert(const char* file_name);
+  int parse(const std::string& json);
 
   //storage is a list of features 
   std::vector<feature_t> features;
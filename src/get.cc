@@ -1,7 +1,10 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstdlib>
 #include "ssl_read.hh"
+#include "http_cache.hh"
+#include "download.hh"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // extract_value
@@ -16,10 +19,120 @@ std::string extract_value(const std::string& content, const std::string& key)
   return content.substr(first + 1, second - first - 1);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// extract_number
+// numeric value of key, quoted or not; default_value if key is absent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double extract_number(const std::string& content, const std::string& key, double default_value)
+{
+  size_t pos_key = content.find("\"" + key + "\"");
+  if (pos_key == std::string::npos)
+  {
+    return default_value;
+  }
+  size_t pos_colon = content.find(":", pos_key);
+  size_t first = content.find_first_not_of(" \t\r\n\"", pos_colon + 1);
+  if (pos_colon == std::string::npos || first == std::string::npos)
+  {
+    return default_value;
+  }
+  char* end = nullptr;
+  double value = std::strtod(content.c_str() + first, &end);
+  return end == content.c_str() + first ? default_value : value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// API endpoint
+// api.wmata.com unless API_HOST / API_PORT in config.json point the clients elsewhere, such as
+// a local wmata_mock
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string wmata_host = "api.wmata.com";
+std::string wmata_port = "443";
+
+void set_api_endpoint(const std::string& config)
+{
+  if (config.find("\"API_HOST\"") != std::string::npos)
+  {
+    wmata_host = extract_value(config, "API_HOST");
+  }
+  wmata_port = std::to_string(static_cast<int>(extract_number(config, "API_PORT", 443)));
+}
+
+const std::string& api_host()
+{
+  return wmata_host;
+}
+
+const std::string& api_port()
+{
+  return wmata_port;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// get_cached
+// GET host/path through the on-disk cache in ./cache, for endpoints with a cache_max_age()
+// a fresh copy is returned without a request; a stale one is revalidated, and the server answers
+// 304 with no body when it has not changed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int get_cached(const std::string& host, const std::string& path, const std::string& accept, const std::string& api_key, std::string& body)
+{
+	http_cache_t cache("cache");
+	const std::string key = host + path;
+	std::chrono::seconds max_age = cache_max_age(path);
+	cache_entry_t entry;
+	bool cached = max_age.count() >= 0 && cache.load(key, entry) == 0;
+	if (cached && cache.fresh(entry, max_age) && cache.read(key, body) == 0)
+	{
+		std::cout << path << ": cached" << std::endl;
+		return 0;
+	}
+
+	std::stringstream http;
+	http << "GET " << path << " HTTP/1.1\r\n";
+	http << "Host: " << host << "\r\n";
+	http << "Accept: " << accept << "\r\n";
+	if (cached)
+	{
+		http << cache.conditional_headers(entry);
+	}
+	else
+	{
+		http << "Cache-Control: no-cache\r\n";
+	}
+	http << "api_key: " << api_key << "\r\n";
+	http << "Connection: close\r\n\r\n";
+	//the request line only; the headers hold the api_key
+	std::cout << "GET " << path << (cached ? " (revalidate)" : "") << std::endl;
+
+	std::string response;
+	std::vector<std::string> header;
+	ssl_read(host, api_port(), http.str(), response, header);
+	int status = http_status(header);
+
+	if (status == 304 && cached)
+	{
+		cache.revalidated(key, http_header_value(header, "ETag"), http_header_value(header, "Last-Modified"));
+		return cache.read(key, body);
+	}
+	if (status < 200 || status > 299 || !response.size())
+	{
+		return -1;
+	}
+	body.swap(response);
+	if (max_age.count() >= 0)
+	{
+		cache.store(key, body, http_header_value(header, "ETag"), http_header_value(header, "Last-Modified"));
+	}
+	return 0;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // get_station_list
 // GET https://api.wmata.com/Rail.svc/json/jStations?LineCode=line_code HTTP/1.1
-// Cache-Control: no-cache
+// If-None-Match: ETAG
 // api_key: MY_KEY
 //
 // Parameters:
@@ -40,19 +153,8 @@ std::string extract_value(const std::string& content, const std::string& key)
 
 int get_station_list(const std::string& api_key, const std::string& line_code)
 {
-	const std::string host = "api.wmata.com";
-	const std::string port_num = "443";
-	std::stringstream http;
-	http << "GET /Rail.svc/json/jStations?LineCode=" << line_code << " HTTP/1.1\r\n";
-	http << "Host: " << host << "\r\n";
-	http << "Accept: application/json\r\n";
-	http << "Cache-Control: no-cache\r\n";
-	http << "api_key: " << api_key << "\r\n";
-	http << "Connection: close\r\n\r\n";
-	std::cout << http.str() << std::endl;
-
 	std::string json;
-	ssl_read(host, port_num, http.str(), json);
+	get_cached(api_host(), "/Rail.svc/json/jStations?LineCode=" + line_code, "application/json", api_key, json);
 
 	if (!json.size())
 	{
@@ -71,10 +173,10 @@ int get_station_list(const std::string& api_key, const std::string& line_code)
 // get_gtfs_rail
 // Download WMATA Rail GTFS static data ZIP file
 // GET https://api.wmata.com/gtfs/rail-gtfs-static.zip HTTP/1.1
-// Cache-Control: no-cache
+// If-None-Match: ETAG
 // api_key: MY_KEY
 // Output:
-//   wmata_rail_gtfs.zip - GTFS data archive containing:
+//   gtfs.zip - GTFS data archive containing:
 //     - shapes.txt (detailed track coordinates)
 //     - stops.txt (station locations)
 //     - routes.txt (line information)
@@ -84,35 +186,21 @@ int get_station_list(const std::string& api_key, const std::string& line_code)
 
 int get_gtfs_rail(const std::string& api_key)
 {
-	const std::string host = "api.wmata.com";
-	const std::string port_num = "443";
-	const std::string path = "/gtfs/rail-gtfs-static.zip";
-
-	std::stringstream http;
-	http << "GET " << path << " HTTP/1.1\r\n";
-	http << "Host: " << host << "\r\n";
-	http << "Accept: application/zip, */*\r\n";
-	http << "Cache-Control: no-cache\r\n";
-	http << "api_key: " << api_key << "\r\n";
-	http << "Connection: close\r\n\r\n";
-
-	std::cout << http.str() << std::endl;
-
-	std::string response;
-	ssl_read(host, port_num, http.str(), response);
-
-	std::string zip_data = response;
-
-	std::string filename = "gtfs.zip";
-	std::ofstream ofs(filename, std::ios::binary);
-	if (!ofs.is_open())
-	{
-		return -1;
-	}
-
-	ofs.write(zip_data.c_str(), zip_data.size());
-	ofs.close();
-	return 0;
+	//the body is the archive itself; it is streamed to gtfs.zip.part in fixed size blocks, renamed
+	//to gtfs.zip when complete and read in place, never extracted
+	//an interrupted transfer is resumed from gtfs.zip.part with a Range request
+	http_cache_t cache("cache");
+	std::vector<download_t> downloads;
+	downloads.push_back(make_download("gtfs", api_host(), "/gtfs/rail-gtfs-static.zip", "application/zip, */*", api_key, "gtfs.zip"));
+	downloads[0].port = api_port();
+	downloads[0].stream = true;
+
+	download_options_t options;
+	options.cache = &cache;
+	options.timeout = std::chrono::minutes(5);
+	int failed = download_all(downloads, options);
+	download_report(downloads, downloads[0].ms, std::cout);
+	return failed == 0 ? 0 : -1;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -128,8 +216,8 @@ int get_gtfs_rail(const std::string& api_key)
 
 int get_rail_predictions(const std::string& api_key, const std::string& station_codes)
 {
-	const std::string host = "api.wmata.com";
-	const std::string port_num = "443";
+	const std::string& host = api_host();
+	const std::string& port_num = api_port();
 	std::stringstream http;
 	http << "GET /StationPrediction.svc/json/GetPrediction/" << station_codes << " HTTP/1.1\r\n";
 	http << "Host: " << host << "\r\n";
@@ -137,7 +225,7 @@ int get_rail_predictions(const std::string& api_key, const std::string& station_
 	http << "Cache-Control: no-cache\r\n";
 	http << "api_key: " << api_key << "\r\n";
 	http << "Connection: close\r\n\r\n";
-	std::cout << http.str() << std::endl;
+	std::cout << "GET /StationPrediction.svc/json/GetPrediction/" << station_codes << std::endl;
 
 	std::string json;
 	ssl_read(host, port_num, http.str(), json);
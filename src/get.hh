@@ -7,5 +7,9 @@ int get_station_list(const std::string& api_key, const std::string& line_code);
 int get_gtfs_rail(const std::string& api_key);
 int get_rail_predictions(const std::string& api_key, const std::string& station_codes);
 std::string extract_value(const std::string& content, const std::string& key);
+double extract_number(const std::string& content, const std::string& key, double default_value);
+void set_api_endpoint(const std::string& config);
+const std::string& api_host();
+const std::string& api_port();
 
 #endif
\ No newline at end of file
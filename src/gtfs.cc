@@ -0,0 +1,1333 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include "csv.hh"
+#include "loader.hh"
+#include "zip.hh"
+#include "gtfs.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t::string_pool_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const size_t pool_block_size = 64 * 1024;
+
+string_pool_t::string_pool_t() :
+  block_used(pool_block_size),
+  block_bytes(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t::intern
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t string_pool_t::intern(std::string_view str)
+{
+  if (str.empty())
+  {
+    return gtfs_none;
+  }
+
+  std::unordered_map<std::string_view, uint32_t>::const_iterator it = index.find(str);
+  if (it != index.end())
+  {
+    return it->second;
+  }
+
+  //strings longer than a block get a block of their own
+  char* dst = nullptr;
+  if (str.size() > pool_block_size)
+  {
+    blocks.emplace_back(new char[str.size()]);
+    block_bytes += str.size();
+    block_used = pool_block_size;
+    dst = blocks.back().get();
+  }
+  else
+  {
+    if (block_used + str.size() > pool_block_size)
+    {
+      blocks.emplace_back(new char[pool_block_size]);
+      block_bytes += pool_block_size;
+      block_used = 0;
+    }
+    dst = blocks.back().get() + block_used;
+    block_used += str.size();
+  }
+
+  std::memcpy(dst, str.data(), str.size());
+  uint32_t id = static_cast<uint32_t>(strings.size());
+  strings.push_back(std::string_view(dst, str.size()));
+  index.emplace(strings.back(), id);
+  return id;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t::find
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t string_pool_t::find(std::string_view str) const
+{
+  std::unordered_map<std::string_view, uint32_t>::const_iterator it = index.find(str);
+  if (it == index.end())
+  {
+    return gtfs_none;
+  }
+  return it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t::str
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string_view string_pool_t::str(uint32_t id) const
+{
+  if (id >= strings.size())
+  {
+    return std::string_view();
+  }
+  return strings[id];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t::memory
+// approximate bytes held, including the hash index
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t string_pool_t::memory() const
+{
+  size_t bytes = block_bytes;
+  bytes += strings.capacity() * sizeof(std::string_view);
+  bytes += index.bucket_count() * sizeof(void*);
+  bytes += index.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+  return bytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// chunk_count
+// number of chunks to split a table of size bytes into
+// small tables stay on one thread; large ones get a few chunks per thread for load balance
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const size_t min_chunk_size = 256 * 1024;
+
+size_t chunk_count(size_t size, size_t& nbr_threads)
+{
+  if (nbr_threads == 0)
+  {
+    nbr_threads = std::thread::hardware_concurrency();
+  }
+  if (nbr_threads == 0)
+  {
+    nbr_threads = 1;
+  }
+
+  size_t nbr_chunks = nbr_threads * 4;
+  if (nbr_chunks > size / min_chunk_size)
+  {
+    nbr_chunks = size / min_chunk_size;
+  }
+  if (nbr_chunks == 0)
+  {
+    nbr_chunks = 1;
+  }
+  return nbr_chunks;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// chunk_t
+// rows tokenized from one chunk; ids are string_views into the mapped file, or into copies
+// for the rare fields that needed unescaping
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename row_t>
+struct chunk_t
+{
+  std::vector<row_t> rows;
+  std::deque<std::string> copies;
+
+  std::string_view keep(const csv_reader_t& reader, std::string_view str)
+  {
+    if (str.empty() || reader.in_input(str))
+    {
+      return str;
+    }
+    copies.push_back(std::string(str));
+    return copies.back();
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parse_chunks
+// split csv into newline-aligned chunks and call fn(reader, chunk) for every record, chunks in parallel
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename row_t, typename fn_t>
+void parse_chunks(const csv_reader_t& csv, size_t size, size_t nbr_threads, std::vector<chunk_t<row_t>>& chunks, fn_t fn)
+{
+  size_t nbr_chunks = chunk_count(size, nbr_threads);
+  std::vector<size_t> bounds = csv.split(nbr_chunks);
+  chunks.clear();
+  chunks.resize(bounds.size() - 1);
+
+  parallel_for(chunks.size(), [&](size_t idx)
+    {
+      csv_reader_t reader = csv.chunk(bounds[idx], bounds[idx + 1]);
+      while (reader.next())
+      {
+        fn(reader, chunks[idx]);
+      }
+    }, nbr_threads);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parse_gtfs_time
+// "H:MM:SS" or "HH:MM:SS" to seconds; hours may be 24 or more for trips past midnight
+// returns -1 for an empty or malformed field
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t parse_gtfs_time(std::string_view str)
+{
+  int32_t part[3] = { 0, 0, 0 };
+  size_t nbr_part = 0;
+  bool digit = false;
+
+  for (size_t idx = 0; idx < str.size(); ++idx)
+  {
+    char c = str[idx];
+    if (c >= '0' && c <= '9')
+    {
+      part[nbr_part] = part[nbr_part] * 10 + (c - '0');
+      digit = true;
+    }
+    else if (c == ':' && digit && nbr_part < 2)
+    {
+      ++nbr_part;
+      digit = false;
+    }
+    else if (c != ' ')
+    {
+      return -1;
+    }
+  }
+
+  if (nbr_part != 2 || !digit)
+  {
+    return -1;
+  }
+  return part[0] * 3600 + part[1] * 60 + part[2];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::gtfs_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+gtfs_t::gtfs_t() :
+  source_zip(nullptr)
+{
+  feed_info.publisher_name = gtfs_none;
+  feed_info.lang = gtfs_none;
+  feed_info.version = gtfs_none;
+  feed_info.start_date = 0;
+  feed_info.end_date = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// table_text_t
+// contents of one table: mapped from a feed directory, or inflated from an archive
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class table_text_t
+{
+public:
+  const char* data() const { return inflated.empty() ? file.data() : inflated.data(); }
+  size_t size() const { return inflated.empty() ? file.size() : inflated.size(); }
+  mmap_file_t file;
+  std::string inflated;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load
+// load every GTFS table found in gtfs_path, a feed directory or a .zip archive
+// returns -1 if the feed has neither stops.txt nor trips.txt
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load(const std::string& gtfs_path, size_t nbr_threads)
+{
+  if (is_zip_path(gtfs_path))
+  {
+    zip_reader_t zip;
+    if (zip.open(gtfs_path) != 0)
+    {
+      return -1;
+    }
+    return load(zip, nbr_threads);
+  }
+
+  source_dir = gtfs_path;
+  source_zip = nullptr;
+  return load_tables(nbr_threads);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load
+// load from an open archive, on disk or in memory (a downloaded feed)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load(const zip_reader_t& zip, size_t nbr_threads)
+{
+  source_dir.clear();
+  source_zip = &zip;
+  int result = load_tables(nbr_threads);
+  source_zip = nullptr;
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::open_table
+// returns -1 if the table is absent or cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::open_table(const char* table, table_text_t& text) const
+{
+  if (source_zip)
+  {
+    size_t idx = source_zip->find(table);
+    if (idx == zip_npos)
+    {
+      return -1;
+    }
+    if (source_zip->read(idx, text.inflated) != 0)
+    {
+      std::cout << "cannot inflate " << table << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+  return text.file.open(source_dir + "/" + table);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_tables
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_tables(size_t nbr_threads)
+{
+  load_feed_info("feed_info.txt");
+  load_agency("agency.txt");
+  load_levels("levels.txt");
+  int stops_result = load_stops("stops.txt");
+  load_routes("routes.txt");
+  load_calendar("calendar.txt");
+  load_calendar_dates("calendar_dates.txt");
+  int trips_result = load_trips("trips.txt");
+  load_shapes("shapes.txt", nbr_threads);
+  load_stop_times("stop_times.txt", nbr_threads);
+  load_pathways("pathways.txt");
+  build_indexes();
+
+  if (stops_result != 0 && trips_result != 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::find
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t gtfs_t::find(key_t key, std::string_view id) const
+{
+  uint32_t str_id = strings.find(id);
+  if (str_id == gtfs_none || str_id >= keys[key].size())
+  {
+    return gtfs_none;
+  }
+  return keys[key][str_id];
+}
+
+uint32_t gtfs_t::find_stop(std::string_view stop_id) const
+{
+  return find(key_stop, stop_id);
+}
+
+uint32_t gtfs_t::find_route(std::string_view route_id) const
+{
+  return find(key_route, route_id);
+}
+
+uint32_t gtfs_t::find_trip(std::string_view trip_id) const
+{
+  return find(key_trip, trip_id);
+}
+
+uint32_t gtfs_t::find_shape(std::string_view shape_id) const
+{
+  return find(key_shape, shape_id);
+}
+
+uint32_t gtfs_t::find_service(std::string_view service_id) const
+{
+  return find(key_service, service_id);
+}
+
+uint32_t gtfs_t::find_train(std::string_view train_id) const
+{
+  return find(key_train, train_id);
+}
+
+uint32_t gtfs_t::find_level(std::string_view level_id) const
+{
+  return find(key_level, level_id);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::add_key
+// register row for str_id unless the id already has one; returns the row for the id
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t gtfs_t::add_key(key_t key, uint32_t str_id, uint32_t row)
+{
+  std::vector<uint32_t>& map = keys[key];
+  if (str_id >= map.size())
+  {
+    map.resize(strings.size(), gtfs_none);
+  }
+  if (map[str_id] == gtfs_none)
+  {
+    map[str_id] = row;
+  }
+  return map[str_id];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::add_*
+// row for an id, appending a row with default columns when the id is new
+// lets a table reference rows (a trip's shape, a stop's parent) before their own table is read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t gtfs_t::add_stop(std::string_view stop_id)
+{
+  uint32_t str_id = strings.intern(stop_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_stop, str_id, static_cast<uint32_t>(stops.size()));
+  if (row == stops.size())
+  {
+    stops.stop_id.push_back(str_id);
+    stops.name.push_back(gtfs_none);
+    stops.lat.push_back(0.0);
+    stops.lon.push_back(0.0);
+    stops.location_type.push_back(0);
+    stops.parent.push_back(gtfs_none);
+    stops.station.push_back(gtfs_none);
+    stops.level.push_back(gtfs_none);
+    stops.wheelchair_boarding.push_back(0);
+  }
+  return row;
+}
+
+uint32_t gtfs_t::add_route(std::string_view route_id)
+{
+  uint32_t str_id = strings.intern(route_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_route, str_id, static_cast<uint32_t>(routes.size()));
+  if (row == routes.size())
+  {
+    routes.route_id.push_back(str_id);
+    routes.agency.push_back(gtfs_none);
+    routes.short_name.push_back(gtfs_none);
+    routes.long_name.push_back(gtfs_none);
+    routes.type.push_back(-1);
+    routes.color.push_back(gtfs_none);
+    routes.text_color.push_back(gtfs_none);
+  }
+  return row;
+}
+
+uint32_t gtfs_t::add_service(std::string_view service_id)
+{
+  uint32_t str_id = strings.intern(service_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_service, str_id, static_cast<uint32_t>(services.size()));
+  if (row == services.size())
+  {
+    services.service_id.push_back(str_id);
+  }
+  return row;
+}
+
+uint32_t gtfs_t::add_shape(std::string_view shape_id)
+{
+  uint32_t str_id = strings.intern(shape_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_shape, str_id, static_cast<uint32_t>(shapes.size()));
+  if (row == shapes.size())
+  {
+    shapes.shape_id.push_back(str_id);
+  }
+  return row;
+}
+
+uint32_t gtfs_t::add_train(std::string_view train_id)
+{
+  uint32_t str_id = strings.intern(train_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_train, str_id, static_cast<uint32_t>(trains.size()));
+  if (row == trains.size())
+  {
+    trains.train_id.push_back(str_id);
+  }
+  return row;
+}
+
+uint32_t gtfs_t::add_level(std::string_view level_id)
+{
+  uint32_t str_id = strings.intern(level_id);
+  if (str_id == gtfs_none)
+  {
+    return gtfs_none;
+  }
+  uint32_t row = add_key(key_level, str_id, static_cast<uint32_t>(levels.size()));
+  if (row == levels.size())
+  {
+    levels.level_id.push_back(str_id);
+    levels.index.push_back(0.0);
+    levels.name.push_back(gtfs_none);
+  }
+  return row;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_feed_info
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_feed_info(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_publisher = csv.column("feed_publisher_name");
+  const int col_lang = csv.column("feed_lang");
+  const int col_version = csv.column("feed_version");
+  const int col_start = csv.column("feed_start_date");
+  const int col_end = csv.column("feed_end_date");
+
+  if (csv.next())
+  {
+    feed_info.publisher_name = strings.intern(csv.field(col_publisher));
+    feed_info.lang = strings.intern(csv.field(col_lang));
+    feed_info.version = strings.intern(csv.field(col_version));
+    feed_info.start_date = csv.to_int(col_start);
+    feed_info.end_date = csv.to_int(col_end);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_agency
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_agency(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("agency_id");
+  const int col_name = csv.column("agency_name");
+  const int col_url = csv.column("agency_url");
+  const int col_timezone = csv.column("agency_timezone");
+
+  while (csv.next())
+  {
+    uint32_t str_id = strings.intern(csv.field(col_id));
+    uint32_t row = static_cast<uint32_t>(agencies.size());
+    if (str_id != gtfs_none)
+    {
+      add_key(key_agency, str_id, row);
+    }
+    agencies.agency_id.push_back(str_id);
+    agencies.name.push_back(strings.intern(csv.field(col_name)));
+    agencies.url.push_back(strings.intern(csv.field(col_url)));
+    agencies.timezone.push_back(strings.intern(csv.field(col_timezone)));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_levels
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_levels(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("level_id");
+  const int col_index = csv.column("level_index");
+  const int col_name = csv.column("level_name");
+
+  while (csv.next())
+  {
+    uint32_t row = add_level(csv.field(col_id));
+    if (row == gtfs_none)
+    {
+      continue;
+    }
+    levels.index[row] = csv.to_double(col_index);
+    levels.name[row] = strings.intern(csv.field(col_name));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_stops
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_stops(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("stop_id");
+  const int col_name = csv.column("stop_name");
+  const int col_lat = csv.column("stop_lat");
+  const int col_lon = csv.column("stop_lon");
+  const int col_location_type = csv.column("location_type");
+  const int col_parent = csv.column("parent_station");
+  const int col_level = csv.column("level_id");
+  const int col_wheelchair = csv.column("wheelchair_boarding");
+
+  while (csv.next())
+  {
+    uint32_t row = add_stop(csv.field(col_id));
+    if (row == gtfs_none)
+    {
+      continue;
+    }
+    stops.name[row] = strings.intern(csv.field(col_name));
+    stops.lat[row] = csv.to_double(col_lat);
+    stops.lon[row] = csv.to_double(col_lon);
+    stops.location_type[row] = static_cast<uint8_t>(csv.to_int(col_location_type));
+    stops.wheelchair_boarding[row] = static_cast<uint8_t>(csv.to_int(col_wheelchair));
+    stops.level[row] = add_level(csv.field(col_level));
+
+    std::string_view parent = csv.field(col_parent);
+    if (!parent.empty())
+    {
+      uint32_t parent_row = add_stop(parent);
+      stops.parent[row] = parent_row;
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_routes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_routes(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("route_id");
+  const int col_agency = csv.column("agency_id");
+  const int col_short_name = csv.column("route_short_name");
+  const int col_long_name = csv.column("route_long_name");
+  const int col_type = csv.column("route_type");
+  const int col_color = csv.column("route_color");
+  const int col_text_color = csv.column("route_text_color");
+
+  while (csv.next())
+  {
+    uint32_t row = add_route(csv.field(col_id));
+    if (row == gtfs_none)
+    {
+      continue;
+    }
+    routes.agency[row] = find(key_agency, csv.field(col_agency));
+    routes.short_name[row] = strings.intern(csv.field(col_short_name));
+    routes.long_name[row] = strings.intern(csv.field(col_long_name));
+    routes.type[row] = static_cast<int16_t>(csv.to_int(col_type, -1));
+    routes.color[row] = strings.intern(csv.field(col_color));
+    routes.text_color[row] = strings.intern(csv.field(col_text_color));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_calendar
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_calendar(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_service = csv.column("service_id");
+  const int col_day[7] =
+  {
+    csv.column("monday"), csv.column("tuesday"), csv.column("wednesday"), csv.column("thursday"),
+    csv.column("friday"), csv.column("saturday"), csv.column("sunday")
+  };
+  const int col_start = csv.column("start_date");
+  const int col_end = csv.column("end_date");
+
+  while (csv.next())
+  {
+    uint32_t service = add_service(csv.field(col_service));
+    if (service == gtfs_none)
+    {
+      continue;
+    }
+    uint8_t days = 0;
+    for (int day = 0; day < 7; ++day)
+    {
+      if (csv.to_int(col_day[day]) == 1)
+      {
+        days |= static_cast<uint8_t>(1 << day);
+      }
+    }
+    calendar.service.push_back(service);
+    calendar.days.push_back(days);
+    calendar.start_date.push_back(csv.to_int(col_start));
+    calendar.end_date.push_back(csv.to_int(col_end));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_calendar_dates
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_calendar_dates(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_service = csv.column("service_id");
+  const int col_date = csv.column("date");
+  const int col_exception = csv.column("exception_type");
+
+  while (csv.next())
+  {
+    uint32_t service = add_service(csv.field(col_service));
+    if (service == gtfs_none)
+    {
+      continue;
+    }
+    calendar_dates.service.push_back(service);
+    calendar_dates.date.push_back(csv.to_int(col_date));
+    calendar_dates.exception_type.push_back(static_cast<uint8_t>(csv.to_int(col_exception)));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_trips
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_trips(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("trip_id");
+  const int col_route = csv.column("route_id");
+  const int col_service = csv.column("service_id");
+  const int col_headsign = csv.column("trip_headsign");
+  const int col_direction = csv.column("direction_id");
+  const int col_shape = csv.column("shape_id");
+  const int col_train = csv.column("train_id");
+
+  while (csv.next())
+  {
+    uint32_t str_id = strings.intern(csv.field(col_id));
+    if (str_id == gtfs_none)
+    {
+      continue;
+    }
+    uint32_t row = add_key(key_trip, str_id, static_cast<uint32_t>(trips.size()));
+    if (row != trips.size())
+    {
+      //duplicate trip_id, keep the first
+      continue;
+    }
+    trips.trip_id.push_back(str_id);
+    trips.route.push_back(add_route(csv.field(col_route)));
+    trips.service.push_back(add_service(csv.field(col_service)));
+    trips.headsign.push_back(strings.intern(csv.field(col_headsign)));
+    trips.direction.push_back(static_cast<uint8_t>(csv.to_int(col_direction)));
+    trips.shape.push_back(add_shape(csv.field(col_shape)));
+    trips.train.push_back(add_train(csv.field(col_train)));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_shapes
+// chunks are tokenized in parallel, then rows are bucketed by shape (counting sort into the
+// CSR arrays) and each shape is sorted by sequence on the thread pool
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct shape_row_t
+{
+  std::string_view shape_id;
+  int32_t sequence;
+  double lat;
+  double lon;
+  float dist_traveled;
+};
+
+int gtfs_t::load_shapes(const char* table, size_t nbr_threads)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    shapes.offsets.assign(shapes.size() + 1, 0);
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("shape_id");
+  const int col_lat = csv.column("shape_pt_lat");
+  const int col_lon = csv.column("shape_pt_lon");
+  const int col_sequence = csv.column("shape_pt_sequence");
+  const int col_dist = csv.column("shape_dist_traveled");
+
+  std::vector<chunk_t<shape_row_t>> chunks;
+  parse_chunks(csv, file.size(), nbr_threads, chunks, [&](const csv_reader_t& reader, chunk_t<shape_row_t>& chunk)
+    {
+      shape_row_t row;
+      row.shape_id = chunk.keep(reader, reader.field(col_id));
+      if (row.shape_id.empty())
+      {
+        return;
+      }
+      row.sequence = reader.to_int(col_sequence);
+      row.lat = reader.to_double(col_lat);
+      row.lon = reader.to_double(col_lon);
+      row.dist_traveled = static_cast<float>(reader.to_double(col_dist));
+      chunk.rows.push_back(row);
+    });
+
+  //resolve shape rows in file order; consecutive rows normally share a shape
+  std::vector<uint32_t> row_shape;
+  std::string_view last_id;
+  uint32_t last_shape = gtfs_none;
+  for (size_t idx = 0; idx < chunks.size(); ++idx)
+  {
+    for (size_t jdx = 0; jdx < chunks[idx].rows.size(); ++jdx)
+    {
+      const shape_row_t& row = chunks[idx].rows[jdx];
+      if (last_shape == gtfs_none || row.shape_id != last_id)
+      {
+        last_shape = add_shape(row.shape_id);
+        last_id = row.shape_id;
+      }
+      row_shape.push_back(last_shape);
+    }
+  }
+
+  shapes.offsets.assign(shapes.size() + 1, 0);
+  for (size_t idx = 0; idx < row_shape.size(); ++idx)
+  {
+    ++shapes.offsets[row_shape[idx] + 1];
+  }
+  for (size_t idx = 1; idx < shapes.offsets.size(); ++idx)
+  {
+    shapes.offsets[idx] += shapes.offsets[idx - 1];
+  }
+
+  std::vector<uint32_t> fill(shapes.offsets.begin(), shapes.offsets.end() - 1);
+  std::vector<int32_t> sequence(row_shape.size());
+  shapes.lat.resize(row_shape.size());
+  shapes.lon.resize(row_shape.size());
+  shapes.dist_traveled.resize(row_shape.size());
+
+  size_t nbr_row = 0;
+  for (size_t idx = 0; idx < chunks.size(); ++idx)
+  {
+    for (size_t jdx = 0; jdx < chunks[idx].rows.size(); ++jdx, ++nbr_row)
+    {
+      const shape_row_t& row = chunks[idx].rows[jdx];
+      uint32_t pos = fill[row_shape[nbr_row]]++;
+      sequence[pos] = row.sequence;
+      shapes.lat[pos] = row.lat;
+      shapes.lon[pos] = row.lon;
+      shapes.dist_traveled[pos] = row.dist_traveled;
+    }
+    chunks[idx].rows = std::vector<shape_row_t>();
+  }
+
+  parallel_for(shapes.size(), [&](size_t shape)
+    {
+      uint32_t begin = shapes.offsets[shape];
+      uint32_t end = shapes.offsets[shape + 1];
+      if (std::is_sorted(sequence.begin() + begin, sequence.begin() + end))
+      {
+        return;
+      }
+      std::vector<uint32_t> order(end - begin);
+      for (uint32_t idx = 0; idx < order.size(); ++idx)
+      {
+        order[idx] = begin + idx;
+      }
+      std::stable_sort(order.begin(), order.end(), [&sequence](uint32_t a, uint32_t b) { return sequence[a] < sequence[b]; });
+      std::vector<double> lat(order.size()), lon(order.size());
+      std::vector<float> dist(order.size());
+      for (size_t idx = 0; idx < order.size(); ++idx)
+      {
+        lat[idx] = shapes.lat[order[idx]];
+        lon[idx] = shapes.lon[order[idx]];
+        dist[idx] = shapes.dist_traveled[order[idx]];
+      }
+      std::copy(lat.begin(), lat.end(), shapes.lat.begin() + begin);
+      std::copy(lon.begin(), lon.end(), shapes.lon.begin() + begin);
+      std::copy(dist.begin(), dist.end(), shapes.dist_traveled.begin() + begin);
+    }, nbr_threads);
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_stop_times
+// same scheme as load_shapes, bucketed by trip; rows of unknown trips or stops are dropped
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct stop_time_row_t
+{
+  std::string_view trip_id;
+  std::string_view stop_id;
+  int32_t arrival;
+  int32_t departure;
+  uint32_t sequence;
+};
+
+int gtfs_t::load_stop_times(const char* table, size_t nbr_threads)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    stop_times.offsets.assign(trips.size() + 1, 0);
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_trip = csv.column("trip_id");
+  const int col_stop = csv.column("stop_id");
+  const int col_arrival = csv.column("arrival_time");
+  const int col_departure = csv.column("departure_time");
+  const int col_sequence = csv.column("stop_sequence");
+
+  std::vector<chunk_t<stop_time_row_t>> chunks;
+  parse_chunks(csv, file.size(), nbr_threads, chunks, [&](const csv_reader_t& reader, chunk_t<stop_time_row_t>& chunk)
+    {
+      stop_time_row_t row;
+      row.trip_id = chunk.keep(reader, reader.field(col_trip));
+      row.stop_id = chunk.keep(reader, reader.field(col_stop));
+      row.arrival = parse_gtfs_time(reader.field(col_arrival));
+      row.departure = parse_gtfs_time(reader.field(col_departure));
+      row.sequence = static_cast<uint32_t>(reader.to_int(col_sequence));
+      if (row.arrival < 0)
+      {
+        row.arrival = row.departure;
+      }
+      if (row.departure < 0)
+      {
+        row.departure = row.arrival;
+      }
+      chunk.rows.push_back(row);
+    });
+
+  std::vector<uint32_t> row_trip;
+  std::vector<uint32_t> row_stop;
+  std::string_view last_id;
+  uint32_t last_trip = gtfs_none;
+  for (size_t idx = 0; idx < chunks.size(); ++idx)
+  {
+    for (size_t jdx = 0; jdx < chunks[idx].rows.size(); ++jdx)
+    {
+      const stop_time_row_t& row = chunks[idx].rows[jdx];
+      if (row.trip_id != last_id)
+      {
+        last_trip = find(key_trip, row.trip_id);
+        last_id = row.trip_id;
+      }
+      row_trip.push_back(last_trip);
+      row_stop.push_back(find(key_stop, row.stop_id));
+    }
+  }
+
+  stop_times.offsets.assign(trips.size() + 1, 0);
+  for (size_t idx = 0; idx < row_trip.size(); ++idx)
+  {
+    if (row_trip[idx] != gtfs_none && row_stop[idx] != gtfs_none)
+    {
+      ++stop_times.offsets[row_trip[idx] + 1];
+    }
+  }
+  for (size_t idx = 1; idx < stop_times.offsets.size(); ++idx)
+  {
+    stop_times.offsets[idx] += stop_times.offsets[idx - 1];
+  }
+
+  size_t nbr_stop_times = stop_times.offsets.back();
+  std::vector<uint32_t> fill(stop_times.offsets.begin(), stop_times.offsets.end() - 1);
+  stop_times.stop.resize(nbr_stop_times);
+  stop_times.arrival.resize(nbr_stop_times);
+  stop_times.departure.resize(nbr_stop_times);
+  stop_times.sequence.resize(nbr_stop_times);
+
+  size_t nbr_row = 0;
+  for (size_t idx = 0; idx < chunks.size(); ++idx)
+  {
+    for (size_t jdx = 0; jdx < chunks[idx].rows.size(); ++jdx, ++nbr_row)
+    {
+      if (row_trip[nbr_row] == gtfs_none || row_stop[nbr_row] == gtfs_none)
+      {
+        continue;
+      }
+      const stop_time_row_t& row = chunks[idx].rows[jdx];
+      uint32_t pos = fill[row_trip[nbr_row]]++;
+      stop_times.stop[pos] = row_stop[nbr_row];
+      stop_times.arrival[pos] = row.arrival;
+      stop_times.departure[pos] = row.departure;
+      stop_times.sequence[pos] = row.sequence;
+    }
+    chunks[idx].rows = std::vector<stop_time_row_t>();
+  }
+
+  parallel_for(trips.size(), [&](size_t trip)
+    {
+      uint32_t begin = stop_times.offsets[trip];
+      uint32_t end = stop_times.offsets[trip + 1];
+      if (std::is_sorted(stop_times.sequence.begin() + begin, stop_times.sequence.begin() + end))
+      {
+        return;
+      }
+      std::vector<uint32_t> order(end - begin);
+      for (uint32_t idx = 0; idx < order.size(); ++idx)
+      {
+        order[idx] = begin + idx;
+      }
+      std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return stop_times.sequence[a] < stop_times.sequence[b]; });
+      std::vector<uint32_t> stop(order.size()), sequence(order.size());
+      std::vector<int32_t> arrival(order.size()), departure(order.size());
+      for (size_t idx = 0; idx < order.size(); ++idx)
+      {
+        stop[idx] = stop_times.stop[order[idx]];
+        sequence[idx] = stop_times.sequence[order[idx]];
+        arrival[idx] = stop_times.arrival[order[idx]];
+        departure[idx] = stop_times.departure[order[idx]];
+      }
+      std::copy(stop.begin(), stop.end(), stop_times.stop.begin() + begin);
+      std::copy(sequence.begin(), sequence.end(), stop_times.sequence.begin() + begin);
+      std::copy(arrival.begin(), arrival.end(), stop_times.arrival.begin() + begin);
+      std::copy(departure.begin(), departure.end(), stop_times.departure.begin() + begin);
+    }, nbr_threads);
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::load_pathways
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_t::load_pathways(const char* table)
+{
+  table_text_t file;
+  if (open_table(table, file) != 0)
+  {
+    return -1;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  const int col_id = csv.column("pathway_id");
+  const int col_from = csv.column("from_stop_id");
+  const int col_to = csv.column("to_stop_id");
+  const int col_mode = csv.column("pathway_mode");
+  const int col_bidirectional = csv.column("is_bidirectional");
+  const int col_length = csv.column("length");
+  const int col_time = csv.column("traversal_time");
+  const int col_stairs = csv.column("stair_count");
+
+  while (csv.next())
+  {
+    uint32_t from = find(key_stop, csv.field(col_from));
+    uint32_t to = find(key_stop, csv.field(col_to));
+    if (from == gtfs_none || to == gtfs_none)
+    {
+      continue;
+    }
+    pathways.pathway_id.push_back(strings.intern(csv.field(col_id)));
+    pathways.from.push_back(from);
+    pathways.to.push_back(to);
+    pathways.mode.push_back(static_cast<uint8_t>(csv.to_int(col_mode)));
+    pathways.bidirectional.push_back(static_cast<uint8_t>(csv.to_int(col_bidirectional)));
+    pathways.length.push_back(static_cast<float>(csv.to_double(col_length, -1.0)));
+    pathways.traversal_time.push_back(csv.to_int(col_time, -1));
+    pathways.stair_count.push_back(static_cast<int16_t>(csv.to_int(col_stairs)));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// build_csr
+// group items by key into offsets/list; keys in [0, nbr_keys), items in input order
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void build_csr(size_t nbr_keys, const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+  std::vector<uint32_t>& offsets, std::vector<uint32_t>& list)
+{
+  offsets.assign(nbr_keys + 1, 0);
+  for (size_t idx = 0; idx < pairs.size(); ++idx)
+  {
+    ++offsets[pairs[idx].first + 1];
+  }
+  for (size_t idx = 1; idx < offsets.size(); ++idx)
+  {
+    offsets[idx] += offsets[idx - 1];
+  }
+  list.resize(pairs.size());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t idx = 0; idx < pairs.size(); ++idx)
+  {
+    list[fill[pairs[idx].first]++] = pairs[idx].second;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::build_indexes
+// stop -> station, station -> children, route -> shapes, train_id -> trips
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void gtfs_t::build_indexes()
+{
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+
+  for (size_t stop = 0; stop < stops.size(); ++stop)
+  {
+    //walk up parent_station (boarding area -> platform -> station), bounded against cycles
+    uint32_t station = static_cast<uint32_t>(stop);
+    for (int depth = 0; depth < 4 && stops.parent[station] != gtfs_none; ++depth)
+    {
+      station = stops.parent[station];
+    }
+    stops.station[stop] = station;
+    if (station != stop)
+    {
+      pairs.push_back(std::make_pair(station, static_cast<uint32_t>(stop)));
+    }
+  }
+  build_csr(stops.size(), pairs, station_child_offsets, station_child_list);
+
+  //distinct shapes per route, in first-seen trip order
+  pairs.clear();
+  std::vector<uint32_t> shape_route(shapes.size(), gtfs_none);
+  for (size_t trip = 0; trip < trips.size(); ++trip)
+  {
+    uint32_t shape = trips.shape[trip];
+    uint32_t route = trips.route[trip];
+    if (shape == gtfs_none || route == gtfs_none || shape_route[shape] == route)
+    {
+      continue;
+    }
+    if (shape_route[shape] == gtfs_none)
+    {
+      shape_route[shape] = route;
+      pairs.push_back(std::make_pair(route, shape));
+    }
+  }
+  build_csr(routes.size(), pairs, route_shape_offsets, route_shape_list);
+
+  pairs.clear();
+  for (size_t trip = 0; trip < trips.size(); ++trip)
+  {
+    if (trips.train[trip] != gtfs_none)
+    {
+      pairs.push_back(std::make_pair(trips.train[trip], static_cast<uint32_t>(trip)));
+    }
+  }
+  build_csr(trains.size(), pairs, train_trip_offsets, train_trip_list);
+
+  if (shapes.offsets.size() != shapes.size() + 1)
+  {
+    shapes.offsets.resize(shapes.size() + 1, shapes.offsets.empty() ? 0 : shapes.offsets.back());
+  }
+  if (stop_times.offsets.size() != trips.size() + 1)
+  {
+    stop_times.offsets.resize(trips.size() + 1, stop_times.offsets.empty() ? 0 : stop_times.offsets.back());
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t index accessors
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+range_t make_range(const std::vector<uint32_t>& offsets, uint32_t key)
+{
+  range_t range = { 0, 0 };
+  if (static_cast<size_t>(key) + 1 < offsets.size())
+  {
+    range.begin = offsets[key];
+    range.end = offsets[key + 1];
+  }
+  return range;
+}
+
+range_t gtfs_t::trip_stop_times(uint32_t trip) const
+{
+  return make_range(stop_times.offsets, trip);
+}
+
+range_t gtfs_t::shape_points(uint32_t shape) const
+{
+  return make_range(shapes.offsets, shape);
+}
+
+range_t gtfs_t::route_shapes(uint32_t route) const
+{
+  return make_range(route_shape_offsets, route);
+}
+
+range_t gtfs_t::train_trips(uint32_t train) const
+{
+  return make_range(train_trip_offsets, train);
+}
+
+range_t gtfs_t::station_children(uint32_t stop) const
+{
+  return make_range(station_child_offsets, stop);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t::memory
+// approximate bytes held by the store
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+size_t bytes(const std::vector<T>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+size_t gtfs_t::memory() const
+{
+  size_t total = strings.memory();
+  total += bytes(agencies.agency_id) + bytes(agencies.name) + bytes(agencies.url) + bytes(agencies.timezone);
+  total += bytes(levels.level_id) + bytes(levels.index) + bytes(levels.name);
+  total += bytes(stops.stop_id) + bytes(stops.name) + bytes(stops.lat) + bytes(stops.lon) + bytes(stops.location_type);
+  total += bytes(stops.parent) + bytes(stops.station) + bytes(stops.level) + bytes(stops.wheelchair_boarding);
+  total += bytes(routes.route_id) + bytes(routes.agency) + bytes(routes.short_name) + bytes(routes.long_name);
+  total += bytes(routes.type) + bytes(routes.color) + bytes(routes.text_color);
+  total += bytes(services.service_id);
+  total += bytes(calendar.service) + bytes(calendar.days) + bytes(calendar.start_date) + bytes(calendar.end_date);
+  total += bytes(calendar_dates.service) + bytes(calendar_dates.date) + bytes(calendar_dates.exception_type);
+  total += bytes(trips.trip_id) + bytes(trips.route) + bytes(trips.service) + bytes(trips.headsign);
+  total += bytes(trips.direction) + bytes(trips.shape) + bytes(trips.train);
+  total += bytes(trains.train_id);
+  total += bytes(shapes.shape_id) + bytes(shapes.offsets) + bytes(shapes.lat) + bytes(shapes.lon) + bytes(shapes.dist_traveled);
+  total += bytes(stop_times.offsets) + bytes(stop_times.stop) + bytes(stop_times.arrival);
+  total += bytes(stop_times.departure) + bytes(stop_times.sequence);
+  total += bytes(pathways.pathway_id) + bytes(pathways.from) + bytes(pathways.to) + bytes(pathways.mode);
+  total += bytes(pathways.bidirectional) + bytes(pathways.length) + bytes(pathways.traversal_time) + bytes(pathways.stair_count);
+  total += bytes(route_shape_offsets) + bytes(route_shape_list);
+  total += bytes(train_trip_offsets) + bytes(train_trip_list);
+  total += bytes(station_child_offsets) + bytes(station_child_list);
+  for (int key = 0; key < nbr_keys; ++key)
+  {
+    total += bytes(keys[key]);
+  }
+  return total;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// count_rows_txt
+// tokenize every field of any GTFS table and return the number of records
+// used by gtfs_bench to measure raw chunked tokenizing speed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t count_rows_txt(const std::string& filename, size_t nbr_threads)
+{
+  mmap_file_t file;
+  if (file.open(filename) != 0)
+  {
+    return 0;
+  }
+
+  csv_reader_t csv(file.data(), file.size());
+  size_t nbr_chunks = chunk_count(file.size(), nbr_threads);
+  std::vector<size_t> bounds = csv.split(nbr_chunks);
+  std::vector<size_t> rows(bounds.size() - 1, 0);
+
+  parallel_for(rows.size(), [&](size_t idx)
+    {
+      csv_reader_t reader = csv.chunk(bounds[idx], bounds[idx + 1]);
+      while (reader.next())
+      {
+        ++rows[idx];
+      }
+    }, nbr_threads);
+
+  size_t nbr_rows = 0;
+  for (size_t idx = 0; idx < rows.size(); ++idx)
+  {
+    nbr_rows += rows[idx];
+  }
+  return nbr_rows;
+}
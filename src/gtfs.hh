@@ -0,0 +1,293 @@
+#ifndef GTFS_HH
+#define GTFS_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_none
+// missing reference or empty field in any integer column
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t gtfs_none = 0xffffffff;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// range_t
+// [begin, end) into a CSR list (stop times of a trip, points of a shape, ...)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct range_t
+{
+  uint32_t begin;
+  uint32_t end;
+  uint32_t size() const { return end - begin; }
+  bool empty() const { return end == begin; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_pool_t
+// interns strings into dense ids; characters are packed in 64 KB blocks
+// id 0 .. size() - 1; the empty string is not interned and maps to gtfs_none
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class string_pool_t
+{
+public:
+  string_pool_t();
+  uint32_t intern(std::string_view str);
+  uint32_t find(std::string_view str) const;
+  std::string_view str(uint32_t id) const;
+  size_t size() const { return strings.size(); }
+  size_t memory() const;
+
+private:
+  string_pool_t(const string_pool_t&) = delete;
+  string_pool_t& operator=(const string_pool_t&) = delete;
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t block_used;
+  size_t block_bytes;
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, uint32_t> index;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// GTFS tables
+// struct of arrays, one entry per row; the row index is the dense key used by every other table
+// string columns hold string_pool_t ids, reference columns hold row indices of the target table
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct agency_table_t
+{
+  std::vector<uint32_t> agency_id;
+  std::vector<uint32_t> name;
+  std::vector<uint32_t> url;
+  std::vector<uint32_t> timezone;
+  size_t size() const { return agency_id.size(); }
+};
+
+struct level_table_t
+{
+  std::vector<uint32_t> level_id;
+  std::vector<double> index;
+  std::vector<uint32_t> name;
+  size_t size() const { return level_id.size(); }
+};
+
+struct stop_table_t
+{
+  std::vector<uint32_t> stop_id;
+  std::vector<uint32_t> name;
+  std::vector<double> lat;
+  std::vector<double> lon;
+  std::vector<uint8_t> location_type; //0 stop/platform, 1 station, 2 entrance, 3 generic node, 4 boarding area
+  std::vector<uint32_t> parent; //parent_station row
+  std::vector<uint32_t> station; //top level station row (itself for stations), derived
+  std::vector<uint32_t> level;
+  std::vector<uint8_t> wheelchair_boarding;
+  size_t size() const { return stop_id.size(); }
+};
+
+struct route_table_t
+{
+  std::vector<uint32_t> route_id;
+  std::vector<uint32_t> agency;
+  std::vector<uint32_t> short_name;
+  std::vector<uint32_t> long_name;
+  std::vector<int16_t> type;
+  std::vector<uint32_t> color; //hex without '#'
+  std::vector<uint32_t> text_color;
+  size_t size() const { return route_id.size(); }
+};
+
+struct service_table_t
+{
+  std::vector<uint32_t> service_id;
+  size_t size() const { return service_id.size(); }
+};
+
+struct calendar_table_t
+{
+  std::vector<uint32_t> service;
+  std::vector<uint8_t> days; //bit 0 monday .. bit 6 sunday
+  std::vector<int32_t> start_date; //yyyymmdd
+  std::vector<int32_t> end_date;
+  size_t size() const { return service.size(); }
+};
+
+struct calendar_date_table_t
+{
+  std::vector<uint32_t> service;
+  std::vector<int32_t> date; //yyyymmdd
+  std::vector<uint8_t> exception_type; //1 added, 2 removed
+  size_t size() const { return service.size(); }
+};
+
+struct trip_table_t
+{
+  std::vector<uint32_t> trip_id;
+  std::vector<uint32_t> route;
+  std::vector<uint32_t> service;
+  std::vector<uint32_t> headsign;
+  std::vector<uint8_t> direction;
+  std::vector<uint32_t> shape;
+  std::vector<uint32_t> train;
+  size_t size() const { return trip_id.size(); }
+};
+
+struct train_table_t
+{
+  std::vector<uint32_t> train_id;
+  size_t size() const { return train_id.size(); }
+};
+
+//points of shape s are [offsets[s], offsets[s + 1]), ordered by shape_pt_sequence
+struct shape_table_t
+{
+  std::vector<uint32_t> shape_id;
+  std::vector<uint32_t> offsets;
+  std::vector<double> lat;
+  std::vector<double> lon;
+  std::vector<float> dist_traveled;
+  size_t size() const { return shape_id.size(); }
+};
+
+//stop times of trip t are [offsets[t], offsets[t + 1]), ordered by stop_sequence
+//times are seconds after the start of the service day and may exceed 24:00:00; -1 when empty
+struct stop_time_table_t
+{
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> stop;
+  std::vector<int32_t> arrival;
+  std::vector<int32_t> departure;
+  std::vector<uint32_t> sequence;
+  size_t size() const { return stop.size(); }
+};
+
+struct pathway_table_t
+{
+  std::vector<uint32_t> pathway_id;
+  std::vector<uint32_t> from;
+  std::vector<uint32_t> to;
+  std::vector<uint8_t> mode; //1 walkway, 2 stairs, 3 moving sidewalk, 4 escalator, 5 elevator, 6 fare gate, 7 exit gate
+  std::vector<uint8_t> bidirectional;
+  std::vector<float> length;
+  std::vector<int32_t> traversal_time; //seconds, -1 when empty
+  std::vector<int16_t> stair_count;
+  size_t size() const { return pathway_id.size(); }
+};
+
+struct feed_info_t
+{
+  uint32_t publisher_name;
+  uint32_t lang;
+  uint32_t version;
+  int32_t start_date; //yyyymmdd, 0 when absent
+  int32_t end_date;
+};
+
+class zip_reader_t;
+class table_text_t;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_t
+// columnar in-memory GTFS feed with interned ids and prebuilt indexes
+// load() reads every table present in a feed directory or a .zip archive of one; missing tables
+// stay empty; an archive is read in place, one table inflated at a time
+// find_*() map a GTFS id to its row index (gtfs_none if absent) in O(1)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class gtfs_t
+{
+public:
+  gtfs_t();
+  int load(const std::string& gtfs_path, size_t nbr_threads = 0);
+  int load(const zip_reader_t& zip, size_t nbr_threads = 0);
+  size_t memory() const;
+
+  std::string_view str(uint32_t id) const { return strings.str(id); }
+  uint32_t find_stop(std::string_view stop_id) const;
+  uint32_t find_route(std::string_view route_id) const;
+  uint32_t find_trip(std::string_view trip_id) const;
+  uint32_t find_shape(std::string_view shape_id) const;
+  uint32_t find_service(std::string_view service_id) const;
+  uint32_t find_train(std::string_view train_id) const;
+  uint32_t find_level(std::string_view level_id) const;
+
+  //indexes
+  range_t trip_stop_times(uint32_t trip) const;
+  range_t shape_points(uint32_t shape) const;
+  range_t route_shapes(uint32_t route) const; //into route_shape_list
+  range_t train_trips(uint32_t train) const; //into train_trip_list
+  range_t station_children(uint32_t stop) const; //into station_child_list
+
+  string_pool_t strings;
+  feed_info_t feed_info;
+  agency_table_t agencies;
+  level_table_t levels;
+  stop_table_t stops;
+  route_table_t routes;
+  service_table_t services;
+  calendar_table_t calendar;
+  calendar_date_table_t calendar_dates;
+  trip_table_t trips;
+  train_table_t trains;
+  shape_table_t shapes;
+  stop_time_table_t stop_times;
+  pathway_table_t pathways;
+
+  std::vector<uint32_t> route_shape_offsets;
+  std::vector<uint32_t> route_shape_list;
+  std::vector<uint32_t> train_trip_offsets;
+  std::vector<uint32_t> train_trip_list;
+  std::vector<uint32_t> station_child_offsets;
+  std::vector<uint32_t> station_child_list;
+
+private:
+  gtfs_t(const gtfs_t&) = delete;
+  gtfs_t& operator=(const gtfs_t&) = delete;
+
+  enum key_t { key_stop, key_route, key_trip, key_shape, key_service, key_train, key_level, key_agency, nbr_keys };
+  uint32_t find(key_t key, std::string_view id) const;
+  uint32_t add_key(key_t key, uint32_t str_id, uint32_t row);
+  uint32_t add_stop(std::string_view stop_id);
+  uint32_t add_route(std::string_view route_id);
+  uint32_t add_service(std::string_view service_id);
+  uint32_t add_shape(std::string_view shape_id);
+  uint32_t add_train(std::string_view train_id);
+  uint32_t add_level(std::string_view level_id);
+
+  int load_tables(size_t nbr_threads);
+  int open_table(const char* table, table_text_t& text) const;
+  int load_feed_info(const char* table);
+  int load_agency(const char* table);
+  int load_levels(const char* table);
+  int load_stops(const char* table);
+  int load_routes(const char* table);
+  int load_calendar(const char* table);
+  int load_calendar_dates(const char* table);
+  int load_trips(const char* table);
+  int load_shapes(const char* table, size_t nbr_threads);
+  int load_stop_times(const char* table, size_t nbr_threads);
+  int load_pathways(const char* table);
+  void build_indexes();
+
+  //where load_tables() reads from: a directory, or an archive when source_zip is set
+  std::string source_dir;
+  const zip_reader_t* source_zip;
+
+  //keys[key][string id] -> row, dense over the string pool
+  std::vector<uint32_t> keys[nbr_keys];
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t parse_gtfs_time(std::string_view str);
+size_t count_rows_txt(const std::string& filename, size_t nbr_threads = 0);
+
+#endif
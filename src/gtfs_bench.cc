@@ -0,0 +1,229 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstdlib>
+#include <algorithm>
+#include "csv.hh"
+#include "gtfs.hh"
+#include "feed.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// file_size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t file_size(const std::string& filename)
+{
+  mmap_file_t file;
+  if (file.open(filename) != 0)
+  {
+    return 0;
+  }
+  return file.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench_table
+// size is the number of input bytes, for MB/s
+// run parse(nbr_threads) for 1, 2, 4 ... max_threads threads, best of nbr_runs
+// parse returns the number of rows or items produced, used as a cross-check between thread counts
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void bench_table(const std::string& name, size_t size, size_t max_threads, int nbr_runs,
+  const std::function<size_t(size_t)>& parse)
+{
+  if (size == 0)
+  {
+    std::cout << std::left << std::setw(22) << name << " not found" << std::endl;
+    return;
+  }
+
+  std::vector<size_t> thread_counts;
+  for (size_t nbr_threads = 1; nbr_threads < max_threads; nbr_threads *= 2)
+  {
+    thread_counts.push_back(nbr_threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  double base_ms = 0.0;
+  for (size_t idx = 0; idx < thread_counts.size(); ++idx)
+  {
+    size_t nbr_threads = thread_counts[idx];
+    double best_ms = 1e30;
+    size_t count = 0;
+    for (int run = 0; run < nbr_runs; ++run)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      count = parse(nbr_threads);
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() < best_ms)
+      {
+        best_ms = elapsed.count();
+      }
+    }
+    if (idx == 0)
+    {
+      base_ms = best_ms;
+    }
+
+    std::cout << std::left << std::setw(22) << name << std::right
+      << std::setw(8) << nbr_threads
+      << std::setw(12) << count
+      << std::setw(12) << std::fixed << std::setprecision(2) << best_ms
+      << std::setw(10) << std::setprecision(1) << (size / (1024.0 * 1024.0)) / (best_ms / 1000.0)
+      << std::setw(10) << std::setprecision(2) << (base_ms / best_ms) << "x" << std::endl;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench_planner
+// raptor_t::query between every pair of stations at 08:00 and 17:30 of date (the first day of the
+// calendar when 0), on one thread; reports the latency distribution of single queries
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void bench_planner(const std::string& gtfs_dir, int32_t date)
+{
+  std::vector<std::string> changed_lines;
+  std::shared_ptr<feed_t> feed = build_feed(gtfs_dir, nullptr, changed_lines);
+  if (!feed || feed->raptor.nbr_patterns() == 0)
+  {
+    std::cout << "planner: no timetable in " << gtfs_dir << std::endl;
+    return;
+  }
+  if (date == 0)
+  {
+    date = feed->calendar.first_date();
+  }
+
+  std::vector<uint32_t> stations;
+  for (uint32_t stop = 0; stop < feed->gtfs.stops.size(); ++stop)
+  {
+    if (feed->gtfs.stops.location_type[stop] == 1)
+    {
+      stations.push_back(stop);
+    }
+  }
+
+  const int32_t departures[] = { 8 * 3600, 17 * 3600 + 1800 };
+  std::vector<double> us;
+  size_t found = 0;
+  size_t legs = 0;
+  journey_t journey;
+  for (size_t time = 0; time < sizeof(departures) / sizeof(departures[0]); ++time)
+  {
+    for (size_t from = 0; from < stations.size(); ++from)
+    {
+      for (size_t to = 0; to < stations.size(); ++to)
+      {
+        if (from == to)
+        {
+          continue;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int result = feed->raptor.query(stations[from], stations[to], date, departures[time], journey);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        us.push_back(elapsed.count());
+        if (result == 0)
+        {
+          ++found;
+          legs += journey.legs.size();
+        }
+      }
+    }
+  }
+  if (us.empty())
+  {
+    std::cout << "planner: no stations in " << gtfs_dir << std::endl;
+    return;
+  }
+
+  double total = 0;
+  for (size_t idx = 0; idx < us.size(); ++idx)
+  {
+    total += us[idx];
+  }
+  std::sort(us.begin(), us.end());
+  std::cout << "planner: " << feed->gtfs.trips.size() << " trips, " << feed->gtfs.stop_times.size() << " stop times, "
+    << feed->raptor.nbr_patterns() << " patterns, " << stations.size() << " stations, date " << date << std::endl;
+  std::cout << "planner: " << us.size() << " queries, " << found << " journeys, "
+    << std::fixed << std::setprecision(1) << (found ? static_cast<double>(legs) / found : 0.0) << " legs per journey" << std::endl;
+  std::cout << "planner: mean " << std::setprecision(1) << total / us.size() << " us, p50 " << us[us.size() / 2]
+    << " us, p99 " << us[us.size() * 99 / 100] << " us, max " << us.back() << " us" << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+// gtfs_bench [gtfs_dir] [max_threads] [runs] [yyyymmdd]
+// times the chunked GTFS parsers against thread count, then journey planner queries on that date
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  std::string gtfs_dir = "data/gtfs";
+  size_t max_threads = std::thread::hardware_concurrency();
+  int nbr_runs = 3;
+
+  if (argc > 1)
+  {
+    gtfs_dir = argv[1];
+  }
+  if (argc > 2)
+  {
+    max_threads = static_cast<size_t>(std::atoi(argv[2]));
+  }
+  if (argc > 3)
+  {
+    nbr_runs = std::atoi(argv[3]);
+  }
+  int32_t date = 0;
+  if (argc > 4)
+  {
+    date = std::atoi(argv[4]);
+  }
+  if (max_threads == 0)
+  {
+    max_threads = 1;
+  }
+  if (nbr_runs <= 0)
+  {
+    nbr_runs = 1;
+  }
+
+  std::cout << std::left << std::setw(22) << "table" << std::right
+    << std::setw(8) << "threads"
+    << std::setw(12) << "count"
+    << std::setw(12) << "ms"
+    << std::setw(10) << "MB/s"
+    << std::setw(11) << "speedup" << std::endl;
+
+  const char* feed_tables[] = { "agency.txt", "levels.txt", "stops.txt", "routes.txt", "calendar.txt",
+    "calendar_dates.txt", "trips.txt", "shapes.txt", "stop_times.txt", "pathways.txt", "feed_info.txt" };
+  size_t feed_size = 0;
+  for (size_t idx = 0; idx < sizeof(feed_tables) / sizeof(feed_tables[0]); ++idx)
+  {
+    feed_size += file_size(gtfs_dir + "/" + feed_tables[idx]);
+  }
+
+  bench_table("feed (gtfs_t::load)", feed_size, max_threads, nbr_runs, [&](size_t nbr_threads)
+    {
+      gtfs_t gtfs;
+      gtfs.load(gtfs_dir, nbr_threads);
+      return gtfs.shapes.lat.size() + gtfs.stop_times.size();
+    });
+
+  const char* tables[] = { "stop_times.txt", "trips.txt", "stops.txt", "pathways.txt" };
+  for (size_t idx = 0; idx < sizeof(tables) / sizeof(tables[0]); ++idx)
+  {
+    std::string filename = gtfs_dir + "/" + tables[idx];
+    bench_table(std::string(tables[idx]) + " (rows)", file_size(filename), max_threads, nbr_runs, [&](size_t nbr_threads)
+      {
+        return count_rows_txt(filename, nbr_threads);
+      });
+  }
+
+  bench_planner(gtfs_dir, date);
+  return 0;
+}
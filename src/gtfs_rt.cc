@@ -0,0 +1,395 @@
+#include <cstring>
+#include "gtfs_rt.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t
+// cursor over one protobuf message; any read past the end sets error and returns zeros, so a
+// decoder checks error once at the end instead of after every field
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum pb_wire_t
+{
+  pb_varint = 0,
+  pb_fixed64 = 1,
+  pb_bytes = 2,
+  pb_fixed32 = 5
+};
+
+struct pb_reader_t
+{
+  explicit pb_reader_t(std::string_view data) :
+    pos(reinterpret_cast<const unsigned char*>(data.data())),
+    end(reinterpret_cast<const unsigned char*>(data.data()) + data.size()),
+    error(false)
+  {
+  }
+  const unsigned char* pos;
+  const unsigned char* end;
+  bool error;
+
+  bool next(uint32_t& field, uint32_t& wire);
+  uint64_t varint();
+  std::string_view bytes();
+  uint32_t fixed32();
+  float float32();
+  void skip(uint32_t wire);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t::next
+// the next field key; false at the end of the message or on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool pb_reader_t::next(uint32_t& field, uint32_t& wire)
+{
+  if (error || pos >= end)
+  {
+    return false;
+  }
+  uint64_t key = varint();
+  field = static_cast<uint32_t>(key >> 3);
+  wire = static_cast<uint32_t>(key & 7);
+  return !error && field != 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t::varint
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t pb_reader_t::varint()
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (pos >= end)
+    {
+      error = true;
+      return 0;
+    }
+    unsigned char byte = *pos++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      return value;
+    }
+  }
+  error = true;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t::bytes
+// a length delimited field (string or embedded message), as a view into the payload
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string_view pb_reader_t::bytes()
+{
+  uint64_t size = varint();
+  if (error || size > static_cast<uint64_t>(end - pos))
+  {
+    error = true;
+    return std::string_view();
+  }
+  std::string_view view(reinterpret_cast<const char*>(pos), static_cast<size_t>(size));
+  pos += size;
+  return view;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t::fixed32
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t pb_reader_t::fixed32()
+{
+  if (end - pos < 4)
+  {
+    error = true;
+    return 0;
+  }
+  uint32_t value = static_cast<uint32_t>(pos[0]) | static_cast<uint32_t>(pos[1]) << 8 |
+    static_cast<uint32_t>(pos[2]) << 16 | static_cast<uint32_t>(pos[3]) << 24;
+  pos += 4;
+  return value;
+}
+
+float pb_reader_t::float32()
+{
+  uint32_t bits = fixed32();
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pb_reader_t::skip
+// an unused field, by wire type; groups (3, 4) are not used by GTFS-realtime and are an error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pb_reader_t::skip(uint32_t wire)
+{
+  switch (wire)
+  {
+  case pb_varint:
+    varint();
+    break;
+  case pb_fixed64:
+    if (end - pos < 8)
+    {
+      error = true;
+      return;
+    }
+    pos += 8;
+    break;
+  case pb_bytes:
+    bytes();
+    break;
+  case pb_fixed32:
+    fixed32();
+    break;
+  default:
+    error = true;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// message decoders
+// field numbers from gtfs-realtime.proto; a field with an unexpected wire type is skipped
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//TripDescriptor: 1 trip_id, 5 route_id
+bool decode_trip(std::string_view data, std::string_view& trip_id, std::string_view& route_id)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_bytes) trip_id = pb.bytes();
+    else if (field == 5 && wire == pb_bytes) route_id = pb.bytes();
+    else pb.skip(wire);
+  }
+  return !pb.error;
+}
+
+//VehicleDescriptor: 1 id, 2 label
+bool decode_vehicle_descriptor(std::string_view data, std::string_view& id, std::string_view& label)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_bytes) id = pb.bytes();
+    else if (field == 2 && wire == pb_bytes) label = pb.bytes();
+    else pb.skip(wire);
+  }
+  return !pb.error;
+}
+
+//Position: 1 latitude, 2 longitude, 3 bearing (float)
+bool decode_position(std::string_view data, rt_vehicle_t& vehicle)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_fixed32) vehicle.lat = pb.float32();
+    else if (field == 2 && wire == pb_fixed32) vehicle.lon = pb.float32();
+    else if (field == 3 && wire == pb_fixed32) vehicle.bearing = pb.float32();
+    else pb.skip(wire);
+  }
+  vehicle.has_position = true;
+  return !pb.error;
+}
+
+//VehiclePosition: 1 trip, 2 position, 3 current_stop_sequence, 4 current_status, 5 timestamp,
+//7 stop_id, 8 vehicle
+bool decode_vehicle_position(std::string_view data, rt_vehicle_t& vehicle)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  bool ok = true;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_bytes) ok = decode_trip(pb.bytes(), vehicle.trip_id, vehicle.route_id) && ok;
+    else if (field == 2 && wire == pb_bytes) ok = decode_position(pb.bytes(), vehicle) && ok;
+    else if (field == 3 && wire == pb_varint) vehicle.stop_sequence = static_cast<uint32_t>(pb.varint());
+    else if (field == 4 && wire == pb_varint) vehicle.status = static_cast<rt_stop_status_t>(pb.varint() % 3);
+    else if (field == 5 && wire == pb_varint) vehicle.timestamp = pb.varint();
+    else if (field == 7 && wire == pb_bytes) vehicle.stop_id = pb.bytes();
+    else if (field == 8 && wire == pb_bytes) ok = decode_vehicle_descriptor(pb.bytes(), vehicle.vehicle_id, vehicle.label) && ok;
+    else pb.skip(wire);
+  }
+  return ok && !pb.error;
+}
+
+//StopTimeEvent: 1 delay (int32), 2 time (int64)
+bool decode_stop_time_event(std::string_view data, int64_t& time, int32_t& delay)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_varint) delay = static_cast<int32_t>(pb.varint());
+    else if (field == 2 && wire == pb_varint) time = static_cast<int64_t>(pb.varint());
+    else pb.skip(wire);
+  }
+  return !pb.error;
+}
+
+//StopTimeUpdate: 1 stop_sequence, 2 arrival, 3 departure, 4 stop_id
+bool decode_stop_time_update(std::string_view data, rt_stop_time_t& stop_time)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  bool ok = true;
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_varint) stop_time.stop_sequence = static_cast<uint32_t>(pb.varint());
+    else if (field == 2 && wire == pb_bytes) ok = decode_stop_time_event(pb.bytes(), stop_time.arrival, stop_time.delay) && ok;
+    else if (field == 3 && wire == pb_bytes) ok = decode_stop_time_event(pb.bytes(), stop_time.departure, stop_time.delay) && ok;
+    else if (field == 4 && wire == pb_bytes) stop_time.stop_id = pb.bytes();
+    else pb.skip(wire);
+  }
+  return ok && !pb.error;
+}
+
+//TripUpdate: 1 trip, 2 stop_time_update (repeated), 3 vehicle, 4 timestamp
+bool decode_trip_update(std::string_view data, rt_feed_t& feed, rt_trip_update_t& update)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  bool ok = true;
+  std::string_view label;
+  update.first_stop_time = static_cast<uint32_t>(feed.stop_times.size());
+  while (pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_bytes) ok = decode_trip(pb.bytes(), update.trip_id, update.route_id) && ok;
+    else if (field == 2 && wire == pb_bytes)
+    {
+      rt_stop_time_t stop_time;
+      ok = decode_stop_time_update(pb.bytes(), stop_time) && ok;
+      feed.stop_times.push_back(stop_time);
+    }
+    else if (field == 3 && wire == pb_bytes) ok = decode_vehicle_descriptor(pb.bytes(), update.vehicle_id, label) && ok;
+    else if (field == 4 && wire == pb_varint) update.timestamp = pb.varint();
+    else pb.skip(wire);
+  }
+  update.nbr_stop_times = static_cast<uint32_t>(feed.stop_times.size()) - update.first_stop_time;
+  return ok && !pb.error;
+}
+
+//FeedEntity: 2 is_deleted, 3 trip_update, 4 vehicle
+bool decode_entity(std::string_view data, rt_feed_t& feed)
+{
+  pb_reader_t pb(data);
+  uint32_t field, wire;
+  bool ok = true;
+  bool deleted = false;
+  size_t nbr_vehicles = feed.vehicles.size();
+  size_t nbr_updates = feed.trip_updates.size();
+  size_t nbr_stop_times = feed.stop_times.size();
+  while (pb.next(field, wire))
+  {
+    if (field == 2 && wire == pb_varint) deleted = pb.varint() != 0;
+    else if (field == 3 && wire == pb_bytes)
+    {
+      rt_trip_update_t update;
+      ok = decode_trip_update(pb.bytes(), feed, update) && ok;
+      feed.trip_updates.push_back(update);
+    }
+    else if (field == 4 && wire == pb_bytes)
+    {
+      rt_vehicle_t vehicle;
+      ok = decode_vehicle_position(pb.bytes(), vehicle) && ok;
+      feed.vehicles.push_back(vehicle);
+    }
+    else pb.skip(wire);
+  }
+  if (deleted || !ok || pb.error)
+  {
+    feed.vehicles.resize(nbr_vehicles);
+    feed.trip_updates.resize(nbr_updates);
+    feed.stop_times.resize(nbr_stop_times);
+  }
+  return ok && !pb.error;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_rt_decode
+// FeedMessage: 1 header (FeedHeader: 3 timestamp), 2 entity (repeated)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_rt_decode(std::string_view payload, rt_feed_t& feed)
+{
+  pb_reader_t pb(payload);
+  uint32_t field, wire;
+  bool ok = true;
+  while (ok && pb.next(field, wire))
+  {
+    if (field == 1 && wire == pb_bytes)
+    {
+      pb_reader_t header(pb.bytes());
+      uint32_t header_field, header_wire;
+      while (header.next(header_field, header_wire))
+      {
+        if (header_field == 3 && header_wire == pb_varint) feed.timestamp = header.varint();
+        else header.skip(header_wire);
+      }
+      ok = !header.error;
+    }
+    else if (field == 2 && wire == pb_bytes)
+    {
+      ok = decode_entity(pb.bytes(), feed);
+    }
+    else
+    {
+      pb.skip(wire);
+    }
+  }
+  return ok && !pb.error ? 0 : -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_feed_t::clear
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void rt_feed_t::clear()
+{
+  timestamp = 0;
+  vehicles.clear();
+  trip_updates.clear();
+  stop_times.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_feed_t::find_trip_update
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const rt_trip_update_t* rt_feed_t::find_trip_update(std::string_view trip_id) const
+{
+  for (size_t idx = 0; idx < trip_updates.size(); ++idx)
+  {
+    if (trip_updates[idx].trip_id == trip_id)
+    {
+      return &trip_updates[idx];
+    }
+  }
+  return nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_feed_t::arrival
+// predicted arrival of the trip at stop_id (departure if only that is given), 0 if unknown
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t rt_feed_t::arrival(const rt_trip_update_t& update, std::string_view stop_id) const
+{
+  for (uint32_t idx = update.first_stop_time; idx < update.first_stop_time + update.nbr_stop_times; ++idx)
+  {
+    const rt_stop_time_t& stop_time = stop_times[idx];
+    if (stop_time.stop_id == stop_id)
+    {
+      return stop_time.arrival ? stop_time.arrival : stop_time.departure;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef GTFS_RT_HH
+#define GTFS_RT_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// GTFS-realtime
+// decoder for the FeedMessage protobuf of the WMATA rail feeds
+//   /gtfs/rail-gtfsrt-vehiclepositions.pb  VehiclePosition entities
+//   /gtfs/rail-gtfsrt-tripupdates.pb       TripUpdate entities
+// the wire format is read directly, one pass, with no generated code and no message objects: only
+// the fields the map uses are kept, strings are string_views into the payload, and unknown fields
+// (alerts, extensions, newer fields) are skipped by wire type
+// the payload must outlive the decoded rt_feed_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* const gtfs_rt_vehicles_path = "/gtfs/rail-gtfsrt-vehiclepositions.pb";
+const char* const gtfs_rt_trip_updates_path = "/gtfs/rail-gtfsrt-tripupdates.pb";
+
+enum rt_stop_status_t
+{
+  rt_incoming_at = 0,
+  rt_stopped_at = 1,
+  rt_in_transit_to = 2
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_vehicle_t
+// one VehiclePosition; has_position is false when the feed gives no coordinates
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct rt_vehicle_t
+{
+  std::string_view trip_id;
+  std::string_view route_id;
+  std::string_view vehicle_id;
+  std::string_view label;
+  std::string_view stop_id;
+  uint32_t stop_sequence = 0;
+  rt_stop_status_t status = rt_in_transit_to;
+  bool has_position = false;
+  float lat = 0;
+  float lon = 0;
+  float bearing = 0;
+  uint64_t timestamp = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_stop_time_t
+// one StopTimeUpdate; times are POSIX seconds, 0 when the feed gives only a delay
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct rt_stop_time_t
+{
+  std::string_view stop_id;
+  uint32_t stop_sequence = 0;
+  int64_t arrival = 0;
+  int64_t departure = 0;
+  int32_t delay = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_trip_update_t
+// stop times are [first_stop_time, first_stop_time + nbr_stop_times) of rt_feed_t::stop_times
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct rt_trip_update_t
+{
+  std::string_view trip_id;
+  std::string_view route_id;
+  std::string_view vehicle_id;
+  uint32_t first_stop_time = 0;
+  uint32_t nbr_stop_times = 0;
+  uint64_t timestamp = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// rt_feed_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct rt_feed_t
+{
+  uint64_t timestamp = 0; //FeedHeader timestamp
+  std::vector<rt_vehicle_t> vehicles;
+  std::vector<rt_trip_update_t> trip_updates;
+  std::vector<rt_stop_time_t> stop_times;
+  void clear();
+  const rt_trip_update_t* find_trip_update(std::string_view trip_id) const;
+  int64_t arrival(const rt_trip_update_t& update, std::string_view stop_id) const;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gtfs_rt_decode
+// appends the entities of one FeedMessage to feed, so a vehicle feed and a trip update feed can be
+// decoded into the same rt_feed_t; 0 on success, -1 on a malformed message (feed keeps what was
+// decoded before the error)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gtfs_rt_decode(std::string_view payload, rt_feed_t& feed);
+
+#endif
@@ -0,0 +1,344 @@
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cctype>
+#include <cstdlib>
+#include "http_cache.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::http_cache_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+http_cache_t::http_cache_t(const std::string& dir_) :
+  dir(dir_)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::path
+// key (host and path) to a file name: anything but letters and digits becomes '_'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string http_cache_t::path(const std::string& key, const char* ext) const
+{
+  std::string name(key);
+  for (size_t idx = 0; idx < name.size(); ++idx)
+  {
+    if (!std::isalnum(static_cast<unsigned char>(name[idx])))
+    {
+      name[idx] = '_';
+    }
+  }
+  return dir + "/" + name + ext;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::load
+// read the validators of key; -1 if key is not cached or its body is missing
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::load(const std::string& key, cache_entry_t& entry) const
+{
+  entry.etag.clear();
+  entry.last_modified.clear();
+  entry.fetched = 0;
+  entry.size = 0;
+
+  std::ifstream ifs(path(key, ".meta"));
+  if (!ifs.is_open())
+  {
+    return -1;
+  }
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    size_t colon = line.find(": ");
+    if (colon == std::string::npos)
+    {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    std::string value = line.substr(colon + 2);
+    if (name == "etag")
+    {
+      entry.etag = value;
+    }
+    else if (name == "last-modified")
+    {
+      entry.last_modified = value;
+    }
+    else if (name == "fetched")
+    {
+      entry.fetched = static_cast<std::time_t>(std::atoll(value.c_str()));
+    }
+    else if (name == "size")
+    {
+      entry.size = static_cast<size_t>(std::atoll(value.c_str()));
+    }
+  }
+
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(path(key, ".body"), ec);
+  if (ec || size != entry.size)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::fresh
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool http_cache_t::fresh(const cache_entry_t& entry, std::chrono::seconds max_age) const
+{
+  std::time_t now = std::time(nullptr);
+  return max_age.count() > 0 && entry.fetched <= now && now - entry.fetched < max_age.count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::conditional_headers
+// request header lines that let the server answer 304 Not Modified
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string http_cache_t::conditional_headers(const cache_entry_t& entry) const
+{
+  std::string headers;
+  if (!entry.etag.empty())
+  {
+    headers += "If-None-Match: " + entry.etag + "\r\n";
+  }
+  if (!entry.last_modified.empty())
+  {
+    headers += "If-Modified-Since: " + entry.last_modified + "\r\n";
+  }
+  return headers;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::read(const std::string& key, std::string& body) const
+{
+  body.clear();
+  std::ifstream ifs(path(key, ".body"), std::ios::binary);
+  if (!ifs.is_open())
+  {
+    return -1;
+  }
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  body = ss.str();
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::store
+// cache a 200 response; without validators the body is still used while fresh, then fetched again
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::store(const std::string& key, const std::string& body, const std::string& etag, const std::string& last_modified)
+{
+  std::string body_path = path(key, ".body");
+  std::string tmp = body_path + ".tmp";
+  std::ofstream ofs(tmp, std::ios::binary);
+  if (!ofs.is_open())
+  {
+    return -1;
+  }
+  ofs.write(body.data(), body.size());
+  ofs.close();
+  std::error_code ec;
+  if (!ofs)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+  std::filesystem::rename(tmp, body_path, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+
+  cache_entry_t entry;
+  entry.etag = etag;
+  entry.last_modified = last_modified;
+  entry.fetched = std::time(nullptr);
+  entry.size = body.size();
+  return write_meta(key, entry);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// copy_atomic
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int copy_atomic(const std::string& from, const std::string& to)
+{
+  std::string tmp = to + ".tmp";
+  std::error_code ec;
+  std::filesystem::copy_file(from, tmp, std::filesystem::copy_options::overwrite_existing, ec);
+  if (!ec)
+  {
+    std::filesystem::rename(tmp, to, ec);
+  }
+  if (ec)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::store_file
+// cache a body that was streamed to file_name, without reading it into memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::store_file(const std::string& key, const std::string& file_name, const std::string& etag, const std::string& last_modified)
+{
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(file_name, ec);
+  if (ec || copy_atomic(file_name, path(key, ".body")) != 0)
+  {
+    return -1;
+  }
+  cache_entry_t entry;
+  entry.etag = etag;
+  entry.last_modified = last_modified;
+  entry.fetched = std::time(nullptr);
+  entry.size = static_cast<size_t>(size);
+  return write_meta(key, entry);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::copy
+// cached body of key to file_name
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::copy(const std::string& key, const std::string& file_name) const
+{
+  return copy_atomic(path(key, ".body"), file_name);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::revalidated
+// the server answered 304: keep the body, restart its max age, take any new validators
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::revalidated(const std::string& key, const std::string& etag, const std::string& last_modified)
+{
+  cache_entry_t entry;
+  if (load(key, entry) != 0)
+  {
+    return -1;
+  }
+  if (!etag.empty())
+  {
+    entry.etag = etag;
+  }
+  if (!last_modified.empty())
+  {
+    entry.last_modified = last_modified;
+  }
+  entry.fetched = std::time(nullptr);
+  return write_meta(key, entry);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t::write_meta
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_cache_t::write_meta(const std::string& key, const cache_entry_t& entry)
+{
+  std::string meta_path = path(key, ".meta");
+  std::string tmp = meta_path + ".tmp";
+  std::ofstream ofs(tmp);
+  if (!ofs.is_open())
+  {
+    return -1;
+  }
+  ofs << "etag: " << entry.etag << "\n";
+  ofs << "last-modified: " << entry.last_modified << "\n";
+  ofs << "fetched: " << static_cast<long long>(entry.fetched) << "\n";
+  ofs << "size: " << entry.size << "\n";
+  ofs.close();
+  std::error_code ec;
+  if (!ofs)
+  {
+    std::filesystem::remove(tmp, ec);
+    return -1;
+  }
+  std::filesystem::rename(tmp, meta_path, ec);
+  return ec ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// cache_max_age
+// station lists change with service changes, the static GTFS with schedule releases
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::seconds cache_max_age(const std::string& path)
+{
+  if (path.find("/Rail.svc/json/jStations") == 0)
+  {
+    return std::chrono::hours(24);
+  }
+  if (path.find("/gtfs/") == 0 && path.find("-gtfsrt-") == std::string::npos)
+  {
+    return std::chrono::hours(6);
+  }
+  return std::chrono::seconds(-1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_status
+// "HTTP/1.1 304 Not Modified" to 304; 0 if there is no status line
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_status(const std::vector<std::string>& header)
+{
+  if (header.empty() || header[0].compare(0, 5, "HTTP/") != 0)
+  {
+    return 0;
+  }
+  size_t space = header[0].find(' ');
+  return space == std::string::npos ? 0 : std::atoi(header[0].c_str() + space + 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_header_value
+// value of the first header called name (case insensitive), trimmed; empty if absent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string http_header_value(const std::vector<std::string>& header, const std::string& name)
+{
+  for (size_t idx = 1; idx < header.size(); ++idx)
+  {
+    const std::string& line = header[idx];
+    if (line.size() <= name.size() || line[name.size()] != ':')
+    {
+      continue;
+    }
+    bool match = true;
+    for (size_t pos = 0; pos < name.size() && match; ++pos)
+    {
+      match = std::tolower(static_cast<unsigned char>(line[pos])) == std::tolower(static_cast<unsigned char>(name[pos]));
+    }
+    if (!match)
+    {
+      continue;
+    }
+    size_t first = line.find_first_not_of(" \t", name.size() + 1);
+    size_t last = line.find_last_not_of(" \t\r");
+    if (first == std::string::npos || last < first)
+    {
+      return "";
+    }
+    return line.substr(first, last - first + 1);
+  }
+  return "";
+}
@@ -0,0 +1,65 @@
+#ifndef HTTP_CACHE_HH
+#define HTTP_CACHE_HH
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// cache_entry_t
+// validators of a cached response, as sent by the server
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct cache_entry_t
+{
+  std::string etag;
+  std::string last_modified;
+  std::time_t fetched; //last time the server confirmed or sent the body
+  size_t size;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// http_cache_t
+// response bodies on disk, one <key>.body and one <key>.meta per cached URL
+// a stored entry younger than the endpoint's max age is used without contacting the server; an
+// older one is revalidated with If-None-Match / If-Modified-Since, and a 304 only refreshes fetched
+// bodies are replaced with a temporary file and a rename, so a reader never sees a partial body
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class http_cache_t
+{
+public:
+  explicit http_cache_t(const std::string& dir);
+  int load(const std::string& key, cache_entry_t& entry) const;
+  bool fresh(const cache_entry_t& entry, std::chrono::seconds max_age) const;
+  std::string conditional_headers(const cache_entry_t& entry) const;
+  int read(const std::string& key, std::string& body) const;
+  int store(const std::string& key, const std::string& body, const std::string& etag, const std::string& last_modified);
+  int store_file(const std::string& key, const std::string& file_name, const std::string& etag, const std::string& last_modified);
+  int copy(const std::string& key, const std::string& file_name) const;
+  int revalidated(const std::string& key, const std::string& etag, const std::string& last_modified);
+
+private:
+  std::string dir;
+  std::string path(const std::string& key, const char* ext) const;
+  int write_meta(const std::string& key, const cache_entry_t& entry);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// cache_max_age
+// staleness policy of the WMATA endpoints: how long a cached body is used without revalidation
+// negative for endpoints that are never cached (real time predictions and GTFS-realtime feeds)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::seconds cache_max_age(const std::string& path);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// HTTP response header helpers
+// header lines as read from the socket, status line first, with or without the trailing '\r'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int http_status(const std::vector<std::string>& header);
+std::string http_header_value(const std::vector<std::string>& header, const std::string& name);
+
+#endif
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include <chrono>
 #include "get.hh"
+#include "download.hh"
+#include "gtfs_rt.hh"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //main
@@ -25,20 +29,48 @@ int main()
   file.close();
 
   std::string api_key = extract_value(buf, "API_KEY");
+  set_api_endpoint(buf);
 
-  int result = get_rail_predictions(api_key, "All");
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // predictions, GTFS-realtime positions and trip updates, the six station lists and the GTFS feed,
+  // fetched concurrently
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  const std::string& host = api_host();
+  std::vector<download_t> downloads;
+  downloads.push_back(make_download("predictions_All", host, "/StationPrediction.svc/json/GetPrediction/All",
+    "application/json", api_key, "predictions_All.json"));
+
+  downloads.push_back(make_download("gtfsrt_vehicles", host, gtfs_rt_vehicles_path,
+    "application/x-protobuf", api_key, "gtfsrt_vehiclepositions.pb"));
+  downloads.push_back(make_download("gtfsrt_trip_updates", host, gtfs_rt_trip_updates_path,
+    "application/x-protobuf", api_key, "gtfsrt_tripupdates.pb"));
 
   const std::string lines[] = { "RD", "OR", "SV", "BL", "YL", "GR" };
-  const std::string colors[] = { "Red", "Orange", "Silver", "Blue", "Yellow", "Green" };
   for (size_t idx = 0; idx < 6; ++idx)
   {
-    result = get_station_list(api_key, lines[idx]);
-    if (result != 0)
-    {
-    }
+    downloads.push_back(make_download("stations_" + lines[idx], host, "/Rail.svc/json/jStations?LineCode=" + lines[idx],
+      "application/json", api_key, "stations_" + lines[idx] + ".json"));
   }
 
-  result = get_gtfs_rail(api_key);
-  return 0;
-}
+  downloads.push_back(make_download("gtfs", host, "/gtfs/rail-gtfs-static.zip",
+    "application/zip", api_key, "gtfs.zip"));
+  downloads.back().stream = true;
 
+  for (size_t idx = 0; idx < downloads.size(); ++idx)
+  {
+    downloads[idx].port = api_port();
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  //station lists and the GTFS zip are revalidated against ./cache, so most runs only fetch predictions
+  http_cache_t cache("cache");
+  download_options_t options;
+  options.cache = &cache;
+  options.timeout = std::chrono::minutes(5);
+  int failed = download_all(downloads, options);
+  double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  download_report(downloads, total_ms, std::cout);
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "line_geojson.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t::buffered_writer_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+buffered_writer_t::buffered_writer_t(std::FILE* file_) :
+  used(0),
+  nbr_bytes(0),
+  file(file_),
+  out(nullptr)
+{
+}
+
+buffered_writer_t::buffered_writer_t(std::string& out_) :
+  used(0),
+  nbr_bytes(0),
+  file(nullptr),
+  out(&out_)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t::~buffered_writer_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+buffered_writer_t::~buffered_writer_t()
+{
+  flush();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t::flush
+// returns -1 if the file write failed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int buffered_writer_t::flush()
+{
+  if (used == 0)
+  {
+    return 0;
+  }
+  int result = 0;
+  if (file)
+  {
+    if (std::fwrite(buffer, 1, used, file) != used)
+    {
+      result = -1;
+    }
+  }
+  else if (out)
+  {
+    out->append(buffer, used);
+  }
+  nbr_bytes += used;
+  used = 0;
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t::write
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void buffered_writer_t::write(std::string_view str)
+{
+  while (!str.empty())
+  {
+    if (used == buffer_size)
+    {
+      flush();
+    }
+    size_t len = std::min(str.size(), buffer_size - used);
+    std::memcpy(buffer + used, str.data(), len);
+    used += len;
+    str.remove_prefix(len);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t::write
+// same text as std::ostream << double with the default precision
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void buffered_writer_t::write(double value)
+{
+  char str[32];
+  int len = std::snprintf(str, sizeof(str), "%g", value);
+  write(std::string_view(str, static_cast<size_t>(len)));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// route_name
+// route_short_name, or route_id when the short name is empty
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string route_name(const gtfs_t& gtfs, uint32_t route)
+{
+  std::string name(gtfs.str(gtfs.routes.short_name[route]));
+  if (name.empty())
+  {
+    name = gtfs.str(gtfs.routes.route_id[route]);
+  }
+  return name;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// point_key_t
+// exact coordinates of a shape point; shapes of one line repeat the same values where they overlap
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct point_key_t
+{
+  double lat;
+  double lon;
+  bool operator==(const point_key_t& other) const { return lat == other.lat && lon == other.lon; }
+};
+
+struct point_key_hash_t
+{
+  size_t operator()(const point_key_t& key) const
+  {
+    return std::hash<double>()(key.lat) * 31 + std::hash<double>()(key.lon);
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// line_segments_t
+// runs of shape points not yet written: points [offsets[s], offsets[s + 1]) are indexes into
+// shape_table_t lat/lon, shape[s] the shape they come from
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct line_segments_t
+{
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> points;
+  std::vector<uint32_t> shape;
+  size_t size() const { return shape.size(); }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// merge_shapes
+// the longest shape first, then the others in shape_id order; every edge between two consecutive
+// points is kept once, regardless of direction, and consecutive new edges become one segment
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void merge_shapes(const gtfs_t& gtfs, uint32_t route, line_segments_t& segments)
+{
+  range_t shapes_list = gtfs.route_shapes(route);
+  std::vector<uint32_t> route_shapes;
+  for (uint32_t idx = shapes_list.begin; idx < shapes_list.end; ++idx)
+  {
+    if (gtfs.shape_points(gtfs.route_shape_list[idx]).size() > 1)
+    {
+      route_shapes.push_back(gtfs.route_shape_list[idx]);
+    }
+  }
+  std::sort(route_shapes.begin(), route_shapes.end(), [&gtfs](uint32_t a, uint32_t b)
+    {
+      return gtfs.str(gtfs.shapes.shape_id[a]) < gtfs.str(gtfs.shapes.shape_id[b]);
+    });
+  std::vector<uint32_t>::iterator longest = std::max_element(route_shapes.begin(), route_shapes.end(), [&gtfs](uint32_t a, uint32_t b)
+    {
+      return gtfs.shape_points(a).size() < gtfs.shape_points(b).size();
+    });
+  if (longest != route_shapes.end())
+  {
+    std::rotate(route_shapes.begin(), longest, longest + 1);
+  }
+
+  std::unordered_map<point_key_t, uint32_t, point_key_hash_t> point_ids;
+  std::unordered_set<uint64_t> edges;
+  segments.offsets.assign(1, 0);
+  segments.points.clear();
+  segments.shape.clear();
+
+  for (size_t s = 0; s < route_shapes.size(); ++s)
+  {
+    range_t points = gtfs.shape_points(route_shapes[s]);
+    uint32_t prev_id = gtfs_none;
+    bool open = false;
+    for (uint32_t idx = points.begin; idx < points.end; ++idx)
+    {
+      point_key_t key = { gtfs.shapes.lat[idx], gtfs.shapes.lon[idx] };
+      uint32_t id = point_ids.emplace(key, static_cast<uint32_t>(point_ids.size())).first->second;
+      if (idx == points.begin || id == prev_id)
+      {
+        prev_id = id;
+        continue;
+      }
+
+      uint64_t edge = prev_id < id ? (static_cast<uint64_t>(prev_id) << 32) | id : (static_cast<uint64_t>(id) << 32) | prev_id;
+      if (edges.insert(edge).second)
+      {
+        if (!open)
+        {
+          segments.points.push_back(idx - 1);
+          open = true;
+        }
+        segments.points.push_back(idx);
+      }
+      else if (open)
+      {
+        segments.offsets.push_back(static_cast<uint32_t>(segments.points.size()));
+        segments.shape.push_back(route_shapes[s]);
+        open = false;
+      }
+      prev_id = id;
+    }
+    if (open)
+    {
+      segments.offsets.push_back(static_cast<uint32_t>(segments.points.size()));
+      segments.shape.push_back(route_shapes[s]);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_route_geojson
+// returns the number of features written; nothing is written if the route has no geometry
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t write_route_geojson(const gtfs_t& gtfs, uint32_t route, buffered_writer_t& writer)
+{
+  line_segments_t segments;
+  merge_shapes(gtfs, route, segments);
+  if (segments.size() == 0)
+  {
+    return 0;
+  }
+
+  std::string route_id(gtfs.str(gtfs.routes.route_id[route]));
+  std::string name = route_name(gtfs, route);
+  std::string color = "#E51636";
+  if (gtfs.routes.color[route] != gtfs_none)
+  {
+    color = "#" + std::string(gtfs.str(gtfs.routes.color[route]));
+  }
+
+  writer.write("{\n");
+  writer.write("  \"type\": \"FeatureCollection\",\n");
+  writer.write("  \"features\": [\n");
+
+  for (size_t s = 0; s < segments.size(); ++s)
+  {
+    if (s > 0)
+      writer.write(",\n");
+
+    writer.write("    {\n");
+    writer.write("      \"type\": \"Feature\",\n");
+    writer.write("      \"properties\": {\n");
+    writer.write("        \"shape_id\": \"");
+    writer.write(gtfs.str(gtfs.shapes.shape_id[segments.shape[s]]));
+    writer.write("\",\n");
+    writer.write("        \"route_id\": \"");
+    writer.write(route_id);
+    writer.write("\",\n");
+    writer.write("        \"route_name\": \"");
+    writer.write(name);
+    writer.write("\",\n");
+    writer.write("        \"color\": \"");
+    writer.write(color);
+    writer.write("\"\n");
+    writer.write("      },\n");
+    writer.write("      \"geometry\": {\n");
+    writer.write("        \"type\": \"LineString\",\n");
+    writer.write("        \"coordinates\": [\n");
+
+    for (uint32_t idx = segments.offsets[s]; idx < segments.offsets[s + 1]; ++idx)
+    {
+      uint32_t point = segments.points[idx];
+      writer.write("          [");
+      writer.write(gtfs.shapes.lon[point]);
+      writer.write(", ");
+      writer.write(gtfs.shapes.lat[point]);
+      writer.write(idx < segments.offsets[s + 1] - 1 ? "],\n" : "]\n");
+    }
+
+    writer.write("        ]\n");
+    writer.write("      }\n");
+    writer.write("    }");
+  }
+
+  writer.write("\n  ]\n");
+  writer.write("}\n");
+  return segments.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// route_geojson
+// write_route_geojson into a string; empty if the route has no geometry
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string route_geojson(const gtfs_t& gtfs, uint32_t route)
+{
+  std::string geojson;
+  {
+    buffered_writer_t writer(geojson);
+    write_route_geojson(gtfs, route, writer);
+  }
+  return geojson;
+}
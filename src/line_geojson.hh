@@ -0,0 +1,52 @@
+#ifndef LINE_GEOJSON_HH
+#define LINE_GEOJSON_HH
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <stdint.h>
+#include "gtfs.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffered_writer_t
+// appends text to a fixed 64 KB buffer and hands it to a FILE or a string when full, so a large
+// document is written with bounded memory and few system calls
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class buffered_writer_t
+{
+public:
+  explicit buffered_writer_t(std::FILE* file);
+  explicit buffered_writer_t(std::string& out);
+  ~buffered_writer_t();
+  void write(std::string_view str);
+  void write(double value);
+  int flush();
+  size_t size() const { return nbr_bytes + used; }
+
+private:
+  buffered_writer_t(const buffered_writer_t&) = delete;
+  buffered_writer_t& operator=(const buffered_writer_t&) = delete;
+  static const size_t buffer_size = 64 * 1024;
+  char buffer[buffer_size];
+  size_t used;
+  size_t nbr_bytes;
+  std::FILE* file;
+  std::string* out;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// line geometry
+// route_geojson writes a route as a FeatureCollection of LineStrings
+// identical shapes (same points, in either direction) are written once; a shape that overlaps
+// shapes already written only adds the runs of points that are new, each as its own feature
+// starting at the point where it leaves the shared geometry
+// the first feature is always the longest shape in full, so readers that take a single path
+// (parse_line_geometry) get an end to end line
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string route_name(const gtfs_t& gtfs, uint32_t route);
+size_t write_route_geojson(const gtfs_t& gtfs, uint32_t route, buffered_writer_t& writer);
+std::string route_geojson(const gtfs_t& gtfs, uint32_t route);
+
+#endif
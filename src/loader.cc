@@ -0,0 +1,301 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include "loader.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t::thread_pool_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+thread_pool_t::thread_pool_t(size_t nbr_threads) :
+  stop(false)
+{
+  if (nbr_threads == 0)
+  {
+    nbr_threads = std::thread::hardware_concurrency();
+  }
+  if (nbr_threads == 0)
+  {
+    nbr_threads = 2;
+  }
+
+  for (size_t idx = 0; idx < nbr_threads; ++idx)
+  {
+    threads.emplace_back(&thread_pool_t::work, this);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t::~thread_pool_t
+// pending tasks are drained before the workers exit
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+thread_pool_t::~thread_pool_t()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+
+  for (size_t idx = 0; idx < threads.size(); ++idx)
+  {
+    threads[idx].join();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t::submit
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void thread_pool_t::submit(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  cv.notify_one();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t::size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t thread_pool_t::size() const
+{
+  return threads.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t::work
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void thread_pool_t::work()
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+      if (tasks.empty())
+      {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_pool
+// workers shared by every parallel_for, started on first use
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+thread_pool_t& parallel_pool()
+{
+  static thread_pool_t pool;
+  return pool;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_for
+// the calling thread works too and waits for every index to finish, so a helper the pool has not
+// started yet is not needed; such a helper runs later, finds the counter exhausted and only reads
+// the shared state, which it keeps alive; fn is called only for indices below nbr_tasks
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct parallel_state_t
+{
+  parallel_state_t(size_t nbr_tasks_, const std::function<void(size_t)>& fn_) :
+    nbr_tasks(nbr_tasks_),
+    fn(fn_),
+    next(0),
+    failed(false),
+    finished(0)
+  {
+  }
+  const size_t nbr_tasks;
+  const std::function<void(size_t)>& fn;
+  std::atomic<size_t> next;
+  std::atomic<bool> failed;
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t finished;
+  std::exception_ptr error;
+
+  void work()
+  {
+    size_t idx;
+    while ((idx = next.fetch_add(1)) < nbr_tasks)
+    {
+      std::exception_ptr thrown;
+      if (!failed)
+      {
+        try
+        {
+          fn(idx);
+        }
+        catch (...)
+        {
+          thrown = std::current_exception();
+          failed = true;
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (thrown && !error)
+      {
+        error = thrown;
+      }
+      if (++finished == nbr_tasks)
+      {
+        cv.notify_all();
+      }
+    }
+  }
+};
+
+void parallel_for(size_t nbr_tasks, const std::function<void(size_t)>& fn, size_t nbr_threads)
+{
+  if (nbr_threads == 0)
+  {
+    nbr_threads = std::thread::hardware_concurrency();
+  }
+  if (nbr_threads > nbr_tasks)
+  {
+    nbr_threads = nbr_tasks;
+  }
+
+  if (nbr_threads <= 1)
+  {
+    for (size_t idx = 0; idx < nbr_tasks; ++idx)
+    {
+      fn(idx);
+    }
+    return;
+  }
+
+  std::shared_ptr<parallel_state_t> state = std::make_shared<parallel_state_t>(nbr_tasks, fn);
+  thread_pool_t& pool = parallel_pool();
+  for (size_t idx = 1; idx < nbr_threads; ++idx)
+  {
+    pool.submit([state]()
+      {
+        state->work();
+      });
+  }
+  state->work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state]() { return state->finished == state->nbr_tasks; });
+  if (state->error)
+  {
+    std::rethrow_exception(state->error);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loader_t::loader_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+loader_t::loader_t(thread_pool_t& pool_) :
+  pool(pool_)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loader_t::add
+// queue a named task; the returned future becomes ready when the task has run
+// exceptions thrown by the task are stored in the future
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_future<void> loader_t::add(const std::string& name, std::function<void()> task)
+{
+  std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+  std::shared_future<void> ready = promise->get_future().share();
+
+  item_t* item = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    items.push_back({ name, ready, 0.0, false });
+    item = &items.back();
+  }
+
+  pool.submit([this, item, task, promise]()
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          item->failed = true;
+        }
+        promise->set_exception(std::current_exception());
+        return;
+      }
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        item->ms = elapsed.count();
+      }
+      promise->set_value();
+    });
+
+  return ready;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loader_t::wait
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void loader_t::wait()
+{
+  std::vector<std::shared_future<void>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t idx = 0; idx < items.size(); ++idx)
+    {
+      pending.push_back(items[idx].ready);
+    }
+  }
+
+  for (size_t idx = 0; idx < pending.size(); ++idx)
+  {
+    pending[idx].wait();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loader_t::report
+// per task timing; tasks still running are listed as pending
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void loader_t::report(std::ostream& os)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t idx = 0; idx < items.size(); ++idx)
+  {
+    const item_t& item = items[idx];
+    os << std::setw(36) << std::left << item.name << " ";
+    if (item.ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      os << "pending" << std::endl;
+      continue;
+    }
+    if (item.failed)
+    {
+      os << "failed" << std::endl;
+      continue;
+    }
+    os << std::fixed << std::setprecision(2) << item.ms << " ms" << std::endl;
+  }
+}
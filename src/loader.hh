@@ -0,0 +1,76 @@
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <ostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_t
+// fixed set of worker threads consuming a FIFO of tasks
+// nbr_threads 0 uses std::thread::hardware_concurrency()
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class thread_pool_t
+{
+public:
+  explicit thread_pool_t(size_t nbr_threads = 0);
+  ~thread_pool_t();
+  void submit(std::function<void()> task);
+  size_t size() const;
+
+private:
+  void work();
+  std::vector<std::thread> threads;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stop;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_for
+// calls fn(idx) for idx in [0, nbr_tasks) on the calling thread and up to nbr_threads - 1 workers of
+// a pool shared by all calls, and returns when all are done; calls may nest
+// tasks are handed out in index order from a shared counter
+// the first exception thrown by fn is rethrown here once the running calls return; the indices
+// not started by then are skipped
+// nbr_threads 0 uses std::thread::hardware_concurrency(); 1 runs inline on the calling thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void parallel_for(size_t nbr_tasks, const std::function<void(size_t)>& fn, size_t nbr_threads = 0);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loader_t
+// runs named load tasks on a thread pool
+// each task gets a readiness future; elapsed time is recorded per task
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class loader_t
+{
+public:
+  explicit loader_t(thread_pool_t& pool);
+  std::shared_future<void> add(const std::string& name, std::function<void()> task);
+  void wait();
+  void report(std::ostream& os);
+
+private:
+  struct item_t
+  {
+    std::string name;
+    std::shared_future<void> ready;
+    double ms;
+    bool failed;
+  };
+  thread_pool_t& pool;
+  std::deque<item_t> items;
+  std::mutex mutex;
+};
+
+#endif
@@ -31,17 +31,25 @@ std::string rgb_to_hex(int r, int g, int b)
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // load_file
+// size the string from the file length and read straight into it
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 std::string load_file(const std::string& filename)
 {
-  std::ifstream file(filename);
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
   if (!file.is_open())
     return "";
 
-  std::stringstream buf;
-  buf << file.rdbuf();
-  return buf.str();
+  std::streamoff size = file.tellg();
+  if (size <= 0)
+    return "";
+
+  std::string buf;
+  buf.resize(static_cast<size_t>(size));
+  file.seekg(0, std::ios::beg);
+  file.read(&buf[0], size);
+  buf.resize(static_cast<size_t>(file.gcount()));
+  return buf;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
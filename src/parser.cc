@@ -1,6 +1,278 @@
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <new>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 #include "geojson.hh"
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// counting allocator hook
+// replaces the global operator new/delete for this executable so --bench can report
+// the number of heap allocations per parse
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::atomic<size_t> nbr_allocations(0);
+std::atomic<size_t> nbr_allocated_bytes(0);
+
+void* operator new(std::size_t size)
+{
+  nbr_allocations.fetch_add(1, std::memory_order_relaxed);
+  nbr_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  nbr_allocations.fetch_add(1, std::memory_order_relaxed);
+  nbr_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// peak_rss_kb
+// peak resident set size of this process, in KB
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t peak_rss_kb()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+  {
+    return static_cast<size_t>(pmc.PeakWorkingSetSize / 1024);
+  }
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+#ifdef __APPLE__
+  return static_cast<size_t>(usage.ru_maxrss / 1024);
+#else
+  return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// loaders
+// each entry parses a GeoJSON buffer already in memory and returns 0 on success
+// add faster loaders to this table to compare them against the Wt::Json DOM path
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int load_dom(const std::string& json)
+{
+  try
+  {
+    Wt::Json::Object root;
+    Wt::Json::parse(json, root);
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << e.what() << std::endl;
+    return -1;
+  }
+}
+
+int load_geojson(const std::string& json)
+{
+  geojson_t parser;
+  return parser.parse(json);
+}
+
+struct loader_entry_t
+{
+  const char* name;
+  const char* description;
+  int (*parse)(const std::string& json);
+};
+
+const loader_entry_t loaders[] =
+{
+  { "dom", "Wt::Json DOM only", load_dom },
+  { "geojson", "Wt::Json DOM + geojson_t", load_geojson },
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// count_coordinates
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t count_coordinates(const geojson_t& parser)
+{
+  size_t nbr_coord = 0;
+  for (size_t idx = 0; idx < parser.features.size(); ++idx)
+  {
+    const feature_t& feature = parser.features[idx];
+    for (size_t jdx = 0; jdx < feature.geometry.size(); ++jdx)
+    {
+      const geometry_t& geometry = feature.geometry[jdx];
+      for (size_t kdx = 0; kdx < geometry.polygons.size(); ++kdx)
+      {
+        nbr_coord += geometry.polygons[kdx].coord.size();
+      }
+    }
+  }
+  return nbr_coord;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench
+// parse the file nbr_iterations times with each selected loader and report throughput
+// the file is read once; timings cover parsing from memory only
+// features and coordinates counts come from one reference geojson_t parse
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int bench(const char* file_name, int nbr_iterations, const std::string& loader_name)
+{
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file.is_open())
+  {
+    std::cout << "cannot open " << file_name << std::endl;
+    return 1;
+  }
+  std::stringstream buf;
+  buf << file.rdbuf();
+  std::string json = buf.str();
+  file.close();
+
+  geojson_t reference;
+  if (reference.parse(json) != 0)
+  {
+    return 1;
+  }
+  size_t nbr_features = reference.features.size();
+  size_t nbr_coord = count_coordinates(reference);
+  double mb = json.size() / (1024.0 * 1024.0);
+
+  std::cout << file_name << ": " << std::fixed << std::setprecision(2) << mb << " MB, "
+    << nbr_features << " features, " << nbr_coord << " coordinates, "
+    << nbr_iterations << " iterations" << std::endl << std::endl;
+
+  std::cout << std::left << std::setw(10) << "loader"
+    << std::right << std::setw(12) << "ms/parse"
+    << std::setw(10) << "MB/s"
+    << std::setw(14) << "features/s"
+    << std::setw(14) << "coords/s"
+    << std::setw(14) << "allocs/parse"
+    << std::setw(14) << "KB/parse" << std::endl;
+
+  bool found = false;
+  for (size_t idx = 0; idx < sizeof(loaders) / sizeof(loaders[0]); ++idx)
+  {
+    const loader_entry_t& loader = loaders[idx];
+    if (loader_name != "all" && loader_name != loader.name)
+    {
+      continue;
+    }
+    found = true;
+
+    //warm up, not timed
+    if (loader.parse(json) != 0)
+    {
+      return 1;
+    }
+
+    size_t allocations = nbr_allocations.load();
+    size_t allocated_bytes = nbr_allocated_bytes.load();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < nbr_iterations; ++iter)
+    {
+      loader.parse(json);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    allocations = nbr_allocations.load() - allocations;
+    allocated_bytes = nbr_allocated_bytes.load() - allocated_bytes;
+
+    double sec = elapsed.count();
+    if (sec <= 0.0)
+    {
+      sec = 1e-9;
+    }
+
+    std::cout << std::left << std::setw(10) << loader.name << std::right
+      << std::setw(12) << std::setprecision(3) << (sec * 1000.0 / nbr_iterations)
+      << std::setw(10) << std::setprecision(1) << (mb * nbr_iterations / sec)
+      << std::setw(14) << std::setprecision(0) << (nbr_features * nbr_iterations / sec)
+      << std::setw(14) << (nbr_coord * nbr_iterations / sec)
+      << std::setw(14) << (allocations / nbr_iterations)
+      << std::setw(14) << (allocated_bytes / 1024 / nbr_iterations)
+      << "  (" << loader.description << ")" << std::endl;
+  }
+
+  if (!found)
+  {
+    std::cout << "unknown loader: " << loader_name << std::endl;
+    return 1;
+  }
+
+  std::cout << std::endl << "peak RSS: " << peak_rss_kb() << " KB" << std::endl;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* name)
+{
+  std::cout << "Usage: " << name << " <geojson_file>" << std::endl;
+  std::cout << "       " << name << " --bench [-n iterations] [--loader name|all] <geojson_file>" << std::endl;
+  std::cout << "loaders:" << std::endl;
+  for (size_t idx = 0; idx < sizeof(loaders) / sizeof(loaders[0]); ++idx)
+  {
+    std::cout << "  " << loaders[idx].name << " - " << loaders[idx].description << std::endl;
+  }
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9,10 +281,38 @@ int main(int argc, char* argv[])
 {
   if (argc < 2)
   {
-    std::cout << "Usage: " << argv[0] << " <geojson_file>" << std::endl;
+    usage(argv[0]);
     return 1;
   }
 
+  if (std::strcmp(argv[1], "--bench") == 0)
+  {
+    int nbr_iterations = 10;
+    std::string loader_name = "all";
+    const char* bench_file = nullptr;
+    for (int idx = 2; idx < argc; ++idx)
+    {
+      if (std::strcmp(argv[idx], "-n") == 0 && idx + 1 < argc)
+      {
+        nbr_iterations = std::atoi(argv[++idx]);
+      }
+      else if (std::strcmp(argv[idx], "--loader") == 0 && idx + 1 < argc)
+      {
+        loader_name = argv[++idx];
+      }
+      else
+      {
+        bench_file = argv[idx];
+      }
+    }
+    if (!bench_file || nbr_iterations <= 0)
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    return bench(bench_file, nbr_iterations, loader_name);
+  }
+
   const char* file_name = argv[1];
   geojson_t parser;
   int result = parser.convert(file_name);
@@ -0,0 +1,374 @@
+#include <queue>
+#include <functional>
+#include <cmath>
+#include "loader.hh"
+#include "pathways.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// walking speed for pathways without traversal_time, meters per second
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const double walk_speed = 1.3;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// profile_avoid
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t profile_avoid(pathway_profile_t profile)
+{
+  switch (profile)
+  {
+  case profile_no_escalator:
+    return avoid_escalator;
+  case profile_no_elevator:
+    return avoid_elevator;
+  case profile_step_free:
+    return avoid_stairs | avoid_escalator;
+  default:
+    return avoid_none;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::pathways_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+pathways_t::pathways_t() :
+  gtfs(nullptr)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// edge_weight
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t edge_weight(const pathway_table_t& pathways, size_t idx)
+{
+  if (pathways.traversal_time[idx] >= 0)
+  {
+    return pathways.traversal_time[idx];
+  }
+  if (pathways.length[idx] >= 0.0f)
+  {
+    return static_cast<int32_t>(std::ceil(pathways.length[idx] / walk_speed));
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::build
+// returns -1 if the feed has no pathways
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pathways_t::build(const gtfs_t& feed)
+{
+  gtfs = &feed;
+  const pathway_table_t& pathways = gtfs->pathways;
+  const stop_table_t& stops = gtfs->stops;
+  const size_t nbr_stops = stops.size();
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // adjacency; a bidirectional pathway is two edges
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  offsets.assign(nbr_stops + 1, 0);
+  for (size_t idx = 0; idx < pathways.size(); ++idx)
+  {
+    ++offsets[pathways.from[idx] + 1];
+    if (pathways.bidirectional[idx])
+    {
+      ++offsets[pathways.to[idx] + 1];
+    }
+  }
+  for (size_t idx = 1; idx < offsets.size(); ++idx)
+  {
+    offsets[idx] += offsets[idx - 1];
+  }
+
+  target.resize(offsets.back());
+  weight.resize(offsets.back());
+  mode.resize(offsets.back());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t idx = 0; idx < pathways.size(); ++idx)
+  {
+    int32_t time = edge_weight(pathways, idx);
+    uint32_t pos = fill[pathways.from[idx]]++;
+    target[pos] = pathways.to[idx];
+    weight[pos] = time;
+    mode[pos] = pathways.mode[idx];
+    if (pathways.bidirectional[idx])
+    {
+      pos = fill[pathways.to[idx]]++;
+      target[pos] = pathways.from[idx];
+      weight[pos] = time;
+      mode[pos] = pathways.mode[idx];
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // entrances and platforms grouped by station
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  entrance_offsets.assign(nbr_stops + 1, 0);
+  platform_offsets.assign(nbr_stops + 1, 0);
+  for (size_t stop = 0; stop < nbr_stops; ++stop)
+  {
+    if (stops.location_type[stop] == 2)
+    {
+      ++entrance_offsets[stops.station[stop] + 1];
+    }
+    else if (stops.location_type[stop] == 0 && stops.parent[stop] != gtfs_none)
+    {
+      ++platform_offsets[stops.station[stop] + 1];
+    }
+  }
+  for (size_t idx = 1; idx <= nbr_stops; ++idx)
+  {
+    entrance_offsets[idx] += entrance_offsets[idx - 1];
+    platform_offsets[idx] += platform_offsets[idx - 1];
+  }
+
+  entrance_list.resize(entrance_offsets.back());
+  platform_list.resize(platform_offsets.back());
+  local.assign(nbr_stops, gtfs_none);
+  std::vector<uint32_t> entrance_fill(entrance_offsets.begin(), entrance_offsets.end() - 1);
+  std::vector<uint32_t> platform_fill(platform_offsets.begin(), platform_offsets.end() - 1);
+  for (uint32_t stop = 0; stop < nbr_stops; ++stop)
+  {
+    uint32_t station = stops.station[stop];
+    if (stops.location_type[stop] == 2)
+    {
+      local[stop] = entrance_fill[station] - entrance_offsets[station];
+      entrance_list[entrance_fill[station]++] = stop;
+    }
+    else if (stops.location_type[stop] == 0 && stops.parent[stop] != gtfs_none)
+    {
+      local[stop] = platform_fill[station] - platform_offsets[station];
+      platform_list[platform_fill[station]++] = stop;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // entrance x platform matrices, one Dijkstra per entrance and profile
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  matrix_offsets.assign(nbr_stops + 1, 0);
+  std::vector<uint32_t> stations;
+  for (uint32_t station = 0; station < nbr_stops; ++station)
+  {
+    range_t entrances = station_entrances(station);
+    range_t platforms = station_platforms(station);
+    matrix_offsets[station + 1] = matrix_offsets[station] + entrances.size() * platforms.size();
+    if (!entrances.empty() && !platforms.empty())
+    {
+      stations.push_back(station);
+    }
+  }
+
+  for (int profile = 0; profile < nbr_profiles; ++profile)
+  {
+    matrix[profile].assign(matrix_offsets.back(), -1);
+  }
+
+  parallel_for(stations.size(), [&](size_t idx)
+    {
+      uint32_t station = stations[idx];
+      range_t entrances = station_entrances(station);
+      range_t platforms = station_platforms(station);
+      std::vector<int32_t> times(nbr_stops, -1);
+      std::vector<uint32_t> touched;
+
+      for (int profile = 0; profile < nbr_profiles; ++profile)
+      {
+        uint32_t avoid = profile_avoid(static_cast<pathway_profile_t>(profile));
+        for (uint32_t row = 0; row < entrances.size(); ++row)
+        {
+          dijkstra(entrance_list[entrances.begin + row], avoid, times, touched);
+          int32_t* dst = &matrix[profile][matrix_offsets[station] + row * platforms.size()];
+          for (uint32_t col = 0; col < platforms.size(); ++col)
+          {
+            dst[col] = times[platform_list[platforms.begin + col]];
+          }
+        }
+      }
+    });
+
+  return pathways.size() ? 0 : -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::dijkstra
+// times must be all -1 on entry except at the nodes listed in touched, which are reset first
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pathways_t::dijkstra(uint32_t from, uint32_t avoid, std::vector<int32_t>& times, std::vector<uint32_t>& touched) const
+{
+  for (size_t idx = 0; idx < touched.size(); ++idx)
+  {
+    times[touched[idx]] = -1;
+  }
+  touched.clear();
+
+  typedef std::pair<int32_t, uint32_t> item_t;
+  std::priority_queue<item_t, std::vector<item_t>, std::greater<item_t>> queue;
+  times[from] = 0;
+  touched.push_back(from);
+  queue.push(item_t(0, from));
+
+  while (!queue.empty())
+  {
+    item_t item = queue.top();
+    queue.pop();
+    uint32_t node = item.second;
+    if (item.first > times[node])
+    {
+      continue;
+    }
+
+    for (uint32_t edge = offsets[node]; edge < offsets[node + 1]; ++edge)
+    {
+      if (avoid & (1u << mode[edge]))
+      {
+        continue;
+      }
+      uint32_t next = target[edge];
+      int32_t time = item.first + weight[edge];
+      if (times[next] < 0)
+      {
+        touched.push_back(next);
+      }
+      else if (time >= times[next])
+      {
+        continue;
+      }
+      times[next] = time;
+      queue.push(item_t(time, next));
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::walk_times
+// seconds from stop from to every stop, -1 for unreachable stops
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pathways_t::walk_times(uint32_t from, uint32_t avoid, std::vector<int32_t>& times) const
+{
+  times.assign(offsets.empty() ? 0 : offsets.size() - 1, -1);
+  if (from >= times.size())
+  {
+    return;
+  }
+  std::vector<uint32_t> touched;
+  dijkstra(from, avoid, times, touched);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::walk_time
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t pathways_t::walk_time(uint32_t from, uint32_t to, uint32_t avoid) const
+{
+  std::vector<int32_t> times;
+  walk_times(from, avoid, times);
+  if (to >= times.size())
+  {
+    return -1;
+  }
+  return times[to];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::entrance_time
+// precomputed time from an entrance to a platform of the same station
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t pathways_t::entrance_time(uint32_t entrance, uint32_t platform, pathway_profile_t profile) const
+{
+  if (!gtfs || entrance >= local.size() || platform >= local.size() || profile >= nbr_profiles)
+  {
+    return -1;
+  }
+  uint32_t station = gtfs->stops.station[entrance];
+  if (station != gtfs->stops.station[platform] ||
+    gtfs->stops.location_type[entrance] != 2 || gtfs->stops.location_type[platform] != 0 ||
+    local[entrance] == gtfs_none || local[platform] == gtfs_none)
+  {
+    return -1;
+  }
+  uint32_t nbr_platforms = platform_offsets[station + 1] - platform_offsets[station];
+  return matrix[profile][matrix_offsets[station] + local[entrance] * nbr_platforms + local[platform]];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::best_entrance
+// fastest entrance to a platform; returns its time, -1 if no entrance reaches the platform
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t pathways_t::best_entrance(uint32_t platform, pathway_profile_t profile, uint32_t& entrance) const
+{
+  entrance = gtfs_none;
+  if (!gtfs || platform >= local.size())
+  {
+    return -1;
+  }
+
+  int32_t best = -1;
+  range_t entrances = station_entrances(gtfs->stops.station[platform]);
+  for (uint32_t idx = entrances.begin; idx < entrances.end; ++idx)
+  {
+    int32_t time = entrance_time(entrance_list[idx], platform, profile);
+    if (time >= 0 && (best < 0 || time < best))
+    {
+      best = time;
+      entrance = entrance_list[idx];
+    }
+  }
+  return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::station_entrances
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+range_t pathways_t::station_entrances(uint32_t station) const
+{
+  range_t range = { 0, 0 };
+  if (static_cast<size_t>(station) + 1 < entrance_offsets.size())
+  {
+    range.begin = entrance_offsets[station];
+    range.end = entrance_offsets[station + 1];
+  }
+  return range;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::station_platforms
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+range_t pathways_t::station_platforms(uint32_t station) const
+{
+  range_t range = { 0, 0 };
+  if (static_cast<size_t>(station) + 1 < platform_offsets.size())
+  {
+    range.begin = platform_offsets[station];
+    range.end = platform_offsets[station + 1];
+  }
+  return range;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t::memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t pathways_t::memory() const
+{
+  size_t total = (offsets.capacity() + target.capacity() + entrance_list.capacity() + platform_list.capacity()) * sizeof(uint32_t);
+  total += weight.capacity() * sizeof(int32_t) + mode.capacity();
+  total += (entrance_offsets.capacity() + platform_offsets.capacity() + matrix_offsets.capacity() + local.capacity()) * sizeof(uint32_t);
+  for (int profile = 0; profile < nbr_profiles; ++profile)
+  {
+    total += matrix[profile].capacity() * sizeof(int32_t);
+  }
+  return total;
+}
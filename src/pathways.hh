@@ -0,0 +1,82 @@
+#ifndef PATHWAYS_HH
+#define PATHWAYS_HH
+
+#include <vector>
+#include <stdint.h>
+#include "gtfs.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// avoid masks
+// bit (1 << pathway_mode) set excludes pathways of that mode from a route
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t avoid_none = 0;
+const uint32_t avoid_stairs = 1 << 2;
+const uint32_t avoid_escalator = 1 << 4;
+const uint32_t avoid_elevator = 1 << 5;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathway_profile_t
+// the avoid masks with a precomputed entrance to platform matrix
+// profile_step_free avoids stairs and escalators, for wheelchair users
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum pathway_profile_t
+{
+  profile_all,
+  profile_no_escalator,
+  profile_no_elevator,
+  profile_step_free,
+  nbr_profiles
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// pathways_t
+// in-station walking graph from pathways.txt, as CSR adjacency over gtfs_t stop rows
+// edge weight is traversal_time, or length at walking speed when traversal_time is empty
+// build() runs Dijkstra from every entrance (location_type 2) of every station for each profile
+// and keeps the entrance x platform times, so entrance_time() is a table lookup
+// walk_time() answers any other pair or avoid mask with an on-demand Dijkstra
+// times are seconds, -1 when unreachable; the gtfs_t must outlive the pathways_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class pathways_t
+{
+public:
+  pathways_t();
+  int build(const gtfs_t& feed);
+  size_t size() const { return target.size(); }
+  size_t memory() const;
+
+  int32_t walk_time(uint32_t from, uint32_t to, uint32_t avoid = avoid_none) const;
+  void walk_times(uint32_t from, uint32_t avoid, std::vector<int32_t>& times) const;
+  int32_t entrance_time(uint32_t entrance, uint32_t platform, pathway_profile_t profile = profile_all) const;
+  int32_t best_entrance(uint32_t platform, pathway_profile_t profile, uint32_t& entrance) const;
+
+  range_t station_entrances(uint32_t station) const; //into entrance_list
+  range_t station_platforms(uint32_t station) const; //into platform_list
+  std::vector<uint32_t> entrance_list;
+  std::vector<uint32_t> platform_list;
+
+private:
+  const gtfs_t* gtfs;
+
+  //out edges of stop s are [offsets[s], offsets[s + 1])
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> target;
+  std::vector<int32_t> weight;
+  std::vector<uint8_t> mode;
+
+  //per station: entrances, platforms and the start of its entrance-major matrix
+  std::vector<uint32_t> entrance_offsets;
+  std::vector<uint32_t> platform_offsets;
+  std::vector<uint32_t> matrix_offsets;
+  std::vector<uint32_t> local; //stop -> index in its station's entrance or platform list
+  std::vector<int32_t> matrix[nbr_profiles];
+
+  void dijkstra(uint32_t from, uint32_t avoid, std::vector<int32_t>& times, std::vector<uint32_t>& touched) const;
+};
+
+uint32_t profile_avoid(pathway_profile_t profile);
+
+#endif
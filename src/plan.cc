@@ -0,0 +1,184 @@
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include "calendar.hh"
+#include "plan.hh"
+#include "update.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// format_time
+// seconds of the service day as HH:MM:SS, hours may exceed 23
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string format_time(int32_t seconds)
+{
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%02d:%02d:%02d", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+  return buf;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parse_clock
+// "HH:MM" or "HH:MM:SS" to seconds, -1 if malformed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t parse_clock(const std::string& str)
+{
+  int32_t seconds = parse_gtfs_time(str);
+  if (seconds < 0)
+  {
+    seconds = parse_gtfs_time(str + ":00");
+  }
+  return seconds;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// send_error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void send_error(Wt::Http::Response& response, int status, const std::string& message)
+{
+  response.setStatus(status);
+  response.setMimeType("application/json");
+  response.out() << "{\"error\":\"" << json_escape(message) << "\"}";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// PlanResource::PlanResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PlanResource::PlanResource(const feed_watcher_t& watcher) :
+  feeds(watcher)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// PlanResource::~PlanResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PlanResource::~PlanResource()
+{
+  beingDeleted();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// PlanResource::handleRequest
+// called concurrently from the server threads; raptor_t::query is const and thread safe
+// the feed snapshot is held for the whole request, so a reload cannot swap it mid query
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PlanResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+  std::shared_ptr<const feed_t> snapshot = feeds.current();
+  if (!snapshot)
+  {
+    send_error(response, 503, "GTFS feed is loading");
+    return;
+  }
+  const gtfs_t& feed = snapshot->gtfs;
+  const raptor_t& planner = snapshot->raptor;
+
+  const std::string* from_param = request.getParameter("from");
+  const std::string* to_param = request.getParameter("to");
+  if (!from_param || !to_param)
+  {
+    send_error(response, 400, "from and to are required");
+    return;
+  }
+
+  uint32_t from = planner.find_station(*from_param);
+  uint32_t to = planner.find_station(*to_param);
+  if (from == gtfs_none || to == gtfs_none)
+  {
+    send_error(response, 404, "unknown station");
+    return;
+  }
+
+  time_t now = std::time(nullptr);
+  struct tm tm;
+#ifdef _WIN32
+  localtime_s(&tm, &now);
+#else
+  localtime_r(&now, &tm);
+#endif
+  int32_t date = gtfs_date(tm);
+  int32_t seconds = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+
+  const std::string* time_param = request.getParameter("time");
+  if (time_param)
+  {
+    seconds = parse_clock(*time_param);
+    if (seconds < 0)
+    {
+      send_error(response, 400, "time must be HH:MM or HH:MM:SS");
+      return;
+    }
+  }
+  const std::string* date_param = request.getParameter("date");
+  if (date_param)
+  {
+    date = std::atoi(date_param->c_str());
+    if (date < 19700101 || date > 99991231)
+    {
+      send_error(response, 400, "date must be yyyymmdd");
+      return;
+    }
+  }
+
+  journey_t journey;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int result = planner.query(from, to, date, seconds, journey);
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (result < 0)
+  {
+    send_error(response, 404, "no journey found");
+    return;
+  }
+
+  std::stringstream json;
+  json << "{"
+    << "\"from\":\"" << json_escape(feed.str(feed.stops.name[from])) << "\","
+    << "\"to\":\"" << json_escape(feed.str(feed.stops.name[to])) << "\","
+    << "\"date\":" << date << ","
+    << "\"departure\":\"" << format_time(journey.departure) << "\","
+    << "\"arrival\":\"" << format_time(journey.arrival) << "\","
+    << "\"transfers\":" << journey.nbr_transfers << ","
+    << "\"query_us\":" << static_cast<int>(elapsed.count()) << ","
+    << "\"legs\":[";
+
+  for (size_t idx = 0; idx < journey.legs.size(); ++idx)
+  {
+    const journey_leg_t& leg = journey.legs[idx];
+    if (idx > 0)
+    {
+      json << ",";
+    }
+    json << "{";
+    if (leg.trip == gtfs_none)
+    {
+      json << "\"mode\":\"walk\",";
+    }
+    else
+    {
+      uint32_t route = feed.trips.route[leg.trip];
+      json << "\"mode\":\"train\","
+        << "\"line\":\"" << json_escape(route != gtfs_none ? feed.str(feed.routes.short_name[route]) : "") << "\","
+        << "\"headsign\":\"" << json_escape(feed.str(feed.trips.headsign[leg.trip])) << "\","
+        << "\"trip_id\":\"" << json_escape(feed.str(feed.trips.trip_id[leg.trip])) << "\",";
+    }
+    json << "\"from\":\"" << json_escape(feed.str(feed.stops.name[leg.from_stop])) << "\","
+      << "\"from_id\":\"" << json_escape(feed.str(feed.stops.stop_id[leg.from_stop])) << "\","
+      << "\"to\":\"" << json_escape(feed.str(feed.stops.name[leg.to_stop])) << "\","
+      << "\"to_id\":\"" << json_escape(feed.str(feed.stops.stop_id[leg.to_stop])) << "\","
+      << "\"departure\":\"" << format_time(leg.departure) << "\","
+      << "\"arrival\":\"" << format_time(leg.arrival) << "\""
+      << "}";
+  }
+  json << "]}";
+
+  response.setMimeType("application/json");
+  response.out() << json.str();
+}
@@ -0,0 +1,32 @@
+#ifndef PLAN_HH
+#define PLAN_HH
+
+#include <memory>
+#include <Wt/WResource.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include "feed.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// PlanResource
+// GET /plan?from=A01&to=B10[&time=HH:MM[:SS]][&date=yyyymmdd]
+// earliest arrival journey between two stations as JSON; time and date default to now
+// stations are WMATA codes or GTFS stop_ids; answers 503 until the GTFS feed is loaded
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PlanResource : public Wt::WResource
+{
+public:
+  PlanResource(const feed_watcher_t& watcher);
+  virtual ~PlanResource();
+
+protected:
+  virtual void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+  const feed_watcher_t& feeds;
+};
+
+void send_error(Wt::Http::Response& response, int status, const std::string& message);
+
+#endif
@@ -0,0 +1,275 @@
+#include <iostream>
+#include <algorithm>
+#include "poller.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// local_tm
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct tm local_tm(time_t time)
+{
+  struct tm tm;
+#ifdef _WIN32
+  localtime_s(&tm, &time);
+#else
+  localtime_r(&time, &tm);
+#endif
+  return tm;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t::api_quota_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+api_quota_t::api_quota_t(double per_second, uint32_t per_day) :
+  rate(std::max(per_second, 1.0)),
+  day_limit(per_day),
+  tokens(rate),
+  refilled(std::chrono::steady_clock::now()),
+  day(0),
+  used(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t::roll_day
+// the daily count starts over at local midnight; called with mutex held
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void api_quota_t::roll_day()
+{
+  struct tm tm = local_tm(std::time(nullptr));
+  int today = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+  if (today != day)
+  {
+    day = today;
+    used = 0;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t::acquire
+// take one call from both budgets; false, and nothing taken, if either is spent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool api_quota_t::acquire()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  roll_day();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  tokens = std::min(rate, tokens + std::chrono::duration<double>(now - refilled).count() * rate);
+  refilled = now;
+  if (used >= day_limit || tokens < 1)
+  {
+    return false;
+  }
+  tokens -= 1;
+  ++used;
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t::remaining_today
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t api_quota_t::remaining_today()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  roll_day();
+  return used < day_limit ? day_limit - used : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t::until_reset
+// time to the next local midnight
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::seconds api_quota_t::until_reset() const
+{
+  struct tm tm = local_tm(std::time(nullptr));
+  int elapsed = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+  return std::chrono::seconds(std::max(24 * 3600 - elapsed, 1));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::poller_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+poller_t::poller_t(api_quota_t& quota_, const poll_options_t& options_) :
+  quota(quota_),
+  options(options_),
+  next_interval(static_cast<double>(options_.min_interval.count())),
+  change_rate(-1),
+  stopping(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::~poller_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+poller_t::~poller_t()
+{
+  stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::interval
+// wait before the next poll
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::seconds poller_t::interval() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::chrono::seconds(static_cast<long long>(next_interval + 0.5));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::budget_interval
+// shortest interval that lasts the poller's share of today's quota until the reset
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::seconds poller_t::budget_interval()
+{
+  double reserve = quota.per_day() * (1 - options.share);
+  double spend = quota.remaining_today() - reserve;
+  std::chrono::seconds reset = quota.until_reset();
+  if (spend < 1)
+  {
+    return reset;
+  }
+  return std::chrono::seconds(static_cast<long long>(reset.count() / spend + 1));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::adapt
+// aim for target_change of the records changed at each poll, given the smoothed change rate
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void poller_t::adapt(double change, double elapsed)
+{
+  double lo = static_cast<double>(options.min_interval.count());
+  double hi = static_cast<double>(options.max_interval.count());
+  double next;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (elapsed > 0)
+    {
+      double rate = change / elapsed;
+      change_rate = change_rate < 0 ? rate : 0.5 * change_rate + 0.5 * rate;
+    }
+    if (change_rate < 0)
+    {
+      next = lo;
+    }
+    else if (change_rate > 0)
+    {
+      next = options.target_change / change_rate;
+    }
+    else
+    {
+      next = next_interval * 1.5;
+    }
+  }
+  next = std::min(std::max(next, lo), hi);
+  next = std::max(next, static_cast<double>(budget_interval().count()));
+  std::lock_guard<std::mutex> lock(mutex);
+  next_interval = next;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::poll
+// one fetch now, if the quota allows; returns true if a result was published
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool poller_t::poll()
+{
+  if (!fetch || !on_update)
+  {
+    return false;
+  }
+  double hi = static_cast<double>(options.max_interval.count());
+
+  if (!quota.acquire())
+  {
+    //the per second bucket refills within a second; a spent daily quota waits for the reset
+    double wait = quota.remaining_today() > 0 ? 1.0 : static_cast<double>(quota.until_reset().count());
+    std::lock_guard<std::mutex> lock(mutex);
+    next_interval = wait;
+    return false;
+  }
+
+  std::string body;
+  if (fetch(body) != 0)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    next_interval = std::min(next_interval * 2, hi);
+    return false;
+  }
+
+  double change = on_update(body);
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double elapsed = last_update.time_since_epoch().count() == 0 ? 0 : std::chrono::duration<double>(now - last_update).count();
+  last_update = now;
+  adapt(change, elapsed);
+
+  std::cout << "poll: " << static_cast<int>(change * 100 + 0.5) << "% changed, next in " << interval().count() << " s, "
+    << quota.remaining_today() << " calls left today" << std::endl;
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::start
+// polls at once, then at the adapted interval
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void poller_t::start()
+{
+  if (thread.joinable())
+  {
+    return;
+  }
+  stopping = false;
+  thread = std::thread(&poller_t::run, this);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::stop
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void poller_t::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  if (thread.joinable())
+  {
+    thread.join();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t::run
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void poller_t::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping)
+  {
+    lock.unlock();
+    try
+    {
+      poll();
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "poll: " << e.what() << std::endl;
+    }
+    lock.lock();
+    std::chrono::milliseconds wait(static_cast<long long>(next_interval * 1000));
+    cv.wait_for(lock, wait, [this]() { return stopping; });
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef POLLER_HH
+#define POLLER_HH
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// api_quota_t
+// the WMATA request budget: a token bucket for calls per second and a counter of calls per day,
+// reset at local midnight; shared by every caller of the API in the process
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class api_quota_t
+{
+public:
+  api_quota_t(double per_second, uint32_t per_day);
+  bool acquire();
+  uint32_t per_day() const { return day_limit; }
+  uint32_t remaining_today();
+  std::chrono::seconds until_reset() const;
+
+private:
+  std::mutex mutex;
+  double rate;
+  uint32_t day_limit;
+  double tokens;
+  std::chrono::steady_clock::time_point refilled;
+  int day; //local yyyymmdd of used
+  uint32_t used;
+  void roll_day();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poll_options_t
+// share is the part of the daily quota the poller may spend; the rest is left for other calls
+// target_change is the fraction of records a poll should find changed: faster changes shorten
+// the interval, a feed that stands still lengthens it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct poll_options_t
+{
+  std::chrono::seconds min_interval = std::chrono::seconds(10);
+  std::chrono::seconds max_interval = std::chrono::seconds(300);
+  double share = 0.8;
+  double target_change = 0.25;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// poller_t
+// one background fetch loop for a resource every session wants (rail predictions); sessions read
+// the published result instead of calling the API themselves, so the call rate does not grow with
+// the number of sessions
+// fetch(body) makes the call, 0 on success; on_update(body) publishes the result and returns the
+// fraction of records that changed since the previous one, 0 to 1
+// the next interval follows the measured rate of change within [min_interval, max_interval], and
+// is never shorter than what spreads the remaining daily quota evenly until it resets
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class poller_t
+{
+public:
+  poller_t(api_quota_t& quota, const poll_options_t& options = poll_options_t());
+  ~poller_t();
+  void start();
+  void stop();
+  bool poll();
+  std::chrono::seconds interval() const;
+  std::chrono::seconds budget_interval();
+  std::function<int(std::string& body)> fetch;
+  std::function<double(const std::string& body)> on_update;
+
+private:
+  poller_t(const poller_t&) = delete;
+  poller_t& operator=(const poller_t&) = delete;
+  api_quota_t& quota;
+  poll_options_t options;
+  double next_interval; //seconds
+  double change_rate; //smoothed fraction changed per second, negative before two polls
+  std::chrono::steady_clock::time_point last_update;
+  std::thread thread;
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping;
+  void adapt(double change, double elapsed);
+  void run();
+};
+
+#endif
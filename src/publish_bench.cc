@@ -0,0 +1,167 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include "update.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// make_positions
+// nbr_trains positions with the field sizes of a real update
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<TrainPosition> make_positions(size_t nbr_trains)
+{
+  const char* destinations[] = { "Glenmont", "Shady Grove", "Grosvenor-Strathmore", "Silver Spring", "NoMa-Gallaudet U" };
+  const char* stations[] = { "Metro Center", "Gallery Pl-Chinatown", "Judiciary Square", "Union Station", "Dupont Circle",
+    "Woodley Park-Zoo/Adams Morgan", "Cleveland Park", "Van Ness-UDC", "Tenleytown-AU", "Friendship Heights" };
+  std::vector<TrainPosition> positions;
+  for (size_t idx = 0; idx < nbr_trains; ++idx)
+  {
+    TrainPosition pos;
+    pos.Lng = -77.0 - 0.001 * static_cast<double>(idx);
+    pos.Lat = 38.9 + 0.0007 * static_cast<double>(idx);
+    pos.Destination = destinations[idx % 5];
+    pos.LocationName = stations[idx % 10];
+    pos.Min = idx % 7 == 0 ? "BRD" : std::to_string(idx % 12);
+    pos.Car = idx % 3 == 0 ? "6" : "8";
+    pos.LineColor = idx % 3 == 0 ? "#E51636" : idx % 3 == 1 ? "#F68712" : "#1574C4";
+    pos.Scheduled = false;
+    positions.push_back(pos);
+  }
+  return positions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// session_t
+// what a session keeps between updates; outbox stands for the bytes queued on its connection
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct session_t
+{
+  uint64_t update_version = 0;
+  std::string outbox;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// best_ms
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double best_ms(int nbr_runs, const std::function<void()>& run)
+{
+  double best = 1e30;
+  for (int idx = 0; idx < nbr_runs; ++idx)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed.count() < best)
+    {
+      best = elapsed.count();
+    }
+  }
+  return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+// publish_bench [trains] [runs]
+// cost of one update for 1k, 5k and 10k sessions:
+//   per session  every session runs generate_train() and builds its script (before)
+//   shared       render_update() once, then each session takes the shared buffer (after)
+//   + send       shared, plus copying the script into each session's outbox, as doJavaScript does
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  size_t nbr_trains = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 120;
+  int nbr_runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+  std::vector<TrainPosition> positions = make_positions(nbr_trains);
+  std::shared_ptr<const std::string> red_js = render_red_line("");
+  std::map<std::string, std::string> line_colors = { {"RD", "#E51636"}, {"OR", "#F68712"}, {"BL", "#1574C4"} };
+
+  std::shared_ptr<const train_update_t> probe = render_update(positions, 1, 0, red_js, line_colors);
+  std::cout << nbr_trains << " trains, update " << probe->js.size() << " bytes, json " << probe->trains.json.size()
+    << " bytes, gzip " << probe->trains.json_gz.size() << " bytes" << std::endl;
+  std::cout << std::left << std::setw(10) << "sessions" << std::right
+    << std::setw(16) << "per session ms" << std::setw(12) << "shared ms" << std::setw(12) << "+ send ms"
+    << std::setw(14) << "serialized MB" << std::setw(10) << "speedup" << std::endl;
+
+  const size_t session_counts[] = { 1000, 5000, 10000 };
+  for (size_t idx = 0; idx < 3; ++idx)
+  {
+    size_t nbr_sessions = session_counts[idx];
+    std::vector<session_t> sessions(nbr_sessions);
+    uint64_t version = 1;
+    size_t serialized = 0;
+
+    double per_session_ms = best_ms(nbr_runs, [&]()
+      {
+        serialized = 0;
+        for (size_t jdx = 0; jdx < sessions.size(); ++jdx)
+        {
+          std::string trains_json = generate_train(positions);
+          std::stringstream js;
+          js << "window.last_trains = " << trains_json << ";\n"
+            << "if (typeof window.update_trains === 'function') {\n"
+            << "  window.update_trains(window.last_trains);\n"
+            << "}";
+          sessions[jdx].outbox = js.str();
+          serialized += sessions[jdx].outbox.size();
+        }
+      });
+    double per_session_mb = serialized / (1024.0 * 1024.0);
+
+    std::shared_ptr<const train_update_t> current;
+    size_t shared_bytes = 0;
+    size_t sent = 0;
+    double shared_ms = best_ms(nbr_runs, [&]()
+      {
+        std::shared_ptr<const train_update_t> update = render_update(positions, ++version, 0, red_js, line_colors);
+        std::atomic_store(&current, update);
+        shared_bytes = update->js.size() + update->trains.json.size() + update->trains.json_gz.size();
+        for (size_t jdx = 0; jdx < sessions.size(); ++jdx)
+        {
+          std::shared_ptr<const train_update_t> latest = std::atomic_load(&current);
+          if (latest->version != sessions[jdx].update_version)
+          {
+            sessions[jdx].update_version = latest->version;
+            ++sent;
+          }
+        }
+      });
+
+    double send_ms = best_ms(nbr_runs, [&]()
+      {
+        std::shared_ptr<const train_update_t> update = render_update(positions, ++version, 0, red_js, line_colors);
+        std::atomic_store(&current, update);
+        for (size_t jdx = 0; jdx < sessions.size(); ++jdx)
+        {
+          std::shared_ptr<const train_update_t> latest = std::atomic_load(&current);
+          if (latest->version != sessions[jdx].update_version)
+          {
+            sessions[jdx].update_version = latest->version;
+            sessions[jdx].outbox.assign(latest->js);
+          }
+        }
+      });
+
+    std::cout << std::left << std::setw(10) << nbr_sessions << std::right << std::fixed
+      << std::setw(16) << std::setprecision(2) << per_session_ms
+      << std::setw(12) << shared_ms
+      << std::setw(12) << send_ms
+      << std::setw(7) << std::setprecision(1) << per_session_mb << " / " << std::setprecision(2) << shared_bytes / (1024.0 * 1024.0)
+      << std::setw(9) << std::setprecision(0) << per_session_ms / shared_ms << "x" << std::endl;
+    if (sent == 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <Wt/WServer.h>
+#include "publisher.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::publisher_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+publisher_t::publisher_t() :
+  stopping(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::~publisher_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+publisher_t::~publisher_t()
+{
+  stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::subscribe
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::subscribe(const std::string& session_id, const std::function<void()>& notify)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  subscribers[session_id] = notify;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::unsubscribe
+// called from the session destructor; a callback already posted to the session is dropped by Wt
+// once the session is gone
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::unsubscribe(const std::string& session_id)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  subscribers.erase(session_id);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::publish
+// render runs under its own lock, so concurrent publishers (poller, feed reload, heartbeat) render
+// one at a time and update versions stay in order
+// post only queues the callback, so the lock is held for the loop; that keeps stop() from
+// returning while a post to a stopping server is in progress
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::publish()
+{
+  if (render)
+  {
+    std::lock_guard<std::mutex> lock(render_mutex);
+    render();
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  Wt::WServer* server = Wt::WServer::instance();
+  if (stopping || !server)
+  {
+    return;
+  }
+  for (std::map<std::string, std::function<void()>>::const_iterator it = subscribers.begin(); it != subscribers.end(); ++it)
+  {
+    server->post(it->first, it->second);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t publisher_t::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return subscribers.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::start(std::chrono::seconds heartbeat)
+{
+  if (thread.joinable())
+  {
+    return;
+  }
+  stopping = false;
+  thread = std::thread(&publisher_t::run, this, heartbeat);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::stop
+// no publication after this returns; call it before the server stops
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  if (thread.joinable())
+  {
+    thread.join();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t::run
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void publisher_t::run(std::chrono::seconds heartbeat)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!cv.wait_for(lock, heartbeat, [this]() { return stopping; }))
+  {
+    lock.unlock();
+    publish();
+    lock.lock();
+  }
+}
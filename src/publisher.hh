@@ -0,0 +1,48 @@
+#ifndef PUBLISHER_HH
+#define PUBLISHER_HH
+
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher_t
+// tells the open sessions that a new snapshot (predictions, Red Line layer) was published
+// publish() first calls render, once, to serialize the update every session will send; then it
+// queues each session's callback with WServer::post, where it runs under the session lock and
+// pushes the shared update over the open connection (server push, enableUpdates), so no session
+// polls on a timer or serializes anything itself
+// a heartbeat thread also publishes every heartbeat interval, so timetable positions keep moving
+// when no live data arrives
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class publisher_t
+{
+public:
+  publisher_t();
+  ~publisher_t();
+  void subscribe(const std::string& session_id, const std::function<void()>& notify);
+  void unsubscribe(const std::string& session_id);
+  void publish();
+  void start(std::chrono::seconds heartbeat);
+  void stop();
+  size_t size() const;
+  std::function<void()> render; //set before the first publish()
+
+private:
+  publisher_t(const publisher_t&) = delete;
+  publisher_t& operator=(const publisher_t&) = delete;
+  std::map<std::string, std::function<void()>> subscribers;
+  mutable std::mutex mutex;
+  std::mutex render_mutex;
+  std::condition_variable cv;
+  std::thread thread;
+  bool stopping;
+  void run(std::chrono::seconds heartbeat);
+};
+
+#endif
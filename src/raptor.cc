@@ -0,0 +1,618 @@
+#include <map>
+#include <algorithm>
+#include <limits>
+#include "calendar.hh"
+#include "raptor.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// transfer time between platforms of a station when pathways.txt has no path, seconds
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int32_t default_transfer = 120;
+const int32_t raptor_inf = std::numeric_limits<int32_t>::max();
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t::raptor_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+raptor_t::raptor_t() :
+  gtfs(nullptr),
+  calendar(nullptr)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// trip_follows
+// true if trip b, with the same stops as trip a, arrives and departs no earlier than a at every stop
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool trip_follows(const stop_time_table_t& stop_times, range_t a, range_t b)
+{
+  for (uint32_t idx = 0; idx < a.size(); ++idx)
+  {
+    if (stop_times.departure[b.begin + idx] < stop_times.departure[a.begin + idx] ||
+      stop_times.arrival[b.begin + idx] < stop_times.arrival[a.begin + idx])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t::build
+// returns -1 if the feed has no trips with stop times
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int raptor_t::build(const gtfs_t& feed, const service_calendar_t& services, const pathways_t* pathways)
+{
+  gtfs = &feed;
+  calendar = &services;
+  const stop_time_table_t& stop_times = gtfs->stop_times;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // patterns: trips of a route with the same stop sequence
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::map<std::pair<uint32_t, std::vector<uint32_t>>, uint32_t> pattern_keys;
+  std::vector<std::vector<uint32_t>> trip_lists;
+  std::vector<const std::vector<uint32_t>*> stop_lists;
+  std::vector<uint32_t> route_list;
+
+  for (uint32_t trip = 0; trip < gtfs->trips.size(); ++trip)
+  {
+    range_t range = gtfs->trip_stop_times(trip);
+    if (range.size() < 2 || stop_times.departure[range.begin] < 0)
+    {
+      continue;
+    }
+    std::pair<uint32_t, std::vector<uint32_t>> key(gtfs->trips.route[trip],
+      std::vector<uint32_t>(stop_times.stop.begin() + range.begin, stop_times.stop.begin() + range.end));
+    std::pair<std::map<std::pair<uint32_t, std::vector<uint32_t>>, uint32_t>::iterator, bool> it =
+      pattern_keys.insert(std::make_pair(key, static_cast<uint32_t>(trip_lists.size())));
+    if (it.second)
+    {
+      trip_lists.push_back(std::vector<uint32_t>());
+      stop_lists.push_back(&it.first->first.second);
+      route_list.push_back(gtfs->trips.route[trip]);
+    }
+    trip_lists[it.first->second].push_back(trip);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // trips sorted by first departure, then split wherever one overtakes another: query() finds the
+  // trip to board with a binary search, which needs departures to rise from trip to trip at every
+  // stop of a pattern; each trip joins the first split whose last trip it never passes
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::vector<uint32_t>> split_trips;
+  std::vector<const std::vector<uint32_t>*> split_stops;
+  pattern_route.clear();
+  for (size_t pattern = 0; pattern < trip_lists.size(); ++pattern)
+  {
+    std::vector<uint32_t>& trips = trip_lists[pattern];
+    std::stable_sort(trips.begin(), trips.end(), [&](uint32_t a, uint32_t b)
+      {
+        return stop_times.departure[gtfs->trip_stop_times(a).begin] < stop_times.departure[gtfs->trip_stop_times(b).begin];
+      });
+
+    const size_t first_split = split_trips.size();
+    for (size_t idx = 0; idx < trips.size(); ++idx)
+    {
+      size_t split = first_split;
+      while (split < split_trips.size() &&
+        !trip_follows(stop_times, gtfs->trip_stop_times(split_trips[split].back()), gtfs->trip_stop_times(trips[idx])))
+      {
+        ++split;
+      }
+      if (split == split_trips.size())
+      {
+        split_trips.push_back(std::vector<uint32_t>());
+        split_stops.push_back(stop_lists[pattern]);
+        pattern_route.push_back(route_list[pattern]);
+      }
+      split_trips[split].push_back(trips[idx]);
+    }
+  }
+  trip_lists.swap(split_trips);
+  stop_lists.swap(split_stops);
+  const size_t nbr_pattern = trip_lists.size();
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // dense stops, in order of first use
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  stop_row.clear();
+  stop_index.assign(gtfs->stops.size(), gtfs_none);
+  for (size_t pattern = 0; pattern < nbr_pattern; ++pattern)
+  {
+    const std::vector<uint32_t>& stops = *stop_lists[pattern];
+    for (size_t idx = 0; idx < stops.size(); ++idx)
+    {
+      if (stop_index[stops[idx]] == gtfs_none)
+      {
+        stop_index[stops[idx]] = static_cast<uint32_t>(stop_row.size());
+        stop_row.push_back(stops[idx]);
+      }
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // pattern arrays, trips in departure order
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  pattern_stop_offsets.assign(1, 0);
+  pattern_trip_offsets.assign(1, 0);
+  pattern_time_offsets.assign(1, 0);
+  pattern_stops.clear();
+  pattern_trips.clear();
+  arrivals.clear();
+  departures.clear();
+
+  for (size_t pattern = 0; pattern < nbr_pattern; ++pattern)
+  {
+    const std::vector<uint32_t>& stops = *stop_lists[pattern];
+    const std::vector<uint32_t>& trips = trip_lists[pattern];
+    for (size_t idx = 0; idx < stops.size(); ++idx)
+    {
+      pattern_stops.push_back(stop_index[stops[idx]]);
+    }
+    for (size_t idx = 0; idx < trips.size(); ++idx)
+    {
+      pattern_trips.push_back(trips[idx]);
+      range_t range = gtfs->trip_stop_times(trips[idx]);
+      for (uint32_t pos = range.begin; pos < range.end; ++pos)
+      {
+        arrivals.push_back(stop_times.arrival[pos]);
+        departures.push_back(stop_times.departure[pos]);
+      }
+    }
+    pattern_stop_offsets.push_back(static_cast<uint32_t>(pattern_stops.size()));
+    pattern_trip_offsets.push_back(static_cast<uint32_t>(pattern_trips.size()));
+    pattern_time_offsets.push_back(static_cast<uint32_t>(arrivals.size()));
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // stop -> (pattern, position)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  const size_t nbr_stop = stop_row.size();
+  stop_pattern_offsets.assign(nbr_stop + 1, 0);
+  for (size_t idx = 0; idx < pattern_stops.size(); ++idx)
+  {
+    ++stop_pattern_offsets[pattern_stops[idx] + 1];
+  }
+  for (size_t idx = 1; idx <= nbr_stop; ++idx)
+  {
+    stop_pattern_offsets[idx] += stop_pattern_offsets[idx - 1];
+  }
+  stop_patterns.resize(pattern_stops.size());
+  stop_pattern_pos.resize(pattern_stops.size());
+  std::vector<uint32_t> fill(stop_pattern_offsets.begin(), stop_pattern_offsets.end() - 1);
+  for (uint32_t pattern = 0; pattern < nbr_pattern; ++pattern)
+  {
+    for (uint32_t pos = pattern_stop_offsets[pattern]; pos < pattern_stop_offsets[pattern + 1]; ++pos)
+    {
+      uint32_t slot = fill[pattern_stops[pos]]++;
+      stop_patterns[slot] = pattern;
+      stop_pattern_pos[slot] = pos - pattern_stop_offsets[pattern];
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // transfers between served platforms of the same station
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::map<uint32_t, std::vector<uint32_t>> station_stops;
+  for (uint32_t stop = 0; stop < nbr_stop; ++stop)
+  {
+    station_stops[gtfs->stops.station[stop_row[stop]]].push_back(stop);
+  }
+
+  transfer_offsets.assign(1, 0);
+  transfer_target.clear();
+  transfer_time.clear();
+  std::vector<int32_t> times;
+  for (uint32_t stop = 0; stop < nbr_stop; ++stop)
+  {
+    const std::vector<uint32_t>& others = station_stops[gtfs->stops.station[stop_row[stop]]];
+    if (pathways && others.size() > 1)
+    {
+      pathways->walk_times(stop_row[stop], avoid_none, times);
+    }
+    for (size_t idx = 0; idx < others.size(); ++idx)
+    {
+      if (others[idx] == stop)
+      {
+        continue;
+      }
+      int32_t time = default_transfer;
+      if (pathways && times[stop_row[others[idx]]] >= 0)
+      {
+        time = times[stop_row[others[idx]]];
+      }
+      transfer_target.push_back(others[idx]);
+      transfer_time.push_back(time);
+    }
+    transfer_offsets.push_back(static_cast<uint32_t>(transfer_target.size()));
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // station codes: "STN_A01_C01" is found as "STN_A01_C01", "A01" and "C01"
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  station_codes.clear();
+  for (uint32_t stop = 0; stop < gtfs->stops.size(); ++stop)
+  {
+    if (gtfs->stops.location_type[stop] != 1)
+    {
+      continue;
+    }
+    std::string_view id = gtfs->str(gtfs->stops.stop_id[stop]);
+    station_codes[std::string(id)] = stop;
+    if (id.substr(0, 4) == "STN_")
+    {
+      id.remove_prefix(4);
+    }
+    while (!id.empty())
+    {
+      size_t sep = id.find('_');
+      station_codes.insert(std::make_pair(std::string(id.substr(0, sep)), stop));
+      if (sep == std::string_view::npos)
+      {
+        break;
+      }
+      id.remove_prefix(sep + 1);
+    }
+  }
+
+  return nbr_pattern ? 0 : -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t::find_station
+// station row for a WMATA station code ("A01") or a GTFS stop_id, gtfs_none if unknown
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t raptor_t::find_station(std::string_view code) const
+{
+  std::unordered_map<std::string, uint32_t>::const_iterator it = station_codes.find(std::string(code));
+  if (it != station_codes.end())
+  {
+    return it->second;
+  }
+  if (gtfs)
+  {
+    uint32_t stop = gtfs->find_stop(code);
+    if (stop != gtfs_none)
+    {
+      return gtfs->stops.station[stop];
+    }
+  }
+  return gtfs_none;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// label_t
+// how a stop was reached in a round
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum label_kind_t
+{
+  label_none,
+  label_source,
+  label_trip,
+  label_transfer
+};
+
+struct label_t
+{
+  int32_t time;
+  uint8_t kind;
+  uint32_t pattern; //label_trip
+  uint32_t trip; //label_trip, index in the pattern's trips
+  uint32_t from; //label_trip: boarding position in the pattern; label_transfer: dense stop walked from
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t::query
+// earliest arrival from any platform of from_station, at seconds of service day date or later, to
+// any platform of to_station, with at most max_rounds - 1 transfers
+// returns 0 and fills journey, -1 if to_station cannot be reached that service day
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int raptor_t::query(uint32_t from_station, uint32_t to_station, int32_t date, int32_t seconds, journey_t& journey, size_t max_rounds) const
+{
+  journey.legs.clear();
+  journey.departure = -1;
+  journey.arrival = -1;
+  journey.nbr_transfers = 0;
+  if (!gtfs || from_station >= gtfs->stops.size() || to_station >= gtfs->stops.size() || from_station == to_station)
+  {
+    return -1;
+  }
+
+  const size_t nbr_stop = stop_row.size();
+  std::vector<uint8_t> active;
+  calendar->services_on(date, active);
+
+  std::vector<label_t> labels((max_rounds + 1) * nbr_stop);
+  for (size_t idx = 0; idx < labels.size(); ++idx)
+  {
+    labels[idx].time = raptor_inf;
+    labels[idx].kind = label_none;
+  }
+  std::vector<int32_t> best(nbr_stop, raptor_inf);
+  std::vector<uint8_t> target(nbr_stop, 0);
+  std::vector<uint8_t> marked(nbr_stop, 0);
+  std::vector<uint32_t> marked_list;
+  std::vector<uint32_t> queue_pos(pattern_route.size(), gtfs_none);
+  std::vector<uint32_t> queue;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // round 0: every served platform of the origin at the requested time
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  range_t children = gtfs->station_children(from_station);
+  for (uint32_t idx = children.begin; idx <= children.end; ++idx)
+  {
+    uint32_t row = idx < children.end ? gtfs->station_child_list[idx] : from_station;
+    uint32_t stop = stop_index[row];
+    if (stop == gtfs_none || marked[stop])
+    {
+      continue;
+    }
+    labels[stop].time = seconds;
+    labels[stop].kind = label_source;
+    best[stop] = seconds;
+    marked[stop] = 1;
+    marked_list.push_back(stop);
+  }
+
+  children = gtfs->station_children(to_station);
+  for (uint32_t idx = children.begin; idx <= children.end; ++idx)
+  {
+    uint32_t row = idx < children.end ? gtfs->station_child_list[idx] : to_station;
+    if (stop_index[row] != gtfs_none)
+    {
+      target[stop_index[row]] = 1;
+    }
+  }
+
+  int32_t target_best = raptor_inf;
+  for (size_t round = 1; round <= max_rounds && !marked_list.empty(); ++round)
+  {
+    const label_t* prev = &labels[(round - 1) * nbr_stop];
+    label_t* cur = &labels[round * nbr_stop];
+    for (size_t stop = 0; stop < nbr_stop; ++stop)
+    {
+      cur[stop].time = prev[stop].time;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+    // patterns through a stop improved last round, from their earliest such stop
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    queue.clear();
+    for (size_t idx = 0; idx < marked_list.size(); ++idx)
+    {
+      uint32_t stop = marked_list[idx];
+      marked[stop] = 0;
+      for (uint32_t slot = stop_pattern_offsets[stop]; slot < stop_pattern_offsets[stop + 1]; ++slot)
+      {
+        uint32_t pattern = stop_patterns[slot];
+        if (queue_pos[pattern] == gtfs_none)
+        {
+          queue.push_back(pattern);
+          queue_pos[pattern] = stop_pattern_pos[slot];
+        }
+        else if (stop_pattern_pos[slot] < queue_pos[pattern])
+        {
+          queue_pos[pattern] = stop_pattern_pos[slot];
+        }
+      }
+    }
+    marked_list.clear();
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+    // scan each queued pattern, riding the earliest catchable trip
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    for (size_t qdx = 0; qdx < queue.size(); ++qdx)
+    {
+      const uint32_t pattern = queue[qdx];
+      const uint32_t first = queue_pos[pattern];
+      queue_pos[pattern] = gtfs_none;
+
+      const uint32_t* stops = &pattern_stops[pattern_stop_offsets[pattern]];
+      const uint32_t nbr_pattern_stop = pattern_stop_offsets[pattern + 1] - pattern_stop_offsets[pattern];
+      const uint32_t* trips = &pattern_trips[pattern_trip_offsets[pattern]];
+      const uint32_t nbr_trip = pattern_trip_offsets[pattern + 1] - pattern_trip_offsets[pattern];
+      const int32_t* arr = &arrivals[pattern_time_offsets[pattern]];
+      const int32_t* dep = &departures[pattern_time_offsets[pattern]];
+
+      uint32_t trip = gtfs_none;
+      uint32_t board = 0;
+      for (uint32_t pos = first; pos < nbr_pattern_stop; ++pos)
+      {
+        const uint32_t stop = stops[pos];
+        if (trip != gtfs_none)
+        {
+          int32_t time = arr[trip * nbr_pattern_stop + pos];
+          if (time < best[stop] && time < target_best)
+          {
+            cur[stop].time = time;
+            cur[stop].kind = label_trip;
+            cur[stop].pattern = pattern;
+            cur[stop].trip = trip;
+            cur[stop].from = board;
+            best[stop] = time;
+            if (!marked[stop])
+            {
+              marked[stop] = 1;
+              marked_list.push_back(stop);
+            }
+            if (target[stop])
+            {
+              target_best = time;
+            }
+          }
+        }
+
+        //catch an earlier trip here if the previous round reached this stop in time
+        const int32_t ready = prev[stop].time;
+        if (ready == raptor_inf || (trip != gtfs_none && ready > dep[trip * nbr_pattern_stop + pos]))
+        {
+          continue;
+        }
+        uint32_t lo = 0;
+        uint32_t hi = trip != gtfs_none ? trip : nbr_trip;
+        while (lo < hi)
+        {
+          uint32_t mid = (lo + hi) / 2;
+          if (dep[mid * nbr_pattern_stop + pos] < ready)
+          {
+            lo = mid + 1;
+          }
+          else
+          {
+            hi = mid;
+          }
+        }
+        uint32_t end = trip != gtfs_none ? trip : nbr_trip;
+        for (; lo < end; ++lo)
+        {
+          uint32_t service = gtfs->trips.service[trips[lo]];
+          if (service != gtfs_none && active[service] && dep[lo * nbr_pattern_stop + pos] >= ready)
+          {
+            trip = lo;
+            board = pos;
+            break;
+          }
+        }
+      }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+    // walking transfers from the stops reached by a trip this round
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    const size_t nbr_ridden = marked_list.size();
+    for (size_t idx = 0; idx < nbr_ridden; ++idx)
+    {
+      uint32_t stop = marked_list[idx];
+      for (uint32_t edge = transfer_offsets[stop]; edge < transfer_offsets[stop + 1]; ++edge)
+      {
+        uint32_t next = transfer_target[edge];
+        int32_t time = cur[stop].time + transfer_time[edge];
+        if (time < best[next] && time < target_best)
+        {
+          cur[next].time = time;
+          cur[next].kind = label_transfer;
+          cur[next].from = stop;
+          best[next] = time;
+          if (!marked[next])
+          {
+            marked[next] = 1;
+            marked_list.push_back(next);
+          }
+          if (target[next])
+          {
+            target_best = time;
+          }
+        }
+      }
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // best target platform, then walk the labels back to the origin
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  uint32_t stop = gtfs_none;
+  for (uint32_t idx = 0; idx < nbr_stop; ++idx)
+  {
+    if (target[idx] && best[idx] != raptor_inf && (stop == gtfs_none || best[idx] < best[stop]))
+    {
+      stop = idx;
+    }
+  }
+  if (stop == gtfs_none)
+  {
+    return -1;
+  }
+
+  size_t round = max_rounds;
+  while (round > 0 && labels[round * nbr_stop + stop].kind == label_none)
+  {
+    --round;
+  }
+
+  while (true)
+  {
+    const label_t& label = labels[round * nbr_stop + stop];
+    if (label.kind == label_source)
+    {
+      break;
+    }
+    journey_leg_t leg;
+    if (label.kind == label_transfer)
+    {
+      leg.trip = gtfs_none;
+      leg.from_stop = stop_row[label.from];
+      leg.to_stop = stop_row[stop];
+      leg.departure = labels[round * nbr_stop + label.from].time;
+      leg.arrival = label.time;
+      journey.legs.push_back(leg);
+      stop = label.from;
+      continue;
+    }
+    if (label.kind != label_trip)
+    {
+      journey.legs.clear();
+      return -1;
+    }
+
+    const uint32_t nbr_pattern_stop = pattern_stop_offsets[label.pattern + 1] - pattern_stop_offsets[label.pattern];
+    const uint32_t time_base = pattern_time_offsets[label.pattern] + label.trip * nbr_pattern_stop;
+    uint32_t board_stop = pattern_stops[pattern_stop_offsets[label.pattern] + label.from];
+    leg.trip = pattern_trips[pattern_trip_offsets[label.pattern] + label.trip];
+    leg.from_stop = stop_row[board_stop];
+    leg.to_stop = stop_row[stop];
+    leg.departure = departures[time_base + label.from];
+    leg.arrival = label.time;
+    journey.legs.push_back(leg);
+    ++journey.nbr_transfers;
+
+    stop = board_stop;
+    --round;
+    while (round > 0 && labels[round * nbr_stop + stop].kind == label_none)
+    {
+      --round;
+    }
+  }
+
+  std::reverse(journey.legs.begin(), journey.legs.end());
+  if (journey.legs.empty())
+  {
+    return -1;
+  }
+  journey.nbr_transfers = journey.nbr_transfers > 0 ? journey.nbr_transfers - 1 : 0;
+  journey.departure = journey.legs.front().departure;
+  journey.arrival = journey.legs.back().arrival;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t::memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t raptor_t::memory() const
+{
+  size_t total = (pattern_route.capacity() + pattern_stop_offsets.capacity() + pattern_stops.capacity() +
+    pattern_trip_offsets.capacity() + pattern_trips.capacity() + pattern_time_offsets.capacity()) * sizeof(uint32_t);
+  total += (arrivals.capacity() + departures.capacity() + transfer_time.capacity()) * sizeof(int32_t);
+  total += (stop_row.capacity() + stop_index.capacity() + stop_pattern_offsets.capacity() + stop_patterns.capacity() +
+    stop_pattern_pos.capacity() + transfer_offsets.capacity() + transfer_target.capacity()) * sizeof(uint32_t);
+  return total;
+}
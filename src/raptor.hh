@@ -0,0 +1,87 @@
+#ifndef RAPTOR_HH
+#define RAPTOR_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "gtfs.hh"
+#include "pathways.hh"
+#include "calendar.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// journey_t
+// legs of a planned trip; a walking transfer leg has trip gtfs_none
+// stops and trips are gtfs_t rows, times are seconds of the service day
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct journey_leg_t
+{
+  uint32_t trip;
+  uint32_t from_stop;
+  uint32_t to_stop;
+  int32_t departure;
+  int32_t arrival;
+};
+
+struct journey_t
+{
+  int32_t departure;
+  int32_t arrival;
+  size_t nbr_transfers;
+  std::vector<journey_leg_t> legs;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// raptor_t
+// earliest arrival journey planner (RAPTOR, Delling et al.) over a loaded gtfs_t
+// build() groups trips with the same route and stop sequence into patterns and lays their stop
+// times out pattern by pattern, trip-major, so a round scans contiguous memory; a pattern is split
+// where one trip overtakes another, so its trips keep the same order at every stop; stops are
+// renumbered densely to the platforms that trains serve
+// transfers are walks between platforms of the same station, timed with pathways_t when given
+// query() is const and keeps its labels on the stack of the caller, so any number of threads can
+// plan at once; the gtfs_t, service_calendar_t and pathways_t must outlive the raptor_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class raptor_t
+{
+public:
+  raptor_t();
+  int build(const gtfs_t& feed, const service_calendar_t& services, const pathways_t* pathways = nullptr);
+  uint32_t find_station(std::string_view code) const;
+  int query(uint32_t from_station, uint32_t to_station, int32_t date, int32_t seconds, journey_t& journey, size_t max_rounds = 6) const;
+  size_t nbr_patterns() const { return pattern_route.size(); }
+  size_t nbr_stops() const { return stop_row.size(); }
+  size_t memory() const;
+
+private:
+  const gtfs_t* gtfs;
+  const service_calendar_t* calendar;
+
+  //pattern p: stops [stop_offsets[p], stop_offsets[p + 1]) of pattern_stops, trips likewise,
+  //times of trip t at stop s at time_offsets[p] + t * nbr_stops(p) + s
+  std::vector<uint32_t> pattern_route;
+  std::vector<uint32_t> pattern_stop_offsets;
+  std::vector<uint32_t> pattern_stops;
+  std::vector<uint32_t> pattern_trip_offsets;
+  std::vector<uint32_t> pattern_trips;
+  std::vector<uint32_t> pattern_time_offsets;
+  std::vector<int32_t> arrivals;
+  std::vector<int32_t> departures;
+
+  //dense stop index: stop_row[s] is the gtfs_t row, stop_index[row] the reverse (gtfs_none if unserved)
+  std::vector<uint32_t> stop_row;
+  std::vector<uint32_t> stop_index;
+  std::vector<uint32_t> stop_pattern_offsets;
+  std::vector<uint32_t> stop_patterns;
+  std::vector<uint32_t> stop_pattern_pos;
+  std::vector<uint32_t> transfer_offsets;
+  std::vector<uint32_t> transfer_target;
+  std::vector<int32_t> transfer_time;
+
+  std::unordered_map<std::string, uint32_t> station_codes;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <chrono>
+#include <zlib.h>
+#include "record_log.hh"
+
+const char record_magic[4] = { 'W', 'M', 'R', '1' };
+const size_t block_header = 16;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// put_le, get_le
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void put_le(char* out, uint64_t value, size_t size)
+{
+  for (size_t idx = 0; idx < size; ++idx)
+  {
+    out[idx] = static_cast<char>((value >> (8 * idx)) & 0xff);
+  }
+}
+
+uint64_t get_le(const char* in, size_t size)
+{
+  uint64_t value = 0;
+  for (size_t idx = 0; idx < size; ++idx)
+  {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[idx])) << (8 * idx);
+  }
+  return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// now_ms
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_writer_t::open
+// appends to an existing log; a new or empty file gets the magic first
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int record_writer_t::open(const std::string& file_name)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ofs.open(file_name, std::ios::binary | std::ios::app);
+  if (!ofs.is_open())
+  {
+    std::cout << "record: cannot open " << file_name << std::endl;
+    return -1;
+  }
+  ofs.seekp(0, std::ios::end);
+  if (ofs.tellp() == std::streampos(0))
+  {
+    ofs.write(record_magic, sizeof(record_magic));
+    ofs.flush();
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_writer_t::append
+// one block, written with a single write and flushed, so readers of a live log see whole blocks
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int record_writer_t::append(int64_t time, const std::string& payload)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!ofs.is_open())
+  {
+    return -1;
+  }
+  uLongf stored = compressBound(static_cast<uLong>(payload.size()));
+  block.resize(block_header + stored);
+  if (compress2(reinterpret_cast<Bytef*>(&block[block_header]), &stored,
+    reinterpret_cast<const Bytef*>(payload.data()), static_cast<uLong>(payload.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+  {
+    return -1;
+  }
+  put_le(&block[0], static_cast<uint64_t>(time), 8);
+  put_le(&block[8], payload.size(), 4);
+  put_le(&block[12], stored, 4);
+  ofs.write(block.data(), static_cast<std::streamsize>(block_header + stored));
+  ofs.flush();
+  if (!ofs)
+  {
+    return -1;
+  }
+  ++nbr_records;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_reader_t::open
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int record_reader_t::open(const std::string& file_name)
+{
+  ifs.open(file_name, std::ios::binary);
+  char magic[sizeof(record_magic)];
+  if (!ifs.is_open() || !ifs.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(record_magic, sizeof(record_magic)))
+  {
+    std::cout << "record: " << file_name << " is not a record log" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_reader_t::next
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int record_reader_t::next(log_record_t& record)
+{
+  char header[block_header];
+  if (!ifs.read(header, block_header))
+  {
+    return 0;
+  }
+  record.time = static_cast<int64_t>(get_le(header, 8));
+  uLongf size = static_cast<uLongf>(get_le(header + 8, 4));
+  record.stored = static_cast<size_t>(get_le(header + 12, 4));
+  block.resize(record.stored);
+  if (!ifs.read(&block[0], static_cast<std::streamsize>(record.stored)))
+  {
+    std::cout << "record: partial last block ignored" << std::endl;
+    return 0;
+  }
+  record.payload.resize(size);
+  if (uncompress(reinterpret_cast<Bytef*>(&record.payload[0]), &size,
+    reinterpret_cast<const Bytef*>(block.data()), static_cast<uLong>(block.size())) != Z_OK || size != record.payload.size())
+  {
+    std::cout << "record: damaged block" << std::endl;
+    return -1;
+  }
+  return 1;
+}
@@ -0,0 +1,66 @@
+#ifndef RECORD_LOG_HH
+#define RECORD_LOG_HH
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record log
+// append-only file of timestamped API responses, for replaying a real day offline
+// layout: the 4 byte magic "WMR1", then one block per record, back to back
+//   uint64 time   milliseconds since the epoch, when the response arrived
+//   uint32 size   payload bytes
+//   uint32 stored compressed bytes that follow
+//   stored bytes  the payload as a zlib (deflate) stream
+// integers are little endian; each block is compressed on its own, so a crash while appending costs
+// at most the last record, and the reader stops cleanly at a partial block
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct log_record_t
+{
+  int64_t time; //ms since the epoch
+  std::string payload;
+  size_t stored; //compressed size in the file
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_writer_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class record_writer_t
+{
+public:
+  int open(const std::string& file_name);
+  bool is_open() const { return ofs.is_open(); }
+  int append(int64_t time, const std::string& payload);
+  uint64_t records() const { return nbr_records; }
+
+private:
+  std::mutex mutex;
+  std::ofstream ofs;
+  std::string block;
+  uint64_t nbr_records = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record_reader_t
+// next() returns 1 with a record, 0 at the end of the log (or at a partial last block), -1 if the
+// log is damaged
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class record_reader_t
+{
+public:
+  int open(const std::string& file_name);
+  int next(log_record_t& record);
+
+private:
+  std::ifstream ifs;
+  std::string block;
+};
+
+int64_t now_ms();
+
+#endif
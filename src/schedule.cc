@@ -0,0 +1,227 @@
+#include <algorithm>
+#include "schedule.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// service day minutes covered by the index; GTFS times past midnight run up to 47:59:59
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int32_t nbr_minutes = 48 * 60;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::schedule_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+schedule_t::schedule_t() :
+  gtfs(nullptr),
+  calendar(nullptr)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::build
+// returns -1 if the feed has no stop times
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int schedule_t::build(const gtfs_t& feed, const service_calendar_t& services)
+{
+  gtfs = &feed;
+  calendar = &services;
+  const size_t nbr_trips = gtfs->trips.size();
+  trip_start.assign(nbr_trips, -1);
+  trip_end.assign(nbr_trips, -1);
+  minute_offsets.assign(nbr_minutes + 1, 0);
+  minute_trips.clear();
+
+  for (uint32_t trip = 0; trip < nbr_trips; ++trip)
+  {
+    range_t range = gtfs->trip_stop_times(trip);
+    if (range.size() < 2)
+    {
+      continue;
+    }
+    int32_t start = gtfs->stop_times.departure[range.begin];
+    int32_t end = gtfs->stop_times.arrival[range.end - 1];
+    if (start < 0 || end < start)
+    {
+      continue;
+    }
+    trip_start[trip] = start;
+    trip_end[trip] = end;
+
+    int32_t last = std::min(end / 60, nbr_minutes - 1);
+    for (int32_t minute = start / 60; minute <= last; ++minute)
+    {
+      ++minute_offsets[minute + 1];
+    }
+  }
+
+  for (size_t idx = 1; idx < minute_offsets.size(); ++idx)
+  {
+    minute_offsets[idx] += minute_offsets[idx - 1];
+  }
+
+  minute_trips.resize(minute_offsets.back());
+  std::vector<uint32_t> fill(minute_offsets.begin(), minute_offsets.end() - 1);
+  for (uint32_t trip = 0; trip < nbr_trips; ++trip)
+  {
+    if (trip_start[trip] < 0)
+    {
+      continue;
+    }
+    int32_t last = std::min(trip_end[trip] / 60, nbr_minutes - 1);
+    for (int32_t minute = trip_start[trip] / 60; minute <= last; ++minute)
+    {
+      minute_trips[fill[minute]++] = trip;
+    }
+  }
+
+  return minute_trips.empty() ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::memory
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t schedule_t::memory() const
+{
+  return (trip_start.capacity() + trip_end.capacity()) * sizeof(int32_t) +
+    (minute_offsets.capacity() + minute_trips.capacity()) * sizeof(uint32_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::services_on
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void schedule_t::services_on(int32_t date, std::vector<uint8_t>& active) const
+{
+  if (!calendar)
+  {
+    active.clear();
+    return;
+  }
+  calendar->services_on(date, active);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::positions
+// append the position of every trip of an active service running at seconds of the service day
+// returns the number of positions added
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t schedule_t::positions(const std::vector<uint8_t>& active, int32_t seconds, std::vector<scheduled_position_t>& out) const
+{
+  if (!gtfs || seconds < 0 || seconds / 60 >= nbr_minutes)
+  {
+    return 0;
+  }
+
+  size_t nbr_positions = 0;
+  const int32_t minute = seconds / 60;
+  for (uint32_t idx = minute_offsets[minute]; idx < minute_offsets[minute + 1]; ++idx)
+  {
+    uint32_t trip = minute_trips[idx];
+    uint32_t service = gtfs->trips.service[trip];
+    if (service == gtfs_none || service >= active.size() || !active[service])
+    {
+      continue;
+    }
+    if (seconds < trip_start[trip] || seconds > trip_end[trip])
+    {
+      continue;
+    }
+
+    scheduled_position_t pos;
+    if (locate(trip, seconds, pos))
+    {
+      out.push_back(pos);
+      ++nbr_positions;
+    }
+  }
+  return nbr_positions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::positions_at
+// positions at a wall clock time, in the server's local time zone
+// trips of the previous service day still running after midnight are included
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t schedule_t::positions_at(time_t now, std::vector<scheduled_position_t>& out) const
+{
+  struct tm tm;
+#ifdef _WIN32
+  localtime_s(&tm, &now);
+#else
+  localtime_r(&now, &tm);
+#endif
+  int32_t date = gtfs_date(tm);
+  int32_t seconds = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+
+  std::vector<uint8_t> active;
+  size_t nbr_positions = 0;
+  services_on(date, active);
+  nbr_positions += positions(active, seconds, out);
+  services_on(add_days(date, -1), active);
+  nbr_positions += positions(active, seconds + 24 * 3600, out);
+  return nbr_positions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// stop_location
+// stop coordinates, falling back to the parent station for nodes without their own
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void stop_location(const gtfs_t& gtfs, uint32_t stop, double& lat, double& lon)
+{
+  lat = gtfs.stops.lat[stop];
+  lon = gtfs.stops.lon[stop];
+  if (lat == 0.0 && lon == 0.0)
+  {
+    uint32_t station = gtfs.stops.station[stop];
+    lat = gtfs.stops.lat[station];
+    lon = gtfs.stops.lon[station];
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t::locate
+// binary search of the trip's arrivals for the segment containing seconds
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool schedule_t::locate(uint32_t trip, int32_t seconds, scheduled_position_t& pos) const
+{
+  const stop_time_table_t& stop_times = gtfs->stop_times;
+  range_t range = gtfs->trip_stop_times(trip);
+  std::vector<int32_t>::const_iterator begin = stop_times.arrival.begin() + range.begin;
+  std::vector<int32_t>::const_iterator end = stop_times.arrival.begin() + range.end;
+  uint32_t next = static_cast<uint32_t>(std::upper_bound(begin, end, seconds) - stop_times.arrival.begin());
+  if (next == range.begin)
+  {
+    return false;
+  }
+  uint32_t prev = next - 1;
+
+  pos.trip = trip;
+  pos.from_stop = stop_times.stop[prev];
+  if (seconds <= stop_times.departure[prev] || next == range.end)
+  {
+    //dwelling at prev, or arrived at the last stop
+    pos.to_stop = pos.from_stop;
+    pos.fraction = 0.0;
+    pos.eta = 0;
+    stop_location(*gtfs, pos.from_stop, pos.lat, pos.lon);
+    return true;
+  }
+
+  pos.to_stop = stop_times.stop[next];
+  pos.eta = stop_times.arrival[next] - seconds;
+  int32_t span = stop_times.arrival[next] - stop_times.departure[prev];
+  pos.fraction = span > 0 ? static_cast<double>(seconds - stop_times.departure[prev]) / span : 0.0;
+
+  double from_lat, from_lon, to_lat, to_lon;
+  stop_location(*gtfs, pos.from_stop, from_lat, from_lon);
+  stop_location(*gtfs, pos.to_stop, to_lat, to_lon);
+  pos.lat = from_lat + (to_lat - from_lat) * pos.fraction;
+  pos.lon = from_lon + (to_lon - from_lon) * pos.fraction;
+  return true;
+}
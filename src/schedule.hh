@@ -0,0 +1,58 @@
+#ifndef SCHEDULE_HH
+#define SCHEDULE_HH
+
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include "gtfs.hh"
+#include "calendar.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// scheduled_position_t
+// where a trip is at a given time according to stop_times.txt
+// between from_stop (departed) and to_stop (next arrival); fraction 0 at from_stop, 1 at to_stop
+// a trip dwelling at a stop has from_stop == to_stop and fraction 0
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct scheduled_position_t
+{
+  uint32_t trip;
+  uint32_t from_stop;
+  uint32_t to_stop;
+  double fraction;
+  double lat;
+  double lon;
+  int32_t eta; //seconds until the scheduled arrival at to_stop
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// schedule_t
+// scheduled train positions from a loaded gtfs_t
+// build() indexes every trip by the minutes of the service day it runs in (up to 48:00:00, for
+// trips past midnight), so a query only visits the trips active in that minute
+// the gtfs_t and service_calendar_t must outlive the schedule_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class schedule_t
+{
+public:
+  schedule_t();
+  int build(const gtfs_t& feed, const service_calendar_t& services);
+  size_t size() const { return trip_start.size(); }
+  size_t memory() const;
+
+  void services_on(int32_t date, std::vector<uint8_t>& active) const;
+  size_t positions(const std::vector<uint8_t>& active, int32_t seconds, std::vector<scheduled_position_t>& out) const;
+  size_t positions_at(time_t now, std::vector<scheduled_position_t>& out) const;
+
+private:
+  const gtfs_t* gtfs;
+  const service_calendar_t* calendar;
+  std::vector<int32_t> trip_start; //first departure, -1 for trips without stop times
+  std::vector<int32_t> trip_end; //last arrival
+  std::vector<uint32_t> minute_offsets; //active trips of minute m are [minute_offsets[m], minute_offsets[m + 1])
+  std::vector<uint32_t> minute_trips;
+  bool locate(uint32_t trip, int32_t seconds, scheduled_position_t& pos) const;
+};
+
+#endif
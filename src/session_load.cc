@@ -0,0 +1,1401 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include "asio.hpp"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "http_cache.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// session_load
+// opens headless map sessions against a running wmata, the way a browser does, and measures what
+// they cost the server:
+//   GET /                             Wt bootstrap page, gives the session id (wtd) and script id
+//   GET /?wtd=..&request=script&..    creates ApplicationMap and returns the initial render
+//   POST /?wtd=.. request=jsupdate&signal=poll
+//                                     long poll, answered by Wt when the publisher pushes an update
+// or, with --websocket, the transport Wt.js prefers when the server has web sockets on:
+//   GET /?wtd=..&request=ws           WebSocket upgrade on a connection of its own; Wt sends
+//                                     "connect", then every update as a text message, and answers
+//                                     the keep-alive "&signal=ping" with "{}"
+// sessions are added in steps; after each step every session keeps polling for the hold time, and
+// the step reports server RSS per session, server CPU per published update, and the latency from
+// the render of an update (window.last_update.time) to its arrival at each session
+// the ramp stops at the first step that saturates: a session that cannot open or loses its poll,
+// updates that do not reach every session, or p99 latency above --max-p99
+// with --budget-kb it exits 1 when a step costs more than that per session
+// the server must run on this host (same clock, /proc of --pid), with web sockets off for the long
+// poll, or on (<web-sockets>true</web-sockets> in wt_config.xml) for --websocket
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage()
+{
+  std::cout << "usage: session_load --pid wmata_pid [--host 127.0.0.1] [--port 8080] [--sessions 1000] [--step 100]" << std::endl;
+  std::cout << "                    [--hold seconds] [--max-p99 ms] [--budget-kb kb] [--parallel n] [--threads n]" << std::endl;
+  std::cout << "                    [--websocket] [--keep-alive seconds]" << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_options_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct load_options_t
+{
+  std::string host = "127.0.0.1";
+  std::string port = "8080";
+  int pid = 0; //wmata process, for RSS and CPU; 0 reports latency only
+  size_t sessions = 1000;
+  size_t step = 100;
+  std::chrono::seconds hold = std::chrono::seconds(60);
+  double max_p99 = 2000; //ms
+  double budget_kb = 0; //per session, 0 for none
+  size_t parallel = 16; //sessions opening at the same time
+  size_t threads = 2;
+  std::chrono::seconds timeout = std::chrono::seconds(120); //per request; above Wt's server push timeout
+  bool websocket = false; //updates over a WebSocket instead of the long poll
+  std::chrono::seconds keep_alive = std::chrono::seconds(30); //WebSocket "&signal=ping" interval
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// process_rss_kb
+// VmRSS of a process, -1 if it cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long process_rss_kb(int pid)
+{
+  std::ifstream ifs("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+    {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// process_cpu_ms
+// user + system CPU time of a process, -1 if it cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double process_cpu_ms(int pid)
+{
+  std::ifstream ifs("/proc/" + std::to_string(pid) + "/stat");
+  std::string stat;
+  std::getline(ifs, stat);
+  //the command name is in parentheses and may hold spaces; fields 14 and 15 follow it
+  size_t pos = stat.rfind(')');
+  if (pos == std::string::npos)
+  {
+    return -1;
+  }
+  std::istringstream fields(stat.substr(pos + 2));
+  std::string field;
+  double ticks = 0;
+  for (int idx = 3; idx <= 15 && fields >> field; ++idx)
+  {
+    if (idx >= 14)
+    {
+      ticks += std::atof(field.c_str());
+    }
+  }
+  return ticks * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// number_after
+// digits that follow key in text, searched from the end when last is set; skips up to 8 quote,
+// plus or space characters, as in '&sid=' + '1234'; -1 if not found
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long number_after(const std::string& text, const std::string& key, bool last)
+{
+  size_t pos = last ? text.rfind(key) : text.find(key);
+  if (pos == std::string::npos)
+  {
+    return -1;
+  }
+  pos += key.size();
+  for (int skip = 0; skip < 8 && pos < text.size() && std::strchr("'\"+ ", text[pos]); ++skip)
+  {
+    ++pos;
+  }
+  if (pos >= text.size() || !std::isdigit(static_cast<unsigned char>(text[pos])))
+  {
+    return -1;
+  }
+  return std::atoll(text.c_str() + pos);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// token_after
+// [A-Za-z0-9_-] characters that follow key in text
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string token_after(const std::string& text, const std::string& key)
+{
+  size_t pos = text.find(key);
+  if (pos == std::string::npos)
+  {
+    return "";
+  }
+  pos += key.size();
+  size_t end = pos;
+  while (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_' || text[end] == '-'))
+  {
+    ++end;
+  }
+  return text.substr(pos, end - pos);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// base64
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string base64(const unsigned char* data, size_t size)
+{
+  std::string out(4 * ((size + 2) / 3) + 1, '\0');
+  int len = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(&out[0]), data, static_cast<int>(size));
+  out.resize(len > 0 ? static_cast<size_t>(len) : 0);
+  return out;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// websocket_accept
+// the Sec-WebSocket-Accept a server must answer to key (RFC 6455 4.2.2)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string websocket_accept(const std::string& key)
+{
+  std::string text = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int size = 0;
+  if (EVP_Digest(text.data(), text.size(), digest, &size, EVP_sha1(), nullptr) != 1)
+  {
+    return "";
+  }
+  return base64(digest, size);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// percentile
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double percentile(std::vector<double> values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  size_t idx = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + idx, values.end());
+  return values[idx];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t
+// state shared by all sessions; the io_context runs on several threads, each session is a single
+// chain of handlers, and everything here is under mutex
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct load_session_t;
+
+struct load_run_t
+{
+  load_run_t(const load_options_t& options_) :
+    options(options_),
+    work(asio::make_work_guard(io)),
+    next(0),
+    booting(0),
+    opened(0),
+    open_failed(0),
+    lost(0)
+  {
+  }
+  load_options_t options;
+  asio::io_context io;
+  asio::executor_work_guard<asio::io_context::executor_type> work;
+  asio::ip::tcp::resolver::results_type endpoints;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::shared_ptr<load_session_t>> sessions;
+  size_t next; //first session not started
+  size_t booting;
+  size_t opened;
+  size_t open_failed;
+  size_t lost; //sessions whose poll failed after they opened
+  std::vector<double> boot_ms;
+  std::vector<double> boot_kb;
+  //measurement window of a step
+  std::vector<double> latency_ms;
+  std::map<uint64_t, std::pair<int64_t, size_t>> versions; //version: render time, deliveries
+  std::string first_error;
+
+  void open(size_t count);
+  void start_next();
+  void booted(bool ok, double ms, size_t bytes, const std::string& error);
+  void delivered(uint64_t version, int64_t time, double ms);
+  void poll_failed(const std::string& error);
+  void reset_window();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t
+// one headless browser tab: a keep-alive connection, the Wt session id and the ids Wt expects
+// back on each update request (pageId, ackId)
+// the socket and timers run their handlers on one strand: a WebSocket session reads frames while
+// its keep-alive timer writes pings
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct load_session_t : public std::enable_shared_from_this<load_session_t>
+{
+  load_session_t(load_run_t& run_) :
+    run(run_),
+    strand(asio::make_strand(run_.io)),
+    sock(strand),
+    timer(strand),
+    ping_timer(strand),
+    connected(false),
+    status(0),
+    close(false),
+    content_length(-1),
+    chunked(false),
+    bytes(0),
+    page_id(0),
+    ack_id(-1),
+    version(0),
+    ws_open(false),
+    ws_closed(false),
+    writing(false)
+  {
+  }
+  load_run_t& run;
+  asio::strand<asio::io_context::executor_type> strand;
+  asio::ip::tcp::socket sock;
+  asio::steady_timer timer;
+  asio::steady_timer ping_timer;
+  asio::streambuf sbuf;
+  std::string request;
+  bool connected;
+  int status;
+  bool close;
+  long long content_length;
+  bool chunked;
+  std::string body;
+  size_t bytes; //received while opening
+  std::map<std::string, std::string> cookies;
+  std::string session_id;
+  long long page_id;
+  long long ack_id;
+  uint64_t version; //last update received
+  std::chrono::steady_clock::time_point start_time;
+  std::function<void(const std::string&)> done; //error, empty on success
+  //WebSocket
+  std::string ws_accept; //expected Sec-WebSocket-Accept
+  bool ws_open; //"connect" received
+  bool ws_closed;
+  std::string message; //text of a fragmented message so far
+  std::deque<std::string> outbox; //frames to write, the front one being written
+  bool writing;
+
+  void start();
+  void bootstrap();
+  void script(long long script_id);
+  void poll();
+  std::string cookie_header() const;
+  void upgrade();
+  void read_frame();
+  void take_message();
+  void send_frame(int opcode, const std::string& payload);
+  void write_frame();
+  void keep_alive();
+  void ws_failed(const std::string& error);
+  void send(const std::string& method, const std::string& target, const std::string& form,
+    const std::function<void(const std::string&)>& handler);
+  void connect();
+  void write();
+  void read_header();
+  void read_body();
+  void read_chunk();
+  void finish(const std::string& error);
+  bool take_update(bool push);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::start()
+{
+  start_time = std::chrono::steady_clock::now();
+  bootstrap();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::bootstrap
+// the boot page carries the session id in its self URL (?wtd=) and the script id (sid) that the
+// script request must echo
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::bootstrap()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  send("GET", "/", "", [self](const std::string& error)
+    {
+      std::string fail = error;
+      long long script_id = -1;
+      if (fail.empty())
+      {
+        self->session_id = token_after(self->body, "wtd=");
+        script_id = number_after(self->body, "sid=", false);
+        if (self->status != 200 || self->session_id.empty() || script_id < 0)
+        {
+          fail = "bootstrap: HTTP " + std::to_string(self->status) + ", no session id or script id in the boot page";
+        }
+      }
+      if (!fail.empty())
+      {
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - self->start_time;
+        self->run.booted(false, ms.count(), self->bytes, fail);
+        return;
+      }
+      self->script(script_id);
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::script
+// the parameters Boot.js sends with the script request; this request creates the application
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::script(long long script_id)
+{
+  std::stringstream target;
+  target << "/?wtd=" << session_id << "&request=script&sid=" << script_id
+    << "&htmlHistory=true&deployPath=%2F&js=1&ajax=1&scrW=1920&scrH=1080&dpr=1&tz=0&tzS=UTC&rand=" << std::rand();
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  send("GET", target.str(), "", [self](const std::string& error)
+    {
+      std::string fail = error;
+      if (fail.empty() && self->status != 200)
+      {
+        fail = "script: HTTP " + std::to_string(self->status);
+      }
+      if (fail.empty())
+      {
+        long long page = number_after(self->body, "setPage(", true);
+        if (page >= 0)
+        {
+          self->page_id = page;
+        }
+        self->take_update(false);
+      }
+      //a WebSocket session is open once Wt has said "connect" on it
+      if (fail.empty() && self->run.options.websocket)
+      {
+        self->upgrade();
+        return;
+      }
+      std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - self->start_time;
+      self->run.booted(fail.empty(), ms.count(), self->bytes, fail);
+      if (fail.empty())
+      {
+        self->poll();
+      }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::poll
+// one long poll, renewed as soon as it is answered; ackId acknowledges the last response so Wt
+// does not resend it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::poll()
+{
+  std::stringstream form;
+  form << "request=jsupdate&signal=poll&pageId=" << page_id;
+  if (ack_id >= 0)
+  {
+    form << "&ackId=" << ack_id;
+  }
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  send("POST", "/?wtd=" + session_id, form.str(), [self](const std::string& error)
+    {
+      if (!error.empty() || self->status != 200)
+      {
+        self->run.poll_failed(error.empty() ? "poll: HTTP " + std::to_string(self->status) : error);
+        return;
+      }
+      self->take_update(true);
+      self->poll();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::take_update
+// picks the ack id and, when the response carries a train update, its version and render time
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool load_session_t::take_update(bool push)
+{
+  long long ack = number_after(body, "response(", true);
+  if (ack >= 0)
+  {
+    ack_id = ack;
+  }
+  size_t pos = body.rfind("window.last_update = {");
+  if (pos == std::string::npos)
+  {
+    return false;
+  }
+  std::string last_update = body.substr(pos, body.find('}', pos) - pos);
+  long long update_version = number_after(last_update, "\"version\":", false);
+  long long update_time = number_after(last_update, "\"time\":", false);
+  if (update_version < 0 || update_time < 0 || static_cast<uint64_t>(update_version) == version)
+  {
+    return false;
+  }
+  version = static_cast<uint64_t>(update_version);
+  if (push)
+  {
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    run.delivered(version, update_time, static_cast<double>(now - update_time));
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::cookie_header
+// the cookies Wt set so far, as a Cookie: header line; empty if none
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string load_session_t::cookie_header() const
+{
+  if (cookies.empty())
+  {
+    return "";
+  }
+  std::string header = "Cookie: ";
+  for (std::map<std::string, std::string>::const_iterator it = cookies.begin(); it != cookies.end(); ++it)
+  {
+    header += (it == cookies.begin() ? "" : "; ") + it->first + "=" + it->second;
+  }
+  return header + "\r\n";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::upgrade
+// the WebSocket Wt.js opens once the application has loaded, on a new connection, as a browser does
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::upgrade()
+{
+  unsigned char nonce[16];
+  if (RAND_bytes(nonce, sizeof(nonce)) != 1)
+  {
+    ws_failed("websocket: no random bytes for the key");
+    return;
+  }
+  std::string key = base64(nonce, sizeof(nonce));
+  ws_accept = websocket_accept(key);
+
+  std::stringstream http;
+  http << "GET /?wtd=" << session_id << "&request=ws HTTP/1.1\r\n";
+  http << "Host: " << run.options.host << ":" << run.options.port << "\r\n";
+  http << "User-Agent: Mozilla/5.0 (X11; Linux x86_64) session_load\r\n";
+  http << "Origin: http://" << run.options.host << ":" << run.options.port << "\r\n";
+  http << "Upgrade: websocket\r\n";
+  http << "Connection: Upgrade\r\n";
+  http << "Sec-WebSocket-Key: " << key << "\r\n";
+  http << "Sec-WebSocket-Version: 13\r\n";
+  http << cookie_header();
+  http << "\r\n";
+  request = http.str();
+
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  timer.expires_after(run.options.timeout);
+  timer.async_wait([self](const asio::error_code& ec)
+    {
+      if (!ec)
+      {
+        asio::error_code ignored;
+        self->sock.close(ignored);
+      }
+    });
+
+  asio::error_code ignored;
+  sock.close(ignored);
+  connected = false;
+  sbuf.consume(sbuf.size());
+  asio::async_connect(sock, run.endpoints, [self](const asio::error_code& ec, const asio::ip::tcp::endpoint&)
+    {
+      if (ec)
+      {
+        self->ws_failed("websocket connect: " + ec.message());
+        return;
+      }
+      asio::error_code ignored;
+      self->sock.set_option(asio::ip::tcp::no_delay(true), ignored);
+      asio::async_write(self->sock, asio::buffer(self->request), [self](const asio::error_code& ec, size_t)
+        {
+          if (ec)
+          {
+            self->ws_failed("websocket write: " + ec.message());
+            return;
+          }
+          asio::async_read_until(self->sock, self->sbuf, "\r\n\r\n", [self](const asio::error_code& ec, size_t header_size)
+            {
+              if (ec)
+              {
+                self->ws_failed("websocket handshake: " + ec.message());
+                return;
+              }
+              self->bytes += header_size;
+              std::string text(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + header_size);
+              self->sbuf.consume(header_size);
+              std::vector<std::string> header;
+              std::istringstream lines(text);
+              std::string line;
+              while (std::getline(lines, line) && line != "\r")
+              {
+                header.push_back(line);
+              }
+              int status = http_status(header);
+              if (status != 101)
+              {
+                self->ws_failed("websocket handshake: HTTP " + std::to_string(status) + ", are web sockets on in wt_config.xml?");
+                return;
+              }
+              if (http_header_value(header, "Sec-WebSocket-Accept") != self->ws_accept)
+              {
+                self->ws_failed("websocket handshake: wrong Sec-WebSocket-Accept");
+                return;
+              }
+              self->read_frame();
+            });
+        });
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::read_frame
+// a frame is 2 header bytes, 2 or 8 more for a longer payload, a 4 byte mask key when masked (never
+// from a server), then the payload; reads until a whole frame is buffered, then handles it
+// any frame restarts the inactivity timer, which keep-alive answers feed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::read_frame()
+{
+  const size_t have = sbuf.size();
+  unsigned char head[14];
+  size_t head_size = std::min<size_t>(have, sizeof(head));
+  asio::buffer_copy(asio::buffer(head, head_size), sbuf.data());
+
+  size_t need = 2;
+  size_t header = 0;
+  uint64_t payload = 0;
+  if (head_size >= 2)
+  {
+    payload = head[1] & 0x7f;
+    header = payload == 126 ? 4 : payload == 127 ? 10 : 2;
+    bool masked = (head[1] & 0x80) != 0;
+    need = header + (masked ? 4 : 0);
+    if (head_size >= header)
+    {
+      if (payload == 126)
+      {
+        payload = (static_cast<uint64_t>(head[2]) << 8) | head[3];
+      }
+      else if (payload == 127)
+      {
+        payload = 0;
+        for (size_t idx = 2; idx < 10; ++idx)
+        {
+          payload = (payload << 8) | head[idx];
+        }
+      }
+      if (payload > 64 * 1024 * 1024)
+      {
+        ws_failed("websocket: frame of " + std::to_string(payload) + " bytes");
+        return;
+      }
+      need += static_cast<size_t>(payload);
+    }
+  }
+
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  if (have < need || head_size < header)
+  {
+    size_t more = have < need ? need - have : 1;
+    asio::async_read(sock, sbuf, asio::transfer_at_least(more), [self](const asio::error_code& ec, size_t)
+      {
+        if (ec)
+        {
+          self->ws_failed(ec == asio::error::eof ? "websocket: closed by the server" : "websocket read: " + ec.message());
+          return;
+        }
+        self->read_frame();
+      });
+    return;
+  }
+
+  bool fin = (head[0] & 0x80) != 0;
+  int opcode = head[0] & 0x0f;
+  bool masked = (head[1] & 0x80) != 0;
+  size_t offset = header + (masked ? 4 : 0);
+  std::string data(static_cast<size_t>(payload), '\0');
+  asio::buffer_copy(asio::buffer(&data[0], data.size()), sbuf.data() + offset);
+  if (masked)
+  {
+    for (size_t idx = 0; idx < data.size(); ++idx)
+    {
+      data[idx] ^= head[header + idx % 4];
+    }
+  }
+  sbuf.consume(need);
+  bytes += need;
+
+  timer.expires_after(run.options.timeout);
+  timer.async_wait([self](const asio::error_code& ec)
+    {
+      if (!ec)
+      {
+        self->ws_failed("websocket: nothing received for " + std::to_string(self->run.options.timeout.count()) + " s");
+      }
+    });
+
+  if (opcode == 0x8)
+  {
+    ws_failed("websocket: closed by the server");
+    return;
+  }
+  if (opcode == 0x9)
+  {
+    send_frame(0xA, data);
+  }
+  else if (opcode == 0x0 || opcode == 0x1 || opcode == 0x2)
+  {
+    message += data;
+    if (fin)
+    {
+      take_message();
+      if (ws_closed)
+      {
+        return;
+      }
+    }
+  }
+  read_frame();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::take_message
+// "connect" opens the session, "{}" answers a keep-alive, anything else is a JavaScript update
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::take_message()
+{
+  std::string text;
+  text.swap(message);
+  if (!ws_open)
+  {
+    if (text != "connect")
+    {
+      ws_failed("websocket: expected connect, got " + text.substr(0, 40));
+      return;
+    }
+    ws_open = true;
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start_time;
+    run.booted(true, ms.count(), bytes, "");
+    keep_alive();
+    return;
+  }
+  if (text == "{}")
+  {
+    return;
+  }
+  body.swap(text);
+  take_update(true);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::send_frame
+// a client frame is always masked (RFC 6455 5.3)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::send_frame(int opcode, const std::string& payload)
+{
+  std::string frame;
+  frame.reserve(payload.size() + 14);
+  frame += static_cast<char>(0x80 | opcode);
+  if (payload.size() < 126)
+  {
+    frame += static_cast<char>(0x80 | payload.size());
+  }
+  else if (payload.size() < 65536)
+  {
+    frame += static_cast<char>(0x80 | 126);
+    frame += static_cast<char>(payload.size() >> 8);
+    frame += static_cast<char>(payload.size() & 0xff);
+  }
+  else
+  {
+    frame += static_cast<char>(0x80 | 127);
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      frame += static_cast<char>((static_cast<uint64_t>(payload.size()) >> shift) & 0xff);
+    }
+  }
+  unsigned char mask[4] = { 0, 0, 0, 0 };
+  RAND_bytes(mask, sizeof(mask));
+  frame.append(reinterpret_cast<const char*>(mask), sizeof(mask));
+  for (size_t idx = 0; idx < payload.size(); ++idx)
+  {
+    frame += static_cast<char>(payload[idx] ^ mask[idx % 4]);
+  }
+
+  outbox.push_back(frame);
+  if (!writing)
+  {
+    write_frame();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::write_frame
+// one write at a time, in the order the frames were sent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::write_frame()
+{
+  writing = true;
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  asio::async_write(sock, asio::buffer(outbox.front()), [self](const asio::error_code& ec, size_t)
+    {
+      self->outbox.pop_front();
+      if (ec)
+      {
+        self->writing = false;
+        self->ws_failed("websocket write: " + ec.message());
+        return;
+      }
+      if (self->outbox.empty())
+      {
+        self->writing = false;
+        return;
+      }
+      self->write_frame();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::keep_alive
+// the ping Wt.js sends on an open WebSocket; Wt answers "{}"
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::keep_alive()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  ping_timer.expires_after(run.options.keep_alive);
+  ping_timer.async_wait([self](const asio::error_code& ec)
+    {
+      if (ec || self->ws_closed)
+      {
+        return;
+      }
+      self->send_frame(0x1, "&signal=ping");
+      self->keep_alive();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::ws_failed
+// reported once: as a failed open before "connect", as a lost session after
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::ws_failed(const std::string& error)
+{
+  if (ws_closed)
+  {
+    return;
+  }
+  ws_closed = true;
+  timer.cancel();
+  ping_timer.cancel();
+  asio::error_code ignored;
+  sock.close(ignored);
+  if (ws_open)
+  {
+    run.poll_failed(error);
+    return;
+  }
+  std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start_time;
+  run.booted(false, ms.count(), bytes, error);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::send
+// one request on the keep-alive connection, reconnecting first if the server closed it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::send(const std::string& method, const std::string& target, const std::string& form,
+  const std::function<void(const std::string&)>& handler)
+{
+  std::stringstream http;
+  http << method << " " << target << " HTTP/1.1\r\n";
+  http << "Host: " << run.options.host << ":" << run.options.port << "\r\n";
+  http << "User-Agent: Mozilla/5.0 (X11; Linux x86_64) session_load\r\n";
+  http << "Accept: */*\r\n";
+  http << cookie_header();
+  if (method == "POST")
+  {
+    http << "Content-Type: application/x-www-form-urlencoded\r\n";
+    http << "Content-Length: " << form.size() << "\r\n";
+  }
+  http << "\r\n" << form;
+  request = http.str();
+  done = handler;
+  body.clear();
+
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  timer.expires_after(run.options.timeout);
+  timer.async_wait([self](const asio::error_code& ec)
+    {
+      if (!ec)
+      {
+        asio::error_code ignored;
+        self->sock.close(ignored);
+      }
+    });
+  if (connected)
+  {
+    write();
+  }
+  else
+  {
+    connect();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::connect
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::connect()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  asio::error_code ignored;
+  sock.close(ignored);
+  sbuf.consume(sbuf.size());
+  asio::async_connect(sock, run.endpoints, [self](const asio::error_code& ec, const asio::ip::tcp::endpoint&)
+    {
+      if (ec)
+      {
+        self->finish("connect: " + ec.message());
+        return;
+      }
+      asio::error_code ignored;
+      self->sock.set_option(asio::ip::tcp::no_delay(true), ignored);
+      self->connected = true;
+      self->write();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::write
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::write()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  asio::async_write(sock, asio::buffer(request), [self](const asio::error_code& ec, size_t)
+    {
+      if (ec)
+      {
+        self->finish("write: " + ec.message());
+        return;
+      }
+      self->read_header();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::read_header
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::read_header()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  asio::async_read_until(sock, sbuf, "\r\n\r\n", [self](const asio::error_code& ec, size_t header_size)
+    {
+      if (ec)
+      {
+        self->finish("headers: " + ec.message());
+        return;
+      }
+      self->bytes += header_size;
+      std::string text(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + header_size);
+      self->sbuf.consume(header_size);
+      std::vector<std::string> header;
+      std::istringstream lines(text);
+      std::string line;
+      while (std::getline(lines, line) && line != "\r")
+      {
+        header.push_back(line);
+        //Set-Cookie: name=value; attributes
+        if (line.size() > 11 && strncasecmp(line.c_str(), "Set-Cookie:", 11) == 0)
+        {
+          std::string cookie = line.substr(11, line.find(';') - 11);
+          size_t first = cookie.find_first_not_of(' ');
+          size_t equal = cookie.find('=');
+          if (first != std::string::npos && equal != std::string::npos && equal > first)
+          {
+            self->cookies[cookie.substr(first, equal - first)] = cookie.substr(equal + 1);
+          }
+        }
+      }
+
+      self->status = http_status(header);
+      std::string connection = http_header_value(header, "Connection");
+      self->close = connection.find("close") != std::string::npos || header.empty() || header[0].find("HTTP/1.0") != std::string::npos;
+      std::string length = http_header_value(header, "Content-Length");
+      self->content_length = length.empty() ? -1 : std::atoll(length.c_str());
+      self->chunked = http_header_value(header, "Transfer-Encoding").find("chunked") != std::string::npos;
+      if (self->chunked)
+      {
+        self->read_chunk();
+      }
+      else
+      {
+        self->read_body();
+      }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::read_body
+// Content-Length, or until the server closes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::read_body()
+{
+  size_t have = sbuf.size();
+  if (content_length >= 0 && have >= static_cast<size_t>(content_length))
+  {
+    body.assign(asio::buffers_begin(sbuf.data()), asio::buffers_begin(sbuf.data()) + content_length);
+    sbuf.consume(static_cast<size_t>(content_length));
+    bytes += static_cast<size_t>(content_length);
+    finish("");
+    return;
+  }
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  size_t want = content_length >= 0 ? static_cast<size_t>(content_length) - have : 65536;
+  asio::async_read(sock, sbuf, asio::transfer_at_least(std::min<size_t>(want, 65536)), [self](const asio::error_code& ec, size_t)
+    {
+      if (ec == asio::error::eof && self->content_length < 0)
+      {
+        self->body.assign(asio::buffers_begin(self->sbuf.data()), asio::buffers_end(self->sbuf.data()));
+        self->bytes += self->body.size();
+        self->sbuf.consume(self->sbuf.size());
+        self->close = true;
+        self->finish("");
+        return;
+      }
+      if (ec)
+      {
+        self->finish("body: " + ec.message());
+        return;
+      }
+      self->read_body();
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::read_chunk
+// size line, data and CRLF, until the zero size chunk; trailers are not expected
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::read_chunk()
+{
+  std::shared_ptr<load_session_t> self = shared_from_this();
+  asio::async_read_until(sock, sbuf, "\r\n", [self](const asio::error_code& ec, size_t line_size)
+    {
+      if (ec)
+      {
+        self->finish("chunk: " + ec.message());
+        return;
+      }
+      std::string line(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + line_size);
+      self->sbuf.consume(line_size);
+      size_t size = std::strtoul(line.c_str(), nullptr, 16);
+      //data plus its CRLF; the last chunk is followed by an empty line
+      size_t need = size + 2;
+      size_t have = self->sbuf.size();
+      asio::async_read(self->sock, self->sbuf, asio::transfer_exactly(have >= need ? 0 : need - have),
+        [self, size](const asio::error_code& ec, size_t)
+        {
+          if (ec)
+          {
+            self->finish("chunk: " + ec.message());
+            return;
+          }
+          self->body.append(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + size);
+          self->sbuf.consume(size + 2);
+          self->bytes += size;
+          if (size == 0)
+          {
+            self->finish("");
+            return;
+          }
+          self->read_chunk();
+        });
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_session_t::finish
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_session_t::finish(const std::string& error)
+{
+  timer.cancel();
+  if (!error.empty() || close)
+  {
+    asio::error_code ignored;
+    sock.close(ignored);
+    connected = false;
+  }
+  std::function<void(const std::string&)> handler;
+  handler.swap(done);
+  handler(error);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::open
+// starts count more sessions, at most options.parallel opening at a time, and waits until they
+// are all open or failed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::open(size_t count)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  size_t target = sessions.size() + count;
+  while (sessions.size() < target)
+  {
+    sessions.push_back(std::make_shared<load_session_t>(*this));
+  }
+  while (booting < options.parallel && next < sessions.size())
+  {
+    start_next();
+  }
+  cv.wait(lock, [this, target]() { return opened + open_failed >= target; });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::start_next
+// called under mutex
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::start_next()
+{
+  std::shared_ptr<load_session_t> session = sessions[next++];
+  ++booting;
+  asio::post(io, [session]() { session->start(); });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::booted
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::booted(bool ok, double ms, size_t bytes, const std::string& error)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  --booting;
+  if (ok)
+  {
+    ++opened;
+    boot_ms.push_back(ms);
+    boot_kb.push_back(bytes / 1024.0);
+  }
+  else
+  {
+    ++open_failed;
+    if (first_error.empty())
+    {
+      first_error = error;
+    }
+  }
+  if (next < sessions.size())
+  {
+    start_next();
+  }
+  cv.notify_all();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::delivered
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::delivered(uint64_t version, int64_t time, double ms)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::pair<int64_t, size_t>& seen = versions[version];
+  seen.first = time;
+  ++seen.second;
+  latency_ms.push_back(ms);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::poll_failed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::poll_failed(const std::string& error)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ++lost;
+  if (first_error.empty())
+  {
+    first_error = error;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_run_t::reset_window
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_run_t::reset_window()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  latency_ms.clear();
+  versions.clear();
+  boot_ms.clear();
+  boot_kb.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  load_options_t options;
+  for (int idx = 1; idx < argc; ++idx)
+  {
+    std::string arg = argv[idx];
+    bool has_value = idx + 1 < argc;
+    if (arg == "--pid" && has_value)
+    {
+      options.pid = std::atoi(argv[++idx]);
+    }
+    else if (arg == "--host" && has_value)
+    {
+      options.host = argv[++idx];
+    }
+    else if (arg == "--port" && has_value)
+    {
+      options.port = argv[++idx];
+    }
+    else if (arg == "--sessions" && has_value)
+    {
+      options.sessions = static_cast<size_t>(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--step" && has_value)
+    {
+      options.step = static_cast<size_t>(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--hold" && has_value)
+    {
+      options.hold = std::chrono::seconds(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--max-p99" && has_value)
+    {
+      options.max_p99 = std::atof(argv[++idx]);
+    }
+    else if (arg == "--budget-kb" && has_value)
+    {
+      options.budget_kb = std::atof(argv[++idx]);
+    }
+    else if (arg == "--parallel" && has_value)
+    {
+      options.parallel = static_cast<size_t>(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--threads" && has_value)
+    {
+      options.threads = static_cast<size_t>(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--websocket")
+    {
+      options.websocket = true;
+    }
+    else if (arg == "--keep-alive" && has_value)
+    {
+      options.keep_alive = std::chrono::seconds(std::max(1, std::atoi(argv[++idx])));
+    }
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  load_run_t run(options);
+  try
+  {
+    asio::ip::tcp::resolver resolver(run.io);
+    run.endpoints = resolver.resolve(options.host, options.port);
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << "cannot resolve " << options.host << ":" << options.port << ": " << e.what() << std::endl;
+    return 1;
+  }
+  std::vector<std::thread> threads;
+  for (size_t idx = 0; idx < options.threads; ++idx)
+  {
+    threads.push_back(std::thread([&run]() { run.io.run(); }));
+  }
+
+  long base_rss_kb = options.pid ? process_rss_kb(options.pid) : -1;
+  if (options.pid && base_rss_kb < 0)
+  {
+    std::cout << "cannot read /proc/" << options.pid << "; RSS and CPU are not reported" << std::endl;
+  }
+  std::cout << "wmata at " << options.host << ":" << options.port << (options.websocket ? ", WebSocket" : ", long poll");
+  if (base_rss_kb >= 0)
+  {
+    std::cout << ", RSS before sessions " << base_rss_kb << " kB";
+  }
+  std::cout << std::endl;
+  std::cout << std::setw(9) << "sessions" << std::setw(8) << "failed"
+    << std::setw(10) << "open ms" << std::setw(10) << "open kB"
+    << std::setw(10) << "RSS MB" << std::setw(12) << "kB/session"
+    << std::setw(9) << "updates" << std::setw(12) << "CPU ms/upd"
+    << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::endl;
+
+  std::string saturated;
+  bool over_budget = false;
+  size_t open_sessions = 0;
+  while (open_sessions < options.sessions && saturated.empty())
+  {
+    size_t count = std::min(options.step, options.sessions - open_sessions);
+    run.reset_window();
+    run.open(count);
+    open_sessions += count;
+    std::vector<double> boot_ms;
+    std::vector<double> boot_kb;
+    {
+      std::lock_guard<std::mutex> lock(run.mutex);
+      boot_ms.swap(run.boot_ms);
+      boot_kb.swap(run.boot_kb);
+    }
+
+    //steady state: every session polls, or listens on its WebSocket, for the hold time
+    run.reset_window();
+    int64_t window_start = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    double cpu_start = options.pid ? process_cpu_ms(options.pid) : -1;
+    std::this_thread::sleep_for(options.hold);
+    double cpu_end = options.pid ? process_cpu_ms(options.pid) : -1;
+    long rss_kb = options.pid ? process_rss_kb(options.pid) : -1;
+    int64_t window_end = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<double> latency_ms;
+    size_t nbr_versions = 0; //rendered in the window
+    size_t nbr_settled = 0; //rendered early enough to have reached every session by its end
+    size_t deliveries = 0; //of the settled ones
+    size_t live = 0;
+    size_t open_failed = 0;
+    std::string first_error;
+    {
+      std::lock_guard<std::mutex> lock(run.mutex);
+      latency_ms = run.latency_ms;
+      for (std::map<uint64_t, std::pair<int64_t, size_t>>::const_iterator it = run.versions.begin(); it != run.versions.end(); ++it)
+      {
+        if (it->second.first < window_start || it->second.first > window_end)
+        {
+          continue;
+        }
+        ++nbr_versions;
+        if (it->second.first <= window_end - static_cast<int64_t>(options.max_p99))
+        {
+          ++nbr_settled;
+          deliveries += it->second.second;
+        }
+      }
+      live = run.opened - run.lost;
+      open_failed = run.open_failed;
+      first_error = run.first_error;
+    }
+
+    double kb_per_session = rss_kb >= 0 && base_rss_kb >= 0 && live ? (rss_kb - base_rss_kb) / static_cast<double>(live) : 0;
+    double cpu_per_update = cpu_start >= 0 && cpu_end >= 0 && nbr_versions ? (cpu_end - cpu_start) / nbr_versions : 0;
+    double p50 = percentile(latency_ms, 0.5);
+    double p99 = percentile(latency_ms, 0.99);
+    std::cout << std::fixed << std::setprecision(1)
+      << std::setw(9) << open_sessions << std::setw(8) << open_failed + run.lost
+      << std::setw(10) << percentile(boot_ms, 0.5) << std::setw(10) << percentile(boot_kb, 0.5)
+      << std::setw(10) << (rss_kb >= 0 ? rss_kb / 1024.0 : 0) << std::setw(12) << kb_per_session
+      << std::setw(9) << nbr_versions << std::setw(12) << cpu_per_update
+      << std::setw(10) << p50 << std::setw(10) << p99 << std::endl;
+
+    if (open_failed + run.lost > 0)
+    {
+      saturated = "sessions failed: " + first_error;
+    }
+    else if (nbr_versions == 0)
+    {
+      saturated = options.websocket ? "no update arrived during the hold; is the server publishing?" :
+        "no update arrived during the hold; is the server publishing, with web sockets off?";
+    }
+    else if (deliveries < nbr_settled * live * 99 / 100)
+    {
+      saturated = std::to_string(deliveries) + " deliveries for " + std::to_string(nbr_settled) + " updates to " + std::to_string(live) + " sessions";
+    }
+    else if (p99 > options.max_p99)
+    {
+      saturated = "p99 latency above " + std::to_string(static_cast<int>(options.max_p99)) + " ms";
+    }
+    if (options.budget_kb > 0 && kb_per_session > options.budget_kb)
+    {
+      over_budget = true;
+    }
+  }
+
+  if (saturated.empty())
+  {
+    std::cout << "not saturated at " << open_sessions << " sessions" << std::endl;
+  }
+  else
+  {
+    std::cout << "saturated at " << open_sessions << " sessions: " << saturated << std::endl;
+  }
+  if (over_budget)
+  {
+    std::cout << "over the budget of " << options.budget_kb << " kB per session" << std::endl;
+  }
+
+  run.work.reset();
+  run.io.stop();
+  for (size_t idx = 0; idx < threads.size(); ++idx)
+  {
+    threads[idx].join();
+  }
+  return over_budget ? 1 : 0;
+}
@@ -17,6 +17,18 @@
 int ssl_read(const std::string& host, const std::string& port_num, const std::string& http, std::string& response)
 {
   std::vector<std::string> header;
+  return ssl_read(host, port_num, http, response, header);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//ssl_read
+//also returns the response header lines, status line first
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int ssl_read(const std::string& host, const std::string& port_num, const std::string& http, std::string& response,
+  std::vector<std::string>& header)
+{
+  header.clear();
 
   std::stringstream ss;
   try
@@ -5,5 +5,7 @@
 #include <vector>
 
 int ssl_read(const std::string& host, const std::string& port_num, const std::string& http, std::string& response);
+int ssl_read(const std::string& host, const std::string& port_num, const std::string& http, std::string& response,
+  std::vector<std::string>& header);
 
 #endif
@@ -0,0 +1,173 @@
+#include <cstdlib>
+#include <Wt/Http/ResponseContinuation.h>
+#include "stream.hh"
+#include "plan.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// stream_state_t
+// what one subscriber has been sent, kept as the data of its continuation
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct stream_state_t
+{
+  uint64_t version; //of the last event sent, 0 for none
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// stream_frame
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string stream_frame(uint64_t version, const std::string& json)
+{
+  std::string frame;
+  frame.reserve(json.size() + 48);
+  frame += "id: " + std::to_string(version) + "\nevent: trains\ndata: ";
+  frame += json; //one line, generate_train escapes any newline in the WMATA strings
+  frame += "\n\n";
+  return frame;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamResource::StreamResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+StreamResource::StreamResource(size_t ring_size_) :
+  ring_size(ring_size_ ? ring_size_ : 1)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamResource::~StreamResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+StreamResource::~StreamResource()
+{
+  beingDeleted();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamResource::publish
+// haveMoreData() is called after the lock is released: a subscriber that found nothing new has
+// registered its wait under the lock, so it is woken by this call and cannot miss the event
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StreamResource::publish(const std::shared_ptr<const train_update_t>& update)
+{
+  if (!update)
+  {
+    return;
+  }
+  std::shared_ptr<stream_event_t> event = std::make_shared<stream_event_t>();
+  event->version = update->version;
+  event->all = stream_frame(update->version, update->trains.json);
+  for (std::map<std::string, json_body_t>::const_iterator it = update->lines.begin(); it != update->lines.end(); ++it)
+  {
+    event->lines[it->first] = stream_frame(update->version, it->second.json);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ring.empty() && ring.back()->version >= event->version)
+    {
+      return;
+    }
+    ring.push_back(event);
+    while (ring.size() > ring_size)
+    {
+      ring.pop_front();
+    }
+  }
+  haveMoreData();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamResource::handleRequest
+// first call: headers, then the newest event, or the one after Last-Event-ID; later calls, made by
+// Wt once the previous event is sent or after publish(): the next event, or a wait for one
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StreamResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+  const std::string* line = request.getParameter("line");
+  Wt::Http::ResponseContinuation* continuation = request.continuation();
+  stream_state_t state;
+  state.version = 0;
+
+  if (!continuation)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (line && !ring.empty() && !ring.back()->lines.count(*line))
+      {
+        send_error(response, 404, "unknown line");
+        return;
+      }
+    }
+    response.setStatus(200);
+    response.setMimeType("text/event-stream");
+    response.addHeader("Cache-Control", "no-cache");
+    response.addHeader("X-Accel-Buffering", "no");
+    response.addHeader("Access-Control-Allow-Origin", "*");
+    response.out() << "retry: 5000\n\n";
+
+    std::string last_event_id = request.headerValue("Last-Event-ID");
+    if (!last_event_id.empty())
+    {
+      state.version = std::strtoull(last_event_id.c_str(), nullptr, 10);
+    }
+  }
+  else
+  {
+    state = Wt::cpp17::any_cast<stream_state_t>(continuation->data());
+  }
+
+  std::shared_ptr<const stream_event_t> event;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ring.empty())
+    {
+      const stream_event_t& oldest = *ring.front();
+      const stream_event_t& newest = *ring.back();
+      if (state.version == 0 || state.version > newest.version || state.version + 1 < oldest.version)
+      {
+        //new subscriber, an id from before a restart, or fell behind the ring
+        event = ring.back();
+      }
+      else
+      {
+        for (size_t idx = 0; idx < ring.size() && !event; ++idx)
+        {
+          if (ring[idx]->version > state.version)
+          {
+            event = ring[idx];
+          }
+        }
+      }
+    }
+    if (!event)
+    {
+      continuation = response.createContinuation();
+      continuation->setData(state);
+      continuation->waitForMoreData();
+      return;
+    }
+  }
+
+  const std::string* frame = &event->all;
+  if (line)
+  {
+    std::map<std::string, std::string>::const_iterator it = event->lines.find(*line);
+    if (it == event->lines.end())
+    {
+      //unknown line, accepted before the first event: end the stream
+      response.out() << "event: error\ndata: unknown line\n\n";
+      return;
+    }
+    frame = &it->second;
+  }
+  response.out().write(frame->data(), static_cast<std::streamsize>(frame->size()));
+  state.version = event->version;
+
+  //without waitForMoreData, Wt calls again once this event is sent
+  continuation = response.createContinuation();
+  continuation->setData(state);
+}
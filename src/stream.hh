@@ -0,0 +1,56 @@
+#ifndef STREAM_HH
+#define STREAM_HH
+
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <Wt/WResource.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include "update.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// stream_event_t
+// one train update as Server-Sent Events frames, "id: version, event: trains, data: json", for all
+// lines and for each line; rendered once per publication and written as is to every subscriber
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct stream_event_t
+{
+  uint64_t version;
+  std::string all;
+  std::map<std::string, std::string> lines;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamResource
+// GET /stream/trains[?line=RD]: a text/event-stream that gets an event for each train update,
+// without a Wt session; the connection is held by a Wt continuation
+// publish() adds the update to a ring of the last ring_size events and wakes the idle subscribers
+// each call of handleRequest writes one event, the first one after the last the subscriber got,
+// and Wt calls it again only once that event is sent; a subscriber that falls behind the ring,
+// by a slow link or a long disconnect, skips to the newest event, so a slow client holds at most
+// one event in memory and never delays the others
+// a client reconnecting with Last-Event-ID gets the events it missed that are still in the ring
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class StreamResource : public Wt::WResource
+{
+public:
+  StreamResource(size_t ring_size);
+  virtual ~StreamResource();
+  void publish(const std::shared_ptr<const train_update_t>& update);
+
+protected:
+  virtual void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+  size_t ring_size;
+  std::deque<std::shared_ptr<const stream_event_t>> ring; //oldest first
+  std::mutex mutex;
+};
+
+#endif
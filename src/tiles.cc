@@ -0,0 +1,262 @@
+#include <iostream>
+#include <cstdlib>
+#include <sqlite3.h>
+#include "tiles.hh"
+#include "plan.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t::mbtiles_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+mbtiles_t::mbtiles_t() :
+  db(nullptr),
+  stmt(nullptr)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t::~mbtiles_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+mbtiles_t::~mbtiles_t()
+{
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t::open
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int mbtiles_t::open(const std::string& file_name)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (sqlite3_open_v2(file_name.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK ||
+    sqlite3_prepare_v2(db, "SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?", -1, &stmt, nullptr) != SQLITE_OK)
+  {
+    std::cout << "MBTiles: cannot open " << file_name << ": " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    stmt = nullptr;
+    db = nullptr;
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t::get
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int mbtiles_t::get(int z, int x, int y, std::string& tile)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!stmt)
+  {
+    return -1;
+  }
+  int tms_y = (1 << z) - 1 - y;
+  sqlite3_bind_int(stmt, 1, z);
+  sqlite3_bind_int(stmt, 2, x);
+  sqlite3_bind_int(stmt, 3, tms_y);
+  int step = sqlite3_step(stmt);
+  int result = step == SQLITE_ROW ? 0 : step == SQLITE_DONE ? 1 : -1;
+  if (result == 0)
+  {
+    const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+    tile.assign(data ? data : "", static_cast<size_t>(sqlite3_column_bytes(stmt, 0)));
+  }
+  sqlite3_reset(stmt);
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t::metadata
+// value of a row of the metadata table (format, minzoom, maxzoom, ...), empty if absent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string mbtiles_t::metadata(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string value;
+  sqlite3_stmt* query = nullptr;
+  if (db && sqlite3_prepare_v2(db, "SELECT value FROM metadata WHERE name = ?", -1, &query, nullptr) == SQLITE_OK)
+  {
+    sqlite3_bind_text(query, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(query) == SQLITE_ROW && sqlite3_column_text(query, 0))
+    {
+      value = reinterpret_cast<const char*>(sqlite3_column_text(query, 0));
+    }
+  }
+  sqlite3_finalize(query);
+  return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tile_cache_t::tile_cache_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tile_cache_t::tile_cache_t(size_t capacity_) :
+  capacity(capacity_),
+  used(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tile_cache_t::get
+// null if the tile is not cached
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const std::string> tile_cache_t::get(uint64_t key)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unordered_map<uint64_t, lru_t::iterator>::iterator it = index.find(key);
+  if (it == index.end())
+  {
+    return nullptr;
+  }
+  lru.splice(lru.begin(), lru, it->second);
+  return it->second->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tile_cache_t::put
+// evicts from the least recently used end until the new tile fits; each entry counts its bytes plus
+// an estimate of the list and index nodes, so cached empty tiles are bounded too
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void tile_cache_t::put(uint64_t key, const std::shared_ptr<const std::string>& tile)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t cost = tile->size() + entry_overhead;
+  if (index.count(key) || cost > capacity)
+  {
+    return;
+  }
+  while (!lru.empty() && used + cost > capacity)
+  {
+    used -= lru.back().second->size() + entry_overhead;
+    index.erase(lru.back().first);
+    lru.pop_back();
+  }
+  lru.emplace_front(key, tile);
+  index[key] = lru.begin();
+  used += cost;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tile_cache_t::bytes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t tile_cache_t::bytes() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return used;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// parse_tile_path
+// "/z/x/y" with any extension; 0 on success, -1 if the path is not a tile of the zoom level
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int parse_tile_path(const std::string& path, int& z, int& x, int& y)
+{
+  int values[3];
+  const char* pos = path.c_str();
+  for (int idx = 0; idx < 3; ++idx)
+  {
+    if (*pos != '/')
+    {
+      return -1;
+    }
+    char* end = nullptr;
+    long value = std::strtol(pos + 1, &end, 10);
+    if (end == pos + 1 || value < 0 || value > (1L << 24))
+    {
+      return -1;
+    }
+    values[idx] = static_cast<int>(value);
+    pos = end;
+  }
+  if (*pos != '\0' && *pos != '.')
+  {
+    return -1;
+  }
+  z = values[0];
+  x = values[1];
+  y = values[2];
+  if (z > 24 || x >= (1 << z) || y >= (1 << z))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// TileResource::TileResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileResource::TileResource(mbtiles_t& tiles_, size_t cache_bytes) :
+  tiles(tiles_),
+  cache(cache_bytes)
+{
+  std::string format = tiles.metadata("format");
+  mime_type = format == "png" ? "image/png" : format == "jpg" ? "image/jpeg" : format == "webp" ? "image/webp" : "application/x-protobuf";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// TileResource::~TileResource
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileResource::~TileResource()
+{
+  beingDeleted();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// TileResource::handleRequest
+// called concurrently from the server threads; a cached tile is sent without touching the file
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+  int z = 0;
+  int x = 0;
+  int y = 0;
+  if (parse_tile_path(request.pathInfo(), z, x, y) != 0)
+  {
+    send_error(response, 404, "not a tile path, /tiles/{z}/{x}/{y}.pbf");
+    return;
+  }
+
+  uint64_t key = (static_cast<uint64_t>(z) << 48) | (static_cast<uint64_t>(x) << 24) | static_cast<uint64_t>(y);
+  std::shared_ptr<const std::string> tile = cache.get(key);
+  if (!tile)
+  {
+    std::string data;
+    int result = tiles.get(z, x, y, data);
+    if (result < 0)
+    {
+      send_error(response, 503, "cannot read the tile file");
+      return;
+    }
+    tile = std::make_shared<const std::string>(std::move(data));
+    cache.put(key, tile);
+  }
+
+  response.addHeader("Cache-Control", "public, max-age=86400");
+  response.addHeader("Access-Control-Allow-Origin", "*");
+  if (tile->empty())
+  {
+    response.setStatus(204);
+    return;
+  }
+  response.setStatus(200);
+  response.setMimeType(mime_type);
+  if (tile->size() > 2 && static_cast<unsigned char>((*tile)[0]) == 0x1f && static_cast<unsigned char>((*tile)[1]) == 0x8b)
+  {
+    response.addHeader("Content-Encoding", "gzip");
+  }
+  response.setContentLength(tile->size());
+  response.out().write(tile->data(), static_cast<std::streamsize>(tile->size()));
+}
@@ -0,0 +1,89 @@
+#ifndef TILES_HH
+#define TILES_HH
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <Wt/WResource.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mbtiles_t
+// read only MBTiles file (SQLite): tiles(zoom_level, tile_column, tile_row, tile_data), with rows
+// counted from the south (TMS); get() takes XYZ coordinates as the map requests them
+// one connection and one prepared statement, used under mutex
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class mbtiles_t
+{
+public:
+  mbtiles_t();
+  ~mbtiles_t();
+  int open(const std::string& file_name);
+  bool is_open() const { return db != nullptr; }
+  int get(int z, int x, int y, std::string& tile); //0 found, 1 no such tile, -1 error
+  std::string metadata(const std::string& name);
+
+private:
+  mbtiles_t(const mbtiles_t&) = delete;
+  mbtiles_t& operator=(const mbtiles_t&) = delete;
+  sqlite3* db;
+  sqlite3_stmt* stmt;
+  std::mutex mutex;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// tile_cache_t
+// least recently used tiles, up to capacity bytes; an empty tile records one the file does not have
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class tile_cache_t
+{
+public:
+  tile_cache_t(size_t capacity);
+  std::shared_ptr<const std::string> get(uint64_t key);
+  void put(uint64_t key, const std::shared_ptr<const std::string>& tile);
+  size_t bytes() const;
+  static const size_t entry_overhead = 128;
+
+private:
+  typedef std::list<std::pair<uint64_t, std::shared_ptr<const std::string>>> lru_t;
+  lru_t lru; //most recent first
+  std::unordered_map<uint64_t, lru_t::iterator> index;
+  size_t capacity;
+  size_t used;
+  mutable std::mutex mutex;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// TileResource
+// GET /tiles/{z}/{x}/{y}.pbf from an MBTiles file, for the offline basemap
+// 204 for a tile the file does not have, which the map draws empty; gzip compressed vector tiles
+// are sent as stored, with Content-Encoding: gzip
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TileResource : public Wt::WResource
+{
+public:
+  TileResource(mbtiles_t& tiles, size_t cache_bytes);
+  virtual ~TileResource();
+
+protected:
+  virtual void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+  mbtiles_t& tiles;
+  tile_cache_t cache;
+  std::string mime_type;
+};
+
+int parse_tile_path(const std::string& path, int& z, int& x, int& y);
+
+#endif
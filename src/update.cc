@@ -0,0 +1,192 @@
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <zlib.h>
+#include "update.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// generate_train
+// one line of JSON: the strings come from the WMATA API and are escaped, control characters included
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string generate_train(const std::vector<TrainPosition>& positions)
+{
+  std::stringstream json;
+  json << "{\"trains\":[";
+
+  bool first = true;
+  for (size_t idx = 0; idx < positions.size(); ++idx)
+  {
+    const TrainPosition& pos = positions[idx];
+
+    if (std::isnan(pos.Lng) || std::isnan(pos.Lat) ||
+      std::isinf(pos.Lng) || std::isinf(pos.Lat))
+    {
+      continue;
+    }
+
+    if (!first)
+    {
+      json << ",";
+    }
+    first = false;
+
+    json << "{"
+      << "\"lng\":" << pos.Lng << ","
+      << "\"lat\":" << pos.Lat << ","
+      << "\"destination\":\"" << json_escape(pos.Destination) << "\","
+      << "\"location_name\":\"" << json_escape(pos.LocationName) << "\","
+      << "\"min\":\"" << json_escape(pos.Min) << "\","
+      << "\"car\":\"" << json_escape(pos.Car) << "\","
+      << "\"line_color\":\"" << json_escape(pos.LineColor) << "\","
+      << "\"scheduled\":" << (pos.Scheduled ? "true" : "false")
+      << "}";
+  }
+
+  json << "]}";
+  return json.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// render_update
+// the work every session used to repeat for each update, done once per publication; sessions
+// hold the result by shared_ptr and send its bytes as they are
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const train_update_t> render_update(const std::vector<TrainPosition>& positions, uint64_t version,
+  uint64_t red_version, const std::shared_ptr<const std::string>& red_js, const std::map<std::string, std::string>& line_colors)
+{
+  std::shared_ptr<train_update_t> update = std::make_shared<train_update_t>();
+  update->version = version;
+  update->time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  make_json_body(generate_train(positions), update->trains);
+
+  //positions carry the line color; line_colors maps each line code to it
+  for (std::map<std::string, std::string>::const_iterator it = line_colors.begin(); it != line_colors.end(); ++it)
+  {
+    std::vector<TrainPosition> line_positions;
+    for (size_t idx = 0; idx < positions.size(); ++idx)
+    {
+      if (positions[idx].LineColor == it->second)
+      {
+        line_positions.push_back(positions[idx]);
+      }
+    }
+    make_json_body(generate_train(line_positions), update->lines[it->first]);
+  }
+
+  //kept in window.last_trains for the map to draw when it finishes loading
+  const std::string& json = update->trains.json;
+  update->js.reserve(json.size() + 192);
+  update->js += "window.last_update = {\"version\":" + std::to_string(version) + ",\"time\":" + std::to_string(update->time) + "};\n";
+  update->js += "window.last_trains = ";
+  update->js += json;
+  update->js += ";\n"
+    "if (typeof window.update_trains === 'function') {\n"
+    "  window.update_trains(window.last_trains);\n"
+    "}";
+
+  update->red_version = red_version;
+  update->red_js = red_js;
+  return update;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// render_red_line
+// script that replaces the Red Line source of a loaded map in place; rendered once per layer
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const std::string> render_red_line(const std::string& geojson)
+{
+  std::shared_ptr<std::string> js = std::make_shared<std::string>();
+  if (!geojson.empty())
+  {
+    js->reserve(geojson.size() + 128);
+    *js += "if (typeof map !== 'undefined' && map.getSource('red-line')) {\n"
+      "  map.getSource('red-line').setData(";
+    *js += geojson;
+    *js += ");\n}\n";
+  }
+  return js;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// gzip_compress
+// gzip member (RFC 1952) of data, for a Content-Encoding: gzip response
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int gzip_compress(const std::string& data, std::string& out)
+{
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return -1;
+  }
+  out.resize(deflateBound(&stream, static_cast<uLong>(data.size())) + 32);
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  int result = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END)
+  {
+    out.clear();
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// make_json_body
+// the ETag is the FNV-1a hash of the JSON, quoted as a strong validator
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void make_json_body(const std::string& json, json_body_t& body)
+{
+  body.json = json;
+  gzip_compress(body.json, body.json_gz);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t idx = 0; idx < json.size(); ++idx)
+  {
+    hash ^= static_cast<unsigned char>(json[idx]);
+    hash *= 1099511628211ull;
+  }
+  char etag[24];
+  std::snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(hash));
+  body.etag = etag;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// json_escape
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string json_escape(std::string_view str)
+{
+  std::string out;
+  out.reserve(str.size());
+  for (size_t idx = 0; idx < str.size(); ++idx)
+  {
+    char c = str[idx];
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    }
+    else
+    {
+      out += c;
+    }
+  }
+  return out;
+}
@@ -0,0 +1,71 @@
+#ifndef UPDATE_HH
+#define UPDATE_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// TrainPosition
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TrainPosition
+{
+  double Lng;
+  double Lat;
+  std::string Destination;
+  std::string LocationName;
+  std::string Min;
+  std::string Car;
+  std::string LineColor;
+  bool Scheduled; //from the GTFS timetable rather than live predictions
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// json_body_t
+// a JSON response as served over HTTP: the bytes, their gzip, and an ETag that is a hash of the
+// bytes, so an unchanged body keeps its ETag across publications
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct json_body_t
+{
+  std::string json;
+  std::string json_gz;
+  std::string etag;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// train_update_t
+// one publication, rendered once and shared read only by every session that sends it
+//   time     when it was rendered, ms since the epoch; with version, kept in window.last_update so
+//            a client can tell how late an update arrived
+//   trains   {"trains":[...]}, from generate_train(), for the map and for /api/trains
+//   lines    the same for the trains of each line, by line code, for /api/trains?line=
+//   js       the script a session sends to its map with doJavaScript
+//   red_js   script that replaces the Red Line source with layer red_version; sent only by sessions
+//            that still show an older layer, and shared by the updates of the same layer
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct train_update_t
+{
+  uint64_t version;
+  int64_t time;
+  json_body_t trains;
+  std::map<std::string, json_body_t> lines;
+  std::string js;
+  uint64_t red_version;
+  std::shared_ptr<const std::string> red_js;
+};
+
+std::string generate_train(const std::vector<TrainPosition>& positions);
+std::shared_ptr<const train_update_t> render_update(const std::vector<TrainPosition>& positions, uint64_t version,
+  uint64_t red_version, const std::shared_ptr<const std::string>& red_js, const std::map<std::string, std::string>& line_colors);
+std::shared_ptr<const std::string> render_red_line(const std::string& geojson);
+int gzip_compress(const std::string& data, std::string& out);
+void make_json_body(const std::string& json, json_body_t& body);
+std::string json_escape(std::string_view str);
+
+#endif
@@ -6,32 +6,58 @@
 #include <Wt/Json/Object.h>
 #include <Wt/Json/Parser.h>
 #include <Wt/Json/Array.h>
-#include <Wt/WTimer.h>
+#include <Wt/WServer.h>
 #ifdef _WIN32
 #include <windows.h>
 #endif
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <map>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <chrono>
 #include <fstream>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "map.hh"
+#include "loader.hh"
+#include "feed.hh"
+#include "plan.hh"
 #include "wmata.hh"
 #include "ssl_read.hh"
 #include "get.hh"
+#include "poller.hh"
+#include "record_log.hh"
+#include "download.hh"
+#include "gtfs_rt.hh"
+#include "publisher.hh"
+#include "api.hh"
+#include "stream.hh"
+#include "tiles.hh"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // globals
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void parse_stations(const std::string& buf, bool clear = false);
-void parse_predictions(const std::string& buf);
+void parse_stations(const std::string& buf, std::vector<Station>& out);
+void parse_predictions(const std::string& buf, std::vector<Prediction>& out);
+double prediction_change(const std::vector<Prediction>& previous, const std::vector<Prediction>& next);
 std::string fetch_predictions(const std::string& api_key);
-std::vector<TrainPosition> calculate_positions();
-std::string generate_train(const std::vector<TrainPosition>& positions);
+std::vector<TrainPosition> calculate_positions(const std::vector<Prediction>& predictions);
+std::vector<TrainPosition> calculate_scheduled_positions();
+std::vector<TrainPosition> calculate_rt_positions(const rt_feed_t& rt);
+double position_change(const std::vector<TrainPosition>& previous, const std::vector<TrainPosition>& next);
+int fetch_gtfs_rt(const std::string& api_key, api_quota_t& quota, std::string& vehicles, std::string& trip_updates);
+void render_trains();
+std::string generate_stations(const std::vector<Station>& stations);
+void render_reference(const feed_t* feed);
+int replay_predictions(const std::string& file_name, double speed);
 void parse_line_geometry(const std::string& geojson, std::vector<std::pair<double, double>>& path_points);
 double calculate_distance(double lon1, double lat1, double lon2, double lat2);
 void interpolate_along_path(const std::vector<std::pair<double, double>>& path,
@@ -52,10 +78,43 @@ std::vector<std::string> ward_color =
 };
 
 std::string geojson_wards;
-std::string geojson_red;
 std::vector<Station> stations;
-std::vector<Prediction> predictions;
-std::vector<std::pair<double, double>> red_path;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// reloadable state
+// feeds, red_line and predictions are swapped whole while sessions read them; take one snapshot
+// per use, with feeds.current() and std::atomic_load(&red_line) or std::atomic_load(&predictions)
+// feeds reads the downloaded archive data/gtfs.zip when present, else the extracted data/gtfs
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+feed_watcher_t feeds("data/gtfs");
+std::shared_ptr<const line_layer_t> red_line;
+std::shared_ptr<const prediction_set_t> predictions; //written by the poller only
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher
+// whoever replaces red_line or predictions publishes; open sessions are pushed the update
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+publisher_t publisher;
+std::shared_ptr<const train_update_t> train_update; //written by publisher.render only
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// /api stations and lines
+// reference_mutex orders the GTFS reload, which rewrites the line files, against the first render
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const reference_data_t> reference;
+std::mutex reference_mutex;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// startup readiness
+// the globals above are written by loader tasks; wait on the matching future before reading them
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_future<void> wards_ready;
+std::shared_future<void> red_ready;
+std::shared_future<void> stations_ready;
 
 std::map<std::string, std::string> line_colors =
 {
@@ -69,6 +128,13 @@ std::map<std::string, std::string> line_colors =
 
 const std::vector<std::string> line_codes = { "RD", "OR", "SV", "BL", "YL", "GR" };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// --offline: MapLibre, the style, fonts and sprites from the docroot and the basemap tiles from a
+// local MBTiles file at /tiles, instead of unpkg.com and basemaps.cartocdn.com
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool offline = false;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // Red Line station order (Shady Grove to Glenmont)
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -112,36 +178,380 @@ std::unique_ptr<Wt::WApplication> create_application(const Wt::WEnvironment& env
 
 int main(int argc, char* argv[])
 {
-  geojson_wards = load_file("data/ward-2012.geojson");
-  if (!geojson_wards.empty())
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // --replay log [--speed N]: run a recorded predictions log through the pipeline instead of serving
+  // --offline: serve the map without third-party origins
+  // the remaining arguments go to Wt
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string replay_file;
+  double replay_speed = 0;
+  std::vector<char*> wt_argv;
+  for (int idx = 0; idx < argc; ++idx)
   {
+    if (std::string(argv[idx]) == "--replay" && idx + 1 < argc)
+    {
+      replay_file = argv[++idx];
+    }
+    else if (std::string(argv[idx]) == "--speed" && idx + 1 < argc)
+    {
+      replay_speed = std::atof(argv[++idx]);
+    }
+    else if (std::string(argv[idx]) == "--offline")
+    {
+      offline = true;
+    }
+    else
+    {
+      wt_argv.push_back(argv[idx]);
+    }
   }
 
-  geojson_red = load_file("data/line_RD.geojson");
-  if (!geojson_red.empty())
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load resources in parallel
+  // stations are needed by every session and by the predictions request, wait for them here
+  // wards and line geometry keep loading while the server starts; render() waits on them
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  thread_pool_t pool;
+  loader_t loader(pool);
+
+  wards_ready = loader.add("data/ward-2012.geojson", []()
+    {
+      geojson_wards = load_file("data/ward-2012.geojson");
+    });
+
+  red_ready = loader.add("data/line_RD.geojson", []()
+    {
+      std::shared_ptr<line_layer_t> layer = std::make_shared<line_layer_t>();
+      layer->geojson = load_file("data/line_RD.geojson");
+      layer->version = 0;
+      if (!layer->geojson.empty())
+      {
+        parse_line_geometry(layer->geojson, layer->path);
+      }
+      std::atomic_store(&red_line, std::shared_ptr<const line_layer_t>(layer));
+    });
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // GTFS feed, then watch it for a new one
+  // a reload rewrites the line files that changed, each through a temp file so a crash leaves the
+  // old file whole, and replaces the Red Line layer; sessions pick the new layer up on their next update
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  feeds.on_swap = [](const feed_t& feed, const std::vector<std::string>& changed_lines)
+    {
+      std::lock_guard<std::mutex> lock(reference_mutex);
+      for (size_t idx = 0; idx < changed_lines.size(); ++idx)
+      {
+        const std::string& geojson = feed.lines.at(changed_lines[idx]);
+        std::string filename = "data/line_" + changed_lines[idx] + ".geojson";
+        if (write_atomic(filename, geojson) < 0)
+        {
+          std::cout << "failed to write " << filename << std::endl;
+        }
+
+        if (changed_lines[idx] == "RD")
+        {
+          std::shared_ptr<line_layer_t> layer = std::make_shared<line_layer_t>();
+          layer->geojson = geojson;
+          layer->version = feed.version;
+          parse_line_geometry(layer->geojson, layer->path);
+          std::atomic_store(&red_line, std::shared_ptr<const line_layer_t>(layer));
+          publisher.publish();
+        }
+      }
+
+      //before the first render, that render reads this feed
+      if (!changed_lines.empty() && std::atomic_load(&reference))
+      {
+        render_reference(&feed);
+      }
+    };
+
+  loader.add("data/gtfs", []()
+    {
+      feeds.load();
+      feeds.start();
+    });
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // each station file is parsed into its own vector; the last task to finish merges them
+  // in line_codes order, so the station order does not depend on thread scheduling
+  // every task counts down whether it failed or not, so stations_ready is always set; a failed
+  // file is stored in its slot and the merge hands the first failure to stations_ready instead
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::shared_ptr<std::vector<std::vector<Station>>> line_stations = std::make_shared<std::vector<std::vector<Station>>>(line_codes.size());
+  std::shared_ptr<std::vector<std::exception_ptr>> line_errors = std::make_shared<std::vector<std::exception_ptr>>(line_codes.size());
+  std::shared_ptr<std::atomic<size_t>> pending = std::make_shared<std::atomic<size_t>>(line_codes.size());
+  std::shared_ptr<std::promise<void>> merged = std::make_shared<std::promise<void>>();
+  stations_ready = merged->get_future().share();
+
+  for (size_t idx = 0; idx < line_codes.size(); ++idx)
   {
-    parse_line_geometry(geojson_red, red_path);
-    std::cout << red_path.size() << " path points" << std::endl;
+    std::string filename = "data/stations_" + line_codes[idx] + ".json";
+    loader.add(filename, [filename, idx, line_stations, line_errors, pending, merged]()
+      {
+        try
+        {
+          std::string stations_json = load_file(filename);
+          if (!stations_json.empty())
+          {
+            parse_stations(stations_json, (*line_stations)[idx]);
+          }
+        }
+        catch (...)
+        {
+          (*line_errors)[idx] = std::current_exception();
+        }
+        std::exception_ptr error = (*line_errors)[idx];
+
+        if (--(*pending) == 0)
+        {
+          std::exception_ptr first;
+          for (size_t jdx = 0; jdx < line_errors->size() && !first; ++jdx)
+          {
+            first = (*line_errors)[jdx];
+          }
+          if (!first)
+          {
+            try
+            {
+              stations.clear();
+              for (size_t jdx = 0; jdx < line_stations->size(); ++jdx)
+              {
+                stations.insert(stations.end(), (*line_stations)[jdx].begin(), (*line_stations)[jdx].end());
+              }
+            }
+            catch (...)
+            {
+              first = std::current_exception();
+            }
+          }
+          if (first)
+          {
+            merged->set_exception(first);
+          }
+          else
+          {
+            merged->set_value();
+          }
+        }
+
+        //the loader reports this file as failed
+        if (error)
+        {
+          std::rethrow_exception(error);
+        }
+      });
   }
 
-  bool first = true;
-  for (size_t idx = 0; idx < line_codes.size(); ++idx)
+  try
+  {
+    stations_ready.get();
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "stations: " << e.what() << std::endl;
+    loader.wait();
+    loader.report(std::cout);
+    feeds.stop();
+    return 1;
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << stations.size() << " stations loaded in " << elapsed.count() << " ms" << std::endl;
+
+  if (!replay_file.empty())
   {
-    const std::string& line_code = line_codes[idx];
-    std::string filename = "data/stations_" + line_code + ".json";
-    std::string stations_json = load_file(filename);
-    if (!stations_json.empty())
+    red_ready.wait();
+    int replayed = replay_predictions(replay_file, replay_speed);
+    loader.wait();
+    feeds.stop();
+    return replayed == 0 ? 0 : 1;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(reference_mutex);
+    std::shared_ptr<const feed_t> feed = feeds.current();
+    render_reference(feed.get());
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // one prediction poller for all sessions
+  // the interval adapts to how fast predictions change, within POLL_MIN_SECONDS and POLL_MAX_SECONDS,
+  // and never spends more than the API quota (CALLS_PER_SECOND, CALLS_PER_DAY) allows
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string config = load_file("config.json");
+  std::string api_key = extract_value(config, "API_KEY");
+  set_api_endpoint(config);
+  api_quota_t quota(extract_number(config, "CALLS_PER_SECOND", 10), static_cast<uint32_t>(extract_number(config, "CALLS_PER_DAY", 50000)));
+  poll_options_t poll_options;
+  poll_options.min_interval = std::chrono::seconds(static_cast<long long>(extract_number(config, "POLL_MIN_SECONDS", 10)));
+  poll_options.max_interval = std::chrono::seconds(static_cast<long long>(extract_number(config, "POLL_MAX_SECONDS", 300)));
+  poller_t poller(quota, poll_options);
+
+  //RECORD_LOG: append every predictions response to this record log, for --replay
+  record_writer_t recorder;
+  if (config.find("\"RECORD_LOG\"") != std::string::npos)
+  {
+    recorder.open(extract_value(config, "RECORD_LOG"));
+  }
+
+  poller.fetch = [api_key](std::string& body)
     {
-      parse_stations(stations_json, first);
-      first = false;
+      body = fetch_predictions(api_key);
+      return body.empty() ? -1 : 0;
+    };
+  poller.on_update = [&recorder](const std::string& body)
+    {
+      if (recorder.is_open())
+      {
+        recorder.append(now_ms(), body);
+      }
+      std::shared_ptr<prediction_set_t> next = std::make_shared<prediction_set_t>();
+      parse_predictions(body, next->trains);
+      std::shared_ptr<const prediction_set_t> previous = std::atomic_load(&predictions);
+      next->version = previous ? previous->version + 1 : 1;
+      double change = prediction_change(previous ? previous->trains : std::vector<Prediction>(), next->trains);
+      std::atomic_store(&predictions, std::shared_ptr<const prediction_set_t>(next));
+      publisher.publish();
+      return change;
+    };
+
+  //"TRAIN_SOURCE": "gtfs-rt" shows the vehicle positions of the GTFS-realtime feed instead of
+  //positions inferred from the predictions; fetch and on_update both run on the poller thread
+  std::string trip_updates;
+  if (config.find("\"TRAIN_SOURCE\"") != std::string::npos && extract_value(config, "TRAIN_SOURCE") == "gtfs-rt")
+  {
+    poller.fetch = [api_key, &quota, &trip_updates](std::string& body)
+      {
+        return fetch_gtfs_rt(api_key, quota, body, trip_updates);
+      };
+    poller.on_update = [&trip_updates](const std::string& body)
+      {
+        rt_feed_t rt;
+        if (gtfs_rt_decode(body, rt) != 0 || gtfs_rt_decode(trip_updates, rt) != 0)
+        {
+          std::cout << "GTFS-realtime: malformed feed, " << rt.vehicles.size() << " vehicles decoded" << std::endl;
+        }
+        std::shared_ptr<prediction_set_t> next = std::make_shared<prediction_set_t>();
+        next->positions = calculate_rt_positions(rt);
+        std::shared_ptr<const prediction_set_t> previous = std::atomic_load(&predictions);
+        next->version = previous ? previous->version + 1 : 1;
+        double change = position_change(previous ? previous->positions : std::vector<TrainPosition>(), next->positions);
+        std::atomic_store(&predictions, std::shared_ptr<const prediction_set_t>(next));
+        publisher.publish();
+        return change;
+      };
+  }
+
+  //the first update, for the first sessions; then one per publication, also sent to /stream/trains
+  std::shared_ptr<StreamResource> stream = std::make_shared<StreamResource>(32);
+  publisher.render = [stream]()
+    {
+      render_trains();
+      stream->publish(std::atomic_load(&train_update));
+    };
+  publisher.publish();
+  if (!api_key.empty())
+  {
+    poller.start();
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // report per file timing once everything is in, without holding up the server
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::thread reporter([&loader]()
+    {
+      loader.wait();
+      loader.report(std::cout);
+      std::shared_ptr<const line_layer_t> layer = std::atomic_load(&red_line);
+      std::cout << layer->path.size() << " path points" << std::endl;
+      std::shared_ptr<const feed_t> feed = feeds.current();
+      if (!feed)
+      {
+        std::cout << "GTFS: no feed in data/gtfs or data/gtfs.zip" << std::endl;
+        return;
+      }
+      const gtfs_t& gtfs = feed->gtfs;
+      std::cout << "GTFS: " << gtfs.stops.size() << " stops, " << gtfs.routes.size() << " routes, "
+        << gtfs.trips.size() << " trips, " << gtfs.stop_times.size() << " stop times, "
+        << gtfs.pathways.size() << " pathways, " << gtfs.memory() / 1024 << " KB" << std::endl;
+      std::cout << "calendar: " << feed->calendar.first_date() << "-" << feed->calendar.last_date() << ", "
+        << feed->calendar.memory() / 1024 << " KB" << std::endl;
+      std::cout << "schedule: " << feed->schedule.size() << " trips, " << feed->schedule.memory() / 1024 << " KB" << std::endl;
+      std::cout << "pathways: " << feed->pathways.size() << " edges, " << feed->pathways.entrance_list.size() << " entrances, "
+        << feed->pathways.platform_list.size() << " platforms, " << feed->pathways.memory() / 1024 << " KB" << std::endl;
+      std::cout << "planner: " << feed->raptor.nbr_patterns() << " patterns, " << feed->raptor.nbr_stops() << " stops, "
+        << feed->raptor.memory() / 1024 << " KB" << std::endl;
+    });
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // web server: the map application, the /plan journey planner, the /api JSON endpoints, the
+  // /stream/trains event stream, and with --offline the /tiles basemap
+  // /api/trains stays cacheable until the next poll or heartbeat is due, whichever comes first
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::chrono::seconds heartbeat(60);
+  bool polling = !api_key.empty();
+  std::function<std::chrono::seconds()> refresh = [&poller, heartbeat, polling]()
+    {
+      return polling ? std::min(poller.interval(), heartbeat) : heartbeat;
+    };
+
+  //MBTILES: the basemap of --offline, TILE_CACHE_MB: memory for its most used tiles
+  mbtiles_t basemap;
+  if (offline)
+  {
+    std::string mbtiles_file = config.find("\"MBTILES\"") != std::string::npos ? extract_value(config, "MBTILES") : "data/basemap.mbtiles";
+    if (basemap.open(mbtiles_file) == 0)
+    {
+      std::cout << "offline basemap: " << mbtiles_file << ", " << basemap.metadata("format") << " tiles" << std::endl;
     }
-    else
+  }
+
+  int result = 0;
+  try
+  {
+    Wt::WServer server(static_cast<int>(wt_argv.size()), wt_argv.data(), WTHTTP_CONFIGURATION);
+    server.addResource(std::make_shared<PlanResource>(feeds), "/plan");
+    server.addResource(std::make_shared<ApiResource>(api_trains, train_update, reference, refresh), "/api/trains");
+    server.addResource(std::make_shared<ApiResource>(api_stations, train_update, reference, refresh), "/api/stations");
+    server.addResource(std::make_shared<ApiResource>(api_lines, train_update, reference, refresh), "/api/lines");
+    server.addResource(stream, "/stream/trains");
+    if (basemap.is_open())
     {
+      size_t cache_bytes = static_cast<size_t>(extract_number(config, "TILE_CACHE_MB", 64)) * 1024 * 1024;
+      server.addResource(std::make_shared<TileResource>(basemap, cache_bytes), "/tiles");
     }
+    server.addEntryPoint(Wt::EntryPointType::Application, &create_application);
+    if (server.start())
+    {
+      //one clock for all sessions: timetable positions move on once a minute without live data
+      publisher.start(heartbeat);
+      Wt::WServer::waitForShutdown();
+      publisher.stop();
+      server.stop();
+    }
+  }
+  catch (const Wt::WServer::Exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    result = 1;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    result = 1;
   }
 
-  std::cout << stations.size() << " stations loaded." << std::endl;
-  int result = Wt::WRun(argc, argv, &create_application);
+  reporter.join();
+  poller.stop();
+  feeds.stop();
   return result;
 }
 
@@ -150,7 +560,7 @@ int main(int argc, char* argv[])
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ApplicationMap::ApplicationMap(const Wt::WEnvironment& env)
-  : WApplication(env), map(nullptr)
+  : WApplication(env), map(nullptr), red_version(0), update_version(0)
 {
   std::unique_ptr<Wt::WHBoxLayout> layout = std::make_unique<Wt::WHBoxLayout>();
   layout->setContentsMargins(0, 0, 0, 0);
@@ -170,24 +580,21 @@ ApplicationMap::ApplicationMap(const Wt::WEnvironment& env)
   root()->setLayout(std::move(layout));
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // setup timer to update predictions every 2 minutes
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  timer = root()->addChild(std::make_unique<Wt::WTimer>());
-  timer->setInterval(std::chrono::seconds(120));
-  timer->timeout().connect(this, &ApplicationMap::update_predictions);
-  timer->start();
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // initial update after 3 seconds
+  // server push: the publisher posts to this session when a new snapshot is published, and the
+  // update goes out over the open connection; the first update is sent with the page, and the map
+  // applies it once loaded
+  // subscribe before reading the first update, so a snapshot published in between is posted here;
+  // the post runs under the session lock after the constructor and update_version drops it if
+  // it is the update already sent
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  Wt::WTimer* t = root()->addChild(std::make_unique<Wt::WTimer>());
-  t->setInterval(std::chrono::seconds(3));
-  t->timeout().connect(this, &ApplicationMap::update_predictions);
-  t->setSingleShot(true);
-  t->start();
-
+  enableUpdates(true);
+  publisher.subscribe(sessionId(), [this]()
+    {
+      update_predictions();
+      triggerUpdate();
+    });
+  update_predictions();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -196,19 +603,15 @@ ApplicationMap::ApplicationMap(const Wt::WEnvironment& env)
 
 ApplicationMap::~ApplicationMap()
 {
+  publisher.unsubscribe(sessionId());
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // parse_stations
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void parse_stations(const std::string& buf, bool clear)
+void parse_stations(const std::string& buf, std::vector<Station>& out)
 {
-  if (clear)
-  {
-    stations.clear();
-  }
-
   try
   {
     Wt::Json::Object root;
@@ -235,7 +638,7 @@ void parse_stations(const std::string& buf, bool clear)
           Address = addrObj.get("Street").orIfNull("");
         }
 
-        stations.emplace_back(Code, Name, Lat, Lon, LineCode1, Address);
+        out.emplace_back(Code, Name, Lat, Lon, LineCode1, Address);
       }
     }
   }
@@ -249,9 +652,9 @@ void parse_stations(const std::string& buf, bool clear)
 // parse_predictions
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void parse_predictions(const std::string& buf)
+void parse_predictions(const std::string& buf, std::vector<Prediction>& out)
 {
-  predictions.clear();
+  out.clear();
 
   try
   {
@@ -277,7 +680,7 @@ void parse_predictions(const std::string& buf)
 
         if (Line == "RD")
         {
-          predictions.emplace_back(Car, Destination, DestinationCode, Group, Line, LocationCode, LocationName, Min);
+          out.emplace_back(Car, Destination, DestinationCode, Group, Line, LocationCode, LocationName, Min);
         }
       }
     }
@@ -288,6 +691,38 @@ void parse_predictions(const std::string& buf)
   }
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// prediction_change
+// fraction of predictions that differ between two polls (added, removed, or with another Min
+// or location), 0 to 1
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double prediction_change(const std::vector<Prediction>& previous, const std::vector<Prediction>& next)
+{
+  if (previous.empty() && next.empty())
+  {
+    return 0;
+  }
+  std::map<std::string, int> count;
+  for (size_t idx = 0; idx < previous.size(); ++idx)
+  {
+    const Prediction& pred = previous[idx];
+    ++count[pred.LocationCode + "|" + pred.DestinationCode + "|" + pred.Group + "|" + pred.Car + "|" + pred.Min];
+  }
+  size_t same = 0;
+  for (size_t idx = 0; idx < next.size(); ++idx)
+  {
+    const Prediction& pred = next[idx];
+    std::map<std::string, int>::iterator it = count.find(pred.LocationCode + "|" + pred.DestinationCode + "|" + pred.Group + "|" + pred.Car + "|" + pred.Min);
+    if (it != count.end() && it->second > 0)
+    {
+      --it->second;
+      ++same;
+    }
+  }
+  return 1.0 - 2.0 * same / (previous.size() + next.size());
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // fetch_predictions
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -306,8 +741,8 @@ std::string fetch_predictions(const std::string& api_key)
     }
   }
 
-  const std::string host = "api.wmata.com";
-  const std::string port_num = "443";
+  const std::string& host = api_host();
+  const std::string& port_num = api_port();
   std::stringstream http;
   http << "GET /StationPrediction.svc/json/GetPrediction/" << codes.str() << " HTTP/1.1\r\n";
   http << "Host: " << host << "\r\n";
@@ -316,7 +751,7 @@ std::string fetch_predictions(const std::string& api_key)
   http << "api_key: " << api_key << "\r\n";
   http << "Connection: close\r\n\r\n";
 
-  std::cout << http.str() << std::endl;
+  std::cout << "GET /StationPrediction.svc/json/GetPrediction/" << codes.str() << std::endl;
 
   std::string json;
   try
@@ -332,54 +767,163 @@ std::string fetch_predictions(const std::string& api_key)
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// update_predictions
+// fetch_gtfs_rt
+// the vehicle positions and trip updates feeds, concurrently, in one poll; the poller has taken the
+// quota for the first call, the second takes its own and is skipped when none is left (the map
+// then shows positions without arrival times)
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ApplicationMap::update_predictions()
+int fetch_gtfs_rt(const std::string& api_key, api_quota_t& quota, std::string& vehicles, std::string& trip_updates)
 {
-  std::ifstream file("config.json");
-  if (!file.is_open())
+  std::vector<download_t> downloads;
+  downloads.push_back(make_download("gtfsrt_vehicles", api_host(), gtfs_rt_vehicles_path, "application/x-protobuf", api_key, ""));
+  if (quota.acquire())
   {
-    return;
+    downloads.push_back(make_download("gtfsrt_trip_updates", api_host(), gtfs_rt_trip_updates_path, "application/x-protobuf", api_key, ""));
+  }
+  for (size_t idx = 0; idx < downloads.size(); ++idx)
+  {
+    downloads[idx].port = api_port();
   }
 
-  std::stringstream ss;
-  ss << file.rdbuf();
-  std::string buf = ss.str();
-  file.close();
-  std::string api_key = extract_value(buf, "API_KEY");
-  std::string json = fetch_predictions(api_key);
-  try
+  //no retries: each attempt is a call against the quota, and the next poll is soon
+  download_options_t options;
+  options.max_attempts = 1;
+  options.timeout = std::chrono::seconds(20);
+  download_all(downloads, options);
+
+  trip_updates.clear();
+  if (downloads.size() > 1 && downloads[1].error.empty())
   {
-    parse_predictions(json);
+    trip_updates.swap(downloads[1].body);
   }
-  catch (const std::exception& e)
+  if (!downloads[0].error.empty())
   {
-    std::cerr << e.what() << std::endl;
-    return;
+    std::cout << "GTFS-realtime: " << downloads[0].error << std::endl;
+    return -1;
   }
+  vehicles.swap(downloads[0].body);
+  return 0;
+}
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
- // calculate train positions
- /////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// render_trains
+// publisher.render: positions of the newest snapshot (timetable positions when there is no live
+// data), serialized once into train_update for every session to send
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void render_trains()
+{
+  red_ready.wait();
+  std::shared_ptr<const prediction_set_t> snapshot = std::atomic_load(&predictions);
+  std::shared_ptr<const line_layer_t> layer = std::atomic_load(&red_line);
+  std::shared_ptr<const train_update_t> previous = std::atomic_load(&train_update);
 
-  std::vector<TrainPosition> positions = calculate_positions();
+  std::vector<TrainPosition> positions = snapshot && !snapshot->positions.empty() ? snapshot->positions :
+    calculate_positions(snapshot ? snapshot->trains : std::vector<Prediction>());
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // generate JSON with calculated positions
+  // no live trains (request failed or empty): show the timetable positions instead
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::string trains_json = generate_train(positions);
+  if (positions.empty())
+  {
+    positions = calculate_scheduled_positions();
+  }
+
+  //the Red Line script is rendered again only when the layer changes
+  std::shared_ptr<const std::string> red_js = previous && previous->red_version == layer->version ?
+    previous->red_js : render_red_line(layer->geojson);
+  std::atomic_store(&train_update, render_update(positions, previous ? previous->version + 1 : 1, layer->version, red_js, line_colors));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// generate_stations
+// {"stations":[...]} for /api/stations; a station served by several lines is listed once
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string generate_stations(const std::vector<Station>& stations)
+{
+  std::stringstream json;
+  json << std::setprecision(9) << "{\"stations\":[";
+  std::map<std::string, bool> listed;
+  for (size_t idx = 0; idx < stations.size(); ++idx)
+  {
+    const Station& station = stations[idx];
+    if (listed.count(station.Code))
+    {
+      continue;
+    }
+    json << (listed.empty() ? "" : ",") << "{"
+      << "\"code\":\"" << json_escape(station.Code) << "\","
+      << "\"name\":\"" << json_escape(station.Name) << "\","
+      << "\"lat\":" << station.Lat << ","
+      << "\"lon\":" << station.Lon << ","
+      << "\"line\":\"" << json_escape(station.LineCode1) << "\","
+      << "\"address\":\"" << json_escape(station.Address) << "\""
+      << "}";
+    listed[station.Code] = true;
+  }
+  json << "]}";
+  return json.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// render_reference
+// stations and line GeoJSON for /api, rendered once; lines come from the GTFS feed when it is loaded,
+// else from data/line_XX.geojson; called under reference_mutex, once the stations are in
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void render_reference(const feed_t* feed)
+{
+  std::shared_ptr<reference_data_t> data = std::make_shared<reference_data_t>();
+  make_json_body(generate_stations(stations), data->stations);
+  for (size_t idx = 0; idx < line_codes.size(); ++idx)
+  {
+    std::string geojson;
+    if (feed && feed->lines.count(line_codes[idx]))
+    {
+      geojson = feed->lines.at(line_codes[idx]);
+    }
+    else
+    {
+      geojson = load_file("data/line_" + line_codes[idx] + ".geojson");
+    }
+    if (!geojson.empty())
+    {
+      make_json_body(geojson, data->lines[line_codes[idx]]);
+    }
+  }
+  std::atomic_store(&reference, std::shared_ptr<const reference_data_t>(data));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// update_predictions
+// sends the current train_update unless this session already shows it; no serialization here
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ApplicationMap::update_predictions()
+{
+  std::shared_ptr<const train_update_t> update = std::atomic_load(&train_update);
+  if (!update || update->version == update_version)
+  {
+    return;
+  }
+  update_version = update->version;
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // render on map
+  // the Red Line was reloaded since this session drew it: replace the source data in place
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::stringstream js;
-  js << "if (typeof window.update_trains === 'function') {\n"
-    << "  window.update_trains(" << trains_json << ");\n"
-    << "}";
-  doJavaScript(js.str());
+  if (update->red_version != red_version)
+  {
+    if (update->red_js && !update->red_js->empty())
+    {
+      doJavaScript(*update->red_js);
+    }
+    red_version = update->red_version;
+  }
+  doJavaScript(update->js);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -584,9 +1128,11 @@ void interpolate_along_path(const std::vector<std::pair<double, double>>& path,
 // calculate_train_positions - Uses path-based interpolation
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<TrainPosition> calculate_positions()
+std::vector<TrainPosition> calculate_positions(const std::vector<Prediction>& predictions)
 {
   std::vector<TrainPosition> positions;
+  std::shared_ptr<const line_layer_t> layer = std::atomic_load(&red_line);
+  const std::vector<std::pair<double, double>>& red_path = layer->path;
   std::map<std::string, std::pair<double, double>> station_coords;
   for (size_t idx = 0; idx < stations.size(); ++idx)
   {
@@ -619,6 +1165,7 @@ std::vector<TrainPosition> calculate_positions()
     pos.Min = pred.Min;
     pos.Car = pred.Car;
     pos.LineColor = line_colors["RD"];
+    pos.Scheduled = false;
 
     double lng = station_coords[pred.LocationCode].first;
     double lat = station_coords[pred.LocationCode].second;
@@ -698,44 +1245,279 @@ std::vector<TrainPosition> calculate_positions()
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// generate_train
+// calculate_scheduled_positions
+// positions of the trains the GTFS timetable has running now, for the lines drawn on the map
+// Red Line trains between two stations follow red_path, like the live positions
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::string generate_train(const std::vector<TrainPosition>& positions)
+std::vector<TrainPosition> calculate_scheduled_positions()
 {
-  std::stringstream json;
-  json << "{\"trains\":[";
+  std::vector<TrainPosition> positions;
+  std::shared_ptr<const feed_t> feed = feeds.current();
+  if (!feed)
+  {
+    return positions;
+  }
+  const gtfs_t& gtfs = feed->gtfs;
+  std::shared_ptr<const line_layer_t> layer = std::atomic_load(&red_line);
+  const std::vector<std::pair<double, double>>& red_path = layer->path;
 
-  bool first = true;
-  for (size_t idx = 0; idx < positions.size(); ++idx)
+  std::vector<scheduled_position_t> scheduled;
+  feed->schedule.positions_at(std::time(nullptr), scheduled);
+
+  for (size_t idx = 0; idx < scheduled.size(); ++idx)
   {
-    const TrainPosition& pos = positions[idx];
+    const scheduled_position_t& sch = scheduled[idx];
+    uint32_t route = gtfs.trips.route[sch.trip];
+    if (route == gtfs_none)
+    {
+      continue;
+    }
+    std::string line(gtfs.str(gtfs.routes.short_name[route]));
+    if (line_colors.find(line) == line_colors.end())
+    {
+      continue;
+    }
+
+    TrainPosition pos;
+    pos.Destination = gtfs.str(gtfs.trips.headsign[sch.trip]);
+    pos.LocationName = gtfs.str(gtfs.stops.name[sch.to_stop]);
+    pos.Min = sch.eta < 60 ? "ARR" : std::to_string(sch.eta / 60);
+    pos.Car = "";
+    pos.LineColor = line_colors[line];
+    pos.Scheduled = true;
+    pos.Lng = sch.lon;
+    pos.Lat = sch.lat;
+
+    if (line == "RD" && !red_path.empty() && sch.from_stop != sch.to_stop)
+    {
+      uint32_t from = gtfs.stops.station[sch.from_stop];
+      uint32_t to = gtfs.stops.station[sch.to_stop];
+      interpolate_along_path(red_path, gtfs.stops.lon[from], gtfs.stops.lat[from],
+        gtfs.stops.lon[to], gtfs.stops.lat[to], sch.fraction, pos.Lng, pos.Lat);
+    }
 
-    if (std::isnan(pos.Lng) || std::isnan(pos.Lat) ||
-      std::isinf(pos.Lng) || std::isinf(pos.Lat))
+    if (!std::isnan(pos.Lng) && !std::isnan(pos.Lat) && !std::isinf(pos.Lng) && !std::isinf(pos.Lat))
+    {
+      positions.push_back(pos);
+    }
+  }
+
+  return positions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// calculate_rt_positions
+// GTFS-realtime vehicles on the lines drawn on the map, at their reported coordinates (or at their
+// stop when the feed has none); trip, route and stop ids are resolved against the current GTFS feed
+// Min is the trip update's arrival at the vehicle's next stop, BRD while stopped at it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<TrainPosition> calculate_rt_positions(const rt_feed_t& rt)
+{
+  std::vector<TrainPosition> positions;
+  std::shared_ptr<const feed_t> feed = feeds.current();
+  if (!feed)
+  {
+    return positions;
+  }
+  const gtfs_t& gtfs = feed->gtfs;
+  int64_t now = rt.timestamp ? static_cast<int64_t>(rt.timestamp) : static_cast<int64_t>(std::time(nullptr));
+
+  for (size_t idx = 0; idx < rt.vehicles.size(); ++idx)
+  {
+    const rt_vehicle_t& vehicle = rt.vehicles[idx];
+    uint32_t trip = gtfs.find_trip(vehicle.trip_id);
+    uint32_t route = trip != gtfs_none ? gtfs.trips.route[trip] : gtfs.find_route(vehicle.route_id);
+    if (route == gtfs_none)
     {
       continue;
     }
+    std::string line(gtfs.str(gtfs.routes.short_name[route]));
+    if (line_colors.find(line) == line_colors.end())
+    {
+      continue;
+    }
+    uint32_t stop = gtfs.find_stop(vehicle.stop_id);
+    uint32_t station = stop != gtfs_none && gtfs.stops.station[stop] != gtfs_none ? gtfs.stops.station[stop] : stop;
 
-    if (!first)
+    TrainPosition pos;
+    pos.Destination = trip != gtfs_none ? gtfs.str(gtfs.trips.headsign[trip]) : "";
+    pos.LocationName = station != gtfs_none ? std::string(gtfs.str(gtfs.stops.name[station])) : std::string(vehicle.stop_id);
+    pos.Min = "";
+    if (vehicle.status == rt_stopped_at)
     {
-      json << ",";
+      pos.Min = "BRD";
+    }
+    else if (const rt_trip_update_t* update = rt.find_trip_update(vehicle.trip_id))
+    {
+      int64_t arrival = rt.arrival(*update, vehicle.stop_id);
+      if (arrival > 0)
+      {
+        pos.Min = arrival - now < 60 ? "ARR" : std::to_string((arrival - now) / 60);
+      }
+    }
+    pos.Car = "";
+    pos.LineColor = line_colors[line];
+    pos.Scheduled = false;
+    if (vehicle.has_position)
+    {
+      pos.Lng = vehicle.lon;
+      pos.Lat = vehicle.lat;
+    }
+    else if (station != gtfs_none)
+    {
+      pos.Lng = gtfs.stops.lon[station];
+      pos.Lat = gtfs.stops.lat[station];
+    }
+    else
+    {
+      continue;
+    }
+
+    if (!std::isnan(pos.Lng) && !std::isnan(pos.Lat) && !std::isinf(pos.Lng) && !std::isinf(pos.Lat))
+    {
+      positions.push_back(pos);
     }
-    first = false;
-
-    json << "{"
-      << "\"lng\":" << pos.Lng << ","
-      << "\"lat\":" << pos.Lat << ","
-      << "\"destination\":\"" << pos.Destination << "\","
-      << "\"location_name\":\"" << pos.LocationName << "\","
-      << "\"min\":\"" << pos.Min << "\","
-      << "\"car\":\"" << pos.Car << "\","
-      << "\"line_color\":\"" << pos.LineColor << "\""
-      << "}";
   }
 
-  json << "]}";
-  return json.str();
+  return positions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// position_change
+// prediction_change for the GTFS-realtime source: fraction of trains with another destination,
+// stop or arrival time than at the previous poll
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double position_change(const std::vector<TrainPosition>& previous, const std::vector<TrainPosition>& next)
+{
+  if (previous.empty() && next.empty())
+  {
+    return 0;
+  }
+  std::map<std::string, int> count;
+  for (size_t idx = 0; idx < previous.size(); ++idx)
+  {
+    const TrainPosition& pos = previous[idx];
+    ++count[pos.LineColor + "|" + pos.Destination + "|" + pos.LocationName + "|" + pos.Min];
+  }
+  size_t same = 0;
+  for (size_t idx = 0; idx < next.size(); ++idx)
+  {
+    const TrainPosition& pos = next[idx];
+    std::map<std::string, int>::iterator it = count.find(pos.LineColor + "|" + pos.Destination + "|" + pos.LocationName + "|" + pos.Min);
+    if (it != count.end() && it->second > 0)
+    {
+      --it->second;
+      ++same;
+    }
+  }
+  return 1.0 - 2.0 * same / (previous.size() + next.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// replay_predictions
+// feeds a record log through parse_predictions, calculate_positions and generate_train, the work
+// of one update, and reports the time of each stage
+// speed is a multiple of real time (recorded gaps divided by speed); 0 runs as fast as possible
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void print_stage(const std::string& name, std::vector<double>& us)
+{
+  if (us.empty())
+  {
+    return;
+  }
+  std::sort(us.begin(), us.end());
+  double sum = 0;
+  for (size_t idx = 0; idx < us.size(); ++idx)
+  {
+    sum += us[idx];
+  }
+  std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(1)
+    << std::setw(12) << sum / us.size()
+    << std::setw(12) << us[us.size() / 2]
+    << std::setw(12) << us[std::min(us.size() - 1, us.size() * 99 / 100)]
+    << std::setw(12) << us.back() << std::endl;
+}
+
+int replay_predictions(const std::string& file_name, double speed)
+{
+  record_reader_t reader;
+  if (reader.open(file_name) != 0)
+  {
+    return -1;
+  }
+
+  std::vector<double> parse_us;
+  std::vector<double> position_us;
+  std::vector<double> json_us;
+  size_t payload_bytes = 0;
+  size_t stored_bytes = 0;
+  size_t nbr_trains = 0;
+  size_t nbr_positions = 0;
+  int64_t first_time = -1;
+  int result = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point busy = start;
+  std::chrono::steady_clock::duration pipeline = std::chrono::steady_clock::duration::zero();
+
+  log_record_t record;
+  while ((result = reader.next(record)) == 1)
+  {
+    if (first_time < 0)
+    {
+      first_time = record.time;
+    }
+    if (speed > 0)
+    {
+      std::chrono::duration<double, std::milli> offset((record.time - first_time) / speed);
+      std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    std::vector<Prediction> trains;
+    parse_predictions(record.payload, trains);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    std::vector<TrainPosition> positions = calculate_positions(trains);
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    std::string json = generate_train(positions);
+    std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+
+    parse_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    position_us.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+    json_us.push_back(std::chrono::duration<double, std::micro>(t3 - t2).count());
+    pipeline += t3 - t0;
+    busy = t3;
+    payload_bytes += record.payload.size();
+    stored_bytes += record.stored;
+    nbr_trains += trains.size();
+    nbr_positions += positions.size();
+  }
+
+  size_t nbr = parse_us.size();
+  double wall = std::chrono::duration<double>(busy - start).count();
+  double cpu = std::chrono::duration<double>(pipeline).count();
+  std::cout << file_name << ": " << nbr << " records, " << payload_bytes / 1024 << " KB payload, "
+    << stored_bytes / 1024 << " KB in the log";
+  if (nbr)
+  {
+    std::cout << ", " << std::fixed << std::setprecision(1) << (record.time - first_time) / 3600000.0 << " h recorded, "
+      << nbr_trains / nbr << " trains and " << nbr_positions / nbr << " positions per record";
+  }
+  std::cout << std::endl;
+  std::cout << std::left << std::setw(20) << "stage (us)" << std::right << std::setw(12) << "mean" << std::setw(12) << "p50"
+    << std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+  print_stage("parse_predictions", parse_us);
+  print_stage("calculate_positions", position_us);
+  print_stage("generate_train", json_us);
+  if (cpu > 0)
+  {
+    std::cout << "pipeline: " << std::setprecision(1) << nbr / cpu << " records/s, " << payload_bytes / cpu / (1024 * 1024)
+      << " MB/s; wall " << wall << " s" << std::endl;
+  }
+  return result < 0 ? -1 : 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -767,9 +1549,17 @@ namespace Wt
     WApplication* app = WApplication::instance();
     this->addCssRule("body", "margin: 0; padding: 0;");
     this->addCssRule("#" + id(), "position: absolute; top: 0; bottom: 0; width: 100%;");
-    app->useStyleSheet("https://unpkg.com/maplibre-gl@4.7.1/dist/maplibre-gl.css");
-    const std::string library = "https://unpkg.com/maplibre-gl@4.7.1/dist/maplibre-gl.js";
-    app->require(library, "maplibre");
+    if (offline)
+    {
+      app->useStyleSheet("maplibre/maplibre-gl.css");
+      app->require("maplibre/maplibre-gl.js", "maplibre");
+    }
+    else
+    {
+      app->useStyleSheet("https://unpkg.com/maplibre-gl@4.7.1/dist/maplibre-gl.css");
+      const std::string library = "https://unpkg.com/maplibre-gl@4.7.1/dist/maplibre-gl.js";
+      app->require(library, "maplibre");
+    }
   }
 
   WMapLibre::~WMapLibre()
@@ -786,16 +1576,30 @@ namespace Wt
 
     if (flags.test(RenderFlag::Full))
     {
+      wards_ready.wait();
+      red_ready.wait();
+      std::shared_ptr<const line_layer_t> layer = std::atomic_load(&red_line);
+
       std::stringstream js;
 
       /////////////////////////////////////////////////////////////////////////////////////////////////////
       // create map
       /////////////////////////////////////////////////////////////////////////////////////////////////////
 
+      //offline, the style in the docroot names /tiles, /fonts and /sprites; MapLibre fetches them
+      //from a worker, which needs absolute URLs
       js << "const map = new maplibregl.Map({\n"
-        << "  container: " << jsRef() << ",\n"
-        << "  style: 'https://basemaps.cartocdn.com/gl/positron-gl-style/style.json',\n"
-        << "  center: [-77.0369, 38.9072],\n"
+        << "  container: " << jsRef() << ",\n";
+      if (offline)
+      {
+        js << "  style: new URL('style/style.json', window.location.href).href,\n"
+          << "  transformRequest: function(url) { return { url: new URL(url, window.location.href).href }; },\n";
+      }
+      else
+      {
+        js << "  style: 'https://basemaps.cartocdn.com/gl/positron-gl-style/style.json',\n";
+      }
+      js << "  center: [-77.0369, 38.9072],\n"
         << "  zoom: 11\n"
         << "});\n"
 
@@ -937,12 +1741,12 @@ namespace Wt
       // add red line
       /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-      if (!geojson_red.empty())
+      if (!layer->geojson.empty())
       {
         js << "\n// Add Red Line\n";
         js << "map.addSource('red-line', {\n"
           << "  'type': 'geojson',\n"
-          << "  'data': " << geojson_red << "\n"
+          << "  'data': " << layer->geojson << "\n"
           << "});\n\n"
           << "map.addLayer({\n"
           << "  'id': 'red-line-layer',\n"
@@ -1009,7 +1813,10 @@ namespace Wt
         << "      train_popup.remove();\n"
         << "    });\n"
         << "  });\n"
-        << "};\n";
+        << "};\n"
+        << "if (window.last_trains) {\n"
+        << "  window.update_trains(window.last_trains);\n"
+        << "}\n";
 
       //close map.on('load')
       js << "});\n";
@@ -1,6 +1,7 @@
 #include <Wt/WApplication.h>
 #include <Wt/WContainerWidget.h>
 #include <Wt/WCompositeWidget.h>
+#include "update.hh"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -49,18 +50,30 @@ struct Prediction
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// TrainPosition
+// prediction_set_t
+// one poll of the train source, shared by every session; version counts the polls
+// the predictions API fills trains, which each update turns into positions; the GTFS-realtime
+// source gives vehicle positions directly and fills positions instead
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct TrainPosition
+struct prediction_set_t
 {
-  double Lng;
-  double Lat;
-  std::string Destination;
-  std::string LocationName;
-  std::string Min;
-  std::string Car;
-  std::string LineColor;
+  std::vector<Prediction> trains;
+  std::vector<TrainPosition> positions;
+  uint64_t version;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// line_layer_t
+// GeoJSON of a line and its parsed path; replaced as a whole when a GTFS reload changes the line
+// version 0 is the file read at startup, later versions are the feed_t version that produced them
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct line_layer_t
+{
+  std::string geojson;
+  std::vector<std::pair<double, double>> path;
+  uint64_t version;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -95,6 +108,7 @@ public:
 private:
   Wt::WMapLibre* map;
   Wt::WContainerWidget* map_container;
-  Wt::WTimer* timer;
+  uint64_t red_version; //line_layer_t version shown by this session
+  uint64_t update_version; //train_update_t version shown by this session
   void update_predictions();
 };
@@ -0,0 +1,785 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <zlib.h>
+#include "asio.hpp"
+#include "asio/ssl.hpp"
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// wmata_mock
+// local stand-in for api.wmata.com over TLS, for development without a key and for load tests
+// serves
+//   /StationPrediction.svc/json/GetPrediction/{All|codes}
+//   /Rail.svc/json/jStations?LineCode=XX
+//   /gtfs/rail-gtfs-static.zip
+//   /gtfs/rail-gtfsrt-vehiclepositions.pb, /gtfs/rail-gtfsrt-tripupdates.pb
+// from recorded fixtures in the fixture directory (predictions_All.json, stations_XX.json,
+// gtfs.zip or a gtfs/ folder, gtfsrt_*.pb, as written by http_client), or from a synthetic train generator
+// point the clients at it with "API_HOST": "localhost", "API_PORT": 8443 in config.json
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const std::vector<std::string> line_codes = { "RD", "OR", "SV", "BL", "YL", "GR" };
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_options_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_options_t
+{
+  std::string address = "127.0.0.1";
+  unsigned short port = 8443;
+  std::string fixtures = "data";
+  std::string cert; //PEM files; a self-signed certificate for localhost is generated if empty
+  std::string key;
+  bool synthetic = false; //generate predictions even when a fixture exists
+  int trains = 12; //synthetic trains per line
+  int latency = 0; //ms added before each response
+  int jitter = 0; //ms, uniform on top of latency
+  double error_rate = 0; //fraction of requests answered with error_status
+  int error_status = 503;
+  size_t threads = 1;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_station_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_station_t
+{
+  std::string code;
+  std::string name;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_data_t
+// everything served, loaded once at startup and read only afterwards
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_data_t
+{
+  std::string predictions; //fixture, empty for synthetic
+  std::map<std::string, std::string> stations_json; //line code -> jStations response
+  std::map<std::string, std::vector<mock_station_t>> stations; //line code -> stations in file order
+  std::shared_ptr<const std::string> gtfs_zip;
+  std::string gtfs_etag;
+  std::map<std::string, std::shared_ptr<const std::string>> realtime; //GTFS-realtime path -> fixture
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_stats_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_stats_t
+{
+  std::atomic<uint64_t> requests{ 0 };
+  std::atomic<uint64_t> errors{ 0 };
+  std::atomic<uint64_t> not_modified{ 0 };
+  std::atomic<uint64_t> bytes{ 0 };
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// read_file
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int read_file(const std::string& file_name, std::string& data)
+{
+  std::ifstream ifs(file_name, std::ios::binary);
+  if (!ifs.is_open())
+  {
+    return -1;
+  }
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  data = ss.str();
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// json_string_values
+// every "key":"value" of a flat scan, in order; enough for the WMATA station lists
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> json_string_values(const std::string& json, const std::string& key)
+{
+  std::vector<std::string> values;
+  std::string pattern = "\"" + key + "\":\"";
+  size_t pos = 0;
+  while ((pos = json.find(pattern, pos)) != std::string::npos)
+  {
+    pos += pattern.size();
+    size_t end = json.find('"', pos);
+    if (end == std::string::npos)
+    {
+      break;
+    }
+    values.push_back(json.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  return values;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_stored
+// a zip archive of files, uncompressed, so a gtfs/ folder can be served as the feed zip
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void put16(std::string& out, uint32_t value)
+{
+  out += static_cast<char>(value & 0xff);
+  out += static_cast<char>((value >> 8) & 0xff);
+}
+
+void put32(std::string& out, uint32_t value)
+{
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+std::string zip_stored(const std::vector<std::pair<std::string, std::string>>& files)
+{
+  std::string zip;
+  std::string directory;
+  for (size_t idx = 0; idx < files.size(); ++idx)
+  {
+    const std::string& name = files[idx].first;
+    const std::string& data = files[idx].second;
+    uint32_t crc = static_cast<uint32_t>(crc32_z(0, reinterpret_cast<const Bytef*>(data.data()), data.size()));
+    uint32_t offset = static_cast<uint32_t>(zip.size());
+
+    put32(zip, 0x04034b50);
+    put16(zip, 10); put16(zip, 0); put16(zip, 0); put16(zip, 0); put16(zip, 0x21);
+    put32(zip, crc); put32(zip, static_cast<uint32_t>(data.size())); put32(zip, static_cast<uint32_t>(data.size()));
+    put16(zip, static_cast<uint32_t>(name.size())); put16(zip, 0);
+    zip += name;
+    zip += data;
+
+    put32(directory, 0x02014b50);
+    put16(directory, 20); put16(directory, 10); put16(directory, 0); put16(directory, 0); put16(directory, 0); put16(directory, 0x21);
+    put32(directory, crc); put32(directory, static_cast<uint32_t>(data.size())); put32(directory, static_cast<uint32_t>(data.size()));
+    put16(directory, static_cast<uint32_t>(name.size())); put16(directory, 0); put16(directory, 0);
+    put16(directory, 0); put16(directory, 0); put32(directory, 0); put32(directory, offset);
+    directory += name;
+  }
+  uint32_t directory_offset = static_cast<uint32_t>(zip.size());
+  zip += directory;
+  put32(zip, 0x06054b50);
+  put16(zip, 0); put16(zip, 0);
+  put16(zip, static_cast<uint32_t>(files.size())); put16(zip, static_cast<uint32_t>(files.size()));
+  put32(zip, static_cast<uint32_t>(directory.size())); put32(zip, directory_offset);
+  put16(zip, 0);
+  return zip;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// load_fixtures
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void load_fixtures(const mock_options_t& options, mock_data_t& data)
+{
+  const std::string& dir = options.fixtures;
+  if (!options.synthetic && read_file(dir + "/predictions_All.json", data.predictions) == 0)
+  {
+    std::cout << "predictions: " << dir << "/predictions_All.json" << std::endl;
+  }
+  else
+  {
+    data.predictions.clear();
+    std::cout << "predictions: synthetic, " << options.trains << " trains per line" << std::endl;
+  }
+
+  for (size_t idx = 0; idx < line_codes.size(); ++idx)
+  {
+    const std::string& line = line_codes[idx];
+    std::string json;
+    std::vector<mock_station_t>& list = data.stations[line];
+    if (read_file(dir + "/stations_" + line + ".json", json) == 0)
+    {
+      std::vector<std::string> codes = json_string_values(json, "Code");
+      std::vector<std::string> names = json_string_values(json, "Name");
+      for (size_t jdx = 0; jdx < codes.size() && jdx < names.size(); ++jdx)
+      {
+        list.push_back(mock_station_t{ codes[jdx], names[jdx] });
+      }
+    }
+    else
+    {
+      //no fixture: made up stations, so predictions still have somewhere to be
+      std::stringstream stations;
+      stations << "{\"Stations\":[";
+      for (int jdx = 0; jdx < 20; ++jdx)
+      {
+        std::stringstream code;
+        code << static_cast<char>('A' + idx) << std::setw(2) << std::setfill('0') << jdx + 1;
+        std::string name = line + " station " + std::to_string(jdx + 1);
+        list.push_back(mock_station_t{ code.str(), name });
+        stations << (jdx ? "," : "") << "{\"Code\":\"" << code.str() << "\",\"Name\":\"" << name << "\",\"LineCode1\":\"" << line
+          << "\",\"Lat\":" << 38.9 + 0.01 * jdx << ",\"Lon\":" << -77.0 + 0.01 * static_cast<int>(idx) << "}";
+      }
+      stations << "]}";
+      json = stations.str();
+    }
+    data.stations_json[line] = json;
+  }
+
+  std::string zip;
+  if (read_file(dir + "/gtfs.zip", zip) != 0)
+  {
+    const char* tables[] = { "agency.txt", "calendar.txt", "calendar_dates.txt", "feed_info.txt", "levels.txt", "pathways.txt",
+      "routes.txt", "shapes.txt", "stop_times.txt", "stops.txt", "trips.txt" };
+    std::vector<std::pair<std::string, std::string>> files;
+    for (size_t idx = 0; idx < sizeof(tables) / sizeof(tables[0]); ++idx)
+    {
+      std::string table;
+      if (read_file(dir + "/gtfs/" + tables[idx], table) == 0)
+      {
+        files.push_back(std::make_pair(std::string(tables[idx]), table));
+      }
+    }
+    zip = zip_stored(files);
+  }
+  const char* realtime[][2] = { { "/gtfs/rail-gtfsrt-vehiclepositions.pb", "gtfsrt_vehiclepositions.pb" },
+    { "/gtfs/rail-gtfsrt-tripupdates.pb", "gtfsrt_tripupdates.pb" } };
+  for (size_t idx = 0; idx < 2; ++idx)
+  {
+    std::string feed;
+    if (read_file(dir + "/" + realtime[idx][1], feed) == 0)
+    {
+      data.realtime[realtime[idx][0]] = std::make_shared<const std::string>(std::move(feed));
+      std::cout << "GTFS-realtime: " << dir << "/" << realtime[idx][1] << std::endl;
+    }
+  }
+
+  std::stringstream etag;
+  etag << "\"" << std::hex << crc32_z(0, reinterpret_cast<const Bytef*>(zip.data()), zip.size()) << "-" << zip.size() << "\"";
+  data.gtfs_etag = etag.str();
+  data.gtfs_zip = std::make_shared<const std::string>(std::move(zip));
+  std::cout << "gtfs: " << data.gtfs_zip->size() / 1024 << " KB" << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// synthetic_predictions
+// trains shuttle end to end along each line, two minutes per station; each reports its next three
+// stations, so the answer changes every few seconds like the real one
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string synthetic_predictions(const mock_data_t& data, const mock_options_t& options, const std::vector<std::string>& codes)
+{
+  const int seconds_per_station = 120;
+  long long now = static_cast<long long>(std::time(nullptr));
+  bool all = codes.empty();
+
+  std::stringstream json;
+  json << "{\"Trains\":[";
+  bool first = true;
+  for (size_t idx = 0; idx < line_codes.size(); ++idx)
+  {
+    const std::string& line = line_codes[idx];
+    const std::vector<mock_station_t>& list = data.stations.at(line);
+    if (list.size() < 2)
+    {
+      continue;
+    }
+    long long nbr = static_cast<long long>(list.size());
+    long long cycle = 2 * (nbr - 1) * seconds_per_station;
+    for (int train = 0; train < options.trains; ++train)
+    {
+      //position on the round trip, in seconds
+      long long t = (now + train * cycle / options.trains + static_cast<long long>(idx) * 37) % cycle;
+      bool outbound = t < cycle / 2;
+      long long along = outbound ? t : t - cycle / 2;
+      long long segment = along / seconds_per_station;
+      long long into = along % seconds_per_station;
+      const mock_station_t& destination = outbound ? list.back() : list.front();
+      for (long long ahead = 1; ahead <= 3 && segment + ahead < nbr; ++ahead)
+      {
+        long long pos = segment + ahead;
+        const mock_station_t& station = outbound ? list[static_cast<size_t>(pos)] : list[static_cast<size_t>(nbr - 1 - pos)];
+        if (!all && std::find(codes.begin(), codes.end(), station.code) == codes.end())
+        {
+          continue;
+        }
+        long long seconds = ahead * seconds_per_station - into;
+        std::string min = seconds < 30 ? "BRD" : seconds < 60 ? "ARR" : std::to_string(seconds / 60);
+        json << (first ? "" : ",")
+          << "{\"Car\":\"" << (train % 3 == 0 ? "6" : "8") << "\""
+          << ",\"Destination\":\"" << destination.name << "\""
+          << ",\"DestinationCode\":\"" << destination.code << "\""
+          << ",\"DestinationName\":\"" << destination.name << "\""
+          << ",\"Group\":\"" << (outbound ? "1" : "2") << "\""
+          << ",\"Line\":\"" << line << "\""
+          << ",\"LocationCode\":\"" << station.code << "\""
+          << ",\"LocationName\":\"" << station.name << "\""
+          << ",\"Min\":\"" << min << "\"}";
+        first = false;
+      }
+    }
+  }
+  json << "]}";
+  return json.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// self_signed
+// EC P-256 key and a one year certificate for CN=localhost
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int self_signed(SSL_CTX* ctx)
+{
+  EVP_PKEY* pkey = nullptr;
+  EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  if (!pctx || EVP_PKEY_keygen_init(pctx) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+    EVP_PKEY_keygen(pctx, &pkey) <= 0)
+  {
+    EVP_PKEY_CTX_free(pctx);
+    return -1;
+  }
+  EVP_PKEY_CTX_free(pctx);
+
+  X509* x509 = X509_new();
+  X509_set_version(x509, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(x509), static_cast<long>(std::time(nullptr)));
+  X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+  X509_gmtime_adj(X509_getm_notAfter(x509), 365L * 24 * 3600);
+  X509_set_pubkey(x509, pkey);
+  X509_NAME* name = X509_get_subject_name(x509);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(x509, name);
+  int result = X509_sign(x509, pkey, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, x509) == 1 &&
+    SSL_CTX_use_PrivateKey(ctx, pkey) == 1 ? 0 : -1;
+  X509_free(x509);
+  EVP_PKEY_free(pkey);
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_server_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_server_t
+{
+  mock_server_t(const mock_options_t& options_, const mock_data_t& data_) :
+    options(options_),
+    data(data_),
+    ssl(asio::ssl::context::tls_server),
+    acceptor(io),
+    seed(0)
+  {
+  }
+  const mock_options_t& options;
+  const mock_data_t& data;
+  asio::io_context io;
+  asio::ssl::context ssl;
+  asio::ip::tcp::acceptor acceptor;
+  mock_stats_t stats;
+  std::atomic<uint32_t> seed;
+  void accept();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_session_t
+// one connection: handshake, one request, one response, close
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct mock_session_t : public std::enable_shared_from_this<mock_session_t>
+{
+  mock_session_t(mock_server_t& server_, asio::ip::tcp::socket socket) :
+    server(server_),
+    sock(std::move(socket), server_.ssl),
+    timer(server_.io),
+    random(server_.seed++)
+  {
+  }
+  mock_server_t& server;
+  asio::ssl::stream<asio::ip::tcp::socket> sock;
+  asio::steady_timer timer;
+  asio::streambuf sbuf;
+  std::mt19937 random;
+  std::string header;
+  std::shared_ptr<const std::string> body; //kept alive until the write completes
+  size_t body_offset = 0;
+  size_t body_size = 0;
+
+  void start();
+  void respond(const std::string& method, const std::string& target, const std::map<std::string, std::string>& fields);
+  void send(int status, const std::string& content_type, std::shared_ptr<const std::string> content,
+    const std::string& etag, const std::map<std::string, std::string>& fields);
+  void write();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_server_t::accept
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mock_server_t::accept()
+{
+  acceptor.async_accept([this](const asio::error_code& ec, asio::ip::tcp::socket socket)
+    {
+      if (!ec)
+      {
+        std::make_shared<mock_session_t>(*this, std::move(socket))->start();
+      }
+      if (acceptor.is_open())
+      {
+        accept();
+      }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_session_t::start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mock_session_t::start()
+{
+  std::shared_ptr<mock_session_t> self = shared_from_this();
+  sock.async_handshake(asio::ssl::stream_base::server, [self](const asio::error_code& ec)
+    {
+      if (ec)
+      {
+        return;
+      }
+      asio::async_read_until(self->sock, self->sbuf, "\r\n\r\n", [self](const asio::error_code& ec, size_t size)
+        {
+          if (ec)
+          {
+            return;
+          }
+          std::string text(asio::buffers_begin(self->sbuf.data()), asio::buffers_begin(self->sbuf.data()) + size);
+          std::istringstream lines(text);
+          std::string line;
+          std::string method;
+          std::string target;
+          std::getline(lines, line);
+          std::istringstream(line) >> method >> target;
+          std::map<std::string, std::string> fields;
+          while (std::getline(lines, line) && line != "\r")
+          {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+            {
+              continue;
+            }
+            std::string name = line.substr(0, colon);
+            for (size_t idx = 0; idx < name.size(); ++idx)
+            {
+              name[idx] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[idx])));
+            }
+            size_t first = line.find_first_not_of(" \t", colon + 1);
+            size_t last = line.find_last_not_of(" \t\r");
+            fields[name] = first == std::string::npos || last < first ? "" : line.substr(first, last - first + 1);
+          }
+
+          //configured latency, then the answer
+          const mock_options_t& options = self->server.options;
+          int delay = options.latency + (options.jitter > 0 ? static_cast<int>(self->random() % (options.jitter + 1)) : 0);
+          self->timer.expires_after(std::chrono::milliseconds(delay));
+          self->timer.async_wait([self, method, target, fields](const asio::error_code&)
+            {
+              self->respond(method, target, fields);
+            });
+        });
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_session_t::respond
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mock_session_t::respond(const std::string& method, const std::string& target, const std::map<std::string, std::string>& fields)
+{
+  const mock_options_t& options = server.options;
+  const mock_data_t& data = server.data;
+  std::map<std::string, std::string> none;
+  ++server.stats.requests;
+
+  if (method != "GET")
+  {
+    send(405, "text/plain", std::make_shared<const std::string>("method not allowed\n"), "", none);
+    return;
+  }
+  if (fields.find("api_key") == fields.end())
+  {
+    send(401, "application/json", std::make_shared<const std::string>("{\"statusCode\": 401, \"message\": \"Access denied due to missing subscription key.\"}"), "", none);
+    return;
+  }
+  if (options.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(random) < options.error_rate)
+  {
+    ++server.stats.errors;
+    send(options.error_status, "text/plain", std::make_shared<const std::string>("injected error\n"), "", none);
+    return;
+  }
+
+  const std::string predictions_path = "/StationPrediction.svc/json/GetPrediction/";
+  const std::string stations_path = "/Rail.svc/json/jStations";
+  if (target.compare(0, predictions_path.size(), predictions_path) == 0)
+  {
+    std::string list = target.substr(predictions_path.size());
+    std::vector<std::string> codes;
+    if (list != "All")
+    {
+      std::stringstream ss(list);
+      std::string code;
+      while (std::getline(ss, code, ','))
+      {
+        codes.push_back(code);
+      }
+    }
+    std::string json = data.predictions.empty() ? synthetic_predictions(data, options, codes) : data.predictions;
+    send(200, "application/json; charset=utf-8", std::make_shared<const std::string>(std::move(json)), "", none);
+  }
+  else if (target.compare(0, stations_path.size(), stations_path) == 0)
+  {
+    size_t pos = target.find("LineCode=");
+    std::string line = pos == std::string::npos ? "" : target.substr(pos + 9, 2);
+    std::map<std::string, std::string>::const_iterator it = data.stations_json.find(line);
+    if (it == data.stations_json.end())
+    {
+      send(400, "application/json", std::make_shared<const std::string>("{\"Message\":\"Invalid LineCode\"}"), "", none);
+      return;
+    }
+    std::stringstream etag;
+    etag << "\"" << std::hex << crc32_z(0, reinterpret_cast<const Bytef*>(it->second.data()), it->second.size()) << "\"";
+    send(200, "application/json; charset=utf-8", std::make_shared<const std::string>(it->second), etag.str(), fields);
+  }
+  else if (target == "/gtfs/rail-gtfs-static.zip")
+  {
+    send(200, "application/zip", data.gtfs_zip, data.gtfs_etag, fields);
+  }
+  else if (data.realtime.find(target) != data.realtime.end())
+  {
+    send(200, "application/x-protobuf", data.realtime.at(target), "", none);
+  }
+  else
+  {
+    send(404, "text/plain", std::make_shared<const std::string>("not found\n"), "", none);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_session_t::send
+// with an etag, honour If-None-Match (304) and Range with If-Range (206), like the real API's CDN
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mock_session_t::send(int status, const std::string& content_type, std::shared_ptr<const std::string> content,
+  const std::string& etag, const std::map<std::string, std::string>& fields)
+{
+  body = content;
+  body_offset = 0;
+  body_size = content->size();
+  std::string reason = status == 200 ? "OK" : status == 206 ? "Partial Content" : status == 304 ? "Not Modified" :
+    status == 401 ? "Unauthorized" : status == 404 ? "Not Found" : status == 429 ? "Too Many Requests" : status == 503 ? "Service Unavailable" : "Error";
+  std::string extra;
+
+  if (!etag.empty())
+  {
+    std::map<std::string, std::string>::const_iterator match = fields.find("if-none-match");
+    std::map<std::string, std::string>::const_iterator range = fields.find("range");
+    std::map<std::string, std::string>::const_iterator if_range = fields.find("if-range");
+    if (match != fields.end() && match->second == etag)
+    {
+      status = 304;
+      reason = "Not Modified";
+      body_size = 0;
+      ++server.stats.not_modified;
+    }
+    else if (range != fields.end() && range->second.compare(0, 6, "bytes=") == 0 && (if_range == fields.end() || if_range->second == etag))
+    {
+      size_t first = static_cast<size_t>(std::strtoull(range->second.c_str() + 6, nullptr, 10));
+      if (first < content->size())
+      {
+        status = 206;
+        reason = "Partial Content";
+        body_offset = first;
+        body_size = content->size() - first;
+        extra = "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(content->size() - 1) + "/" + std::to_string(content->size()) + "\r\n";
+      }
+    }
+    extra += "ETag: " + etag + "\r\nAccept-Ranges: bytes\r\n";
+  }
+
+  std::stringstream http;
+  http << "HTTP/1.1 " << status << " " << reason << "\r\n";
+  http << "Content-Type: " << content_type << "\r\n";
+  http << "Content-Length: " << body_size << "\r\n";
+  http << extra;
+  http << "Connection: close\r\n\r\n";
+  header = http.str();
+  server.stats.bytes += header.size() + body_size;
+  write();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// mock_session_t::write
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mock_session_t::write()
+{
+  std::shared_ptr<mock_session_t> self = shared_from_this();
+  std::vector<asio::const_buffer> buffers;
+  buffers.push_back(asio::buffer(header));
+  buffers.push_back(asio::buffer(body->data() + body_offset, body_size));
+  asio::async_write(sock, buffers, [self](const asio::error_code& ec, size_t)
+    {
+      if (ec)
+      {
+        return;
+      }
+      self->sock.async_shutdown([self](const asio::error_code&)
+        {
+          asio::error_code ignored;
+          self->sock.lowest_layer().close(ignored);
+        });
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage()
+{
+  std::cout << "usage: wmata_mock [--address 127.0.0.1] [--port 8443] [--fixtures data] [--synthetic] [--trains 12]" << std::endl;
+  std::cout << "                  [--latency ms] [--jitter ms] [--error-rate 0..1] [--error-status 503]" << std::endl;
+  std::cout << "                  [--threads n] [--cert cert.pem --key key.pem]" << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  mock_options_t options;
+  for (int idx = 1; idx < argc; ++idx)
+  {
+    std::string arg = argv[idx];
+    bool has_value = idx + 1 < argc;
+    if (arg == "--synthetic")
+    {
+      options.synthetic = true;
+    }
+    else if (arg == "--address" && has_value)
+    {
+      options.address = argv[++idx];
+    }
+    else if (arg == "--port" && has_value)
+    {
+      options.port = static_cast<unsigned short>(std::atoi(argv[++idx]));
+    }
+    else if (arg == "--fixtures" && has_value)
+    {
+      options.fixtures = argv[++idx];
+    }
+    else if (arg == "--trains" && has_value)
+    {
+      options.trains = std::max(1, std::atoi(argv[++idx]));
+    }
+    else if (arg == "--latency" && has_value)
+    {
+      options.latency = std::max(0, std::atoi(argv[++idx]));
+    }
+    else if (arg == "--jitter" && has_value)
+    {
+      options.jitter = std::max(0, std::atoi(argv[++idx]));
+    }
+    else if (arg == "--error-rate" && has_value)
+    {
+      options.error_rate = std::atof(argv[++idx]);
+    }
+    else if (arg == "--error-status" && has_value)
+    {
+      options.error_status = std::atoi(argv[++idx]);
+    }
+    else if (arg == "--threads" && has_value)
+    {
+      options.threads = static_cast<size_t>(std::max(1, std::atoi(argv[++idx])));
+    }
+    else if (arg == "--cert" && has_value)
+    {
+      options.cert = argv[++idx];
+    }
+    else if (arg == "--key" && has_value)
+    {
+      options.key = argv[++idx];
+    }
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  mock_data_t data;
+  load_fixtures(options, data);
+
+  try
+  {
+    mock_server_t server(options, data);
+    if (!options.cert.empty())
+    {
+      server.ssl.use_certificate_chain_file(options.cert);
+      server.ssl.use_private_key_file(options.key.empty() ? options.cert : options.key, asio::ssl::context::pem);
+    }
+    else if (self_signed(server.ssl.native_handle()) != 0)
+    {
+      std::cout << "cannot create a certificate" << std::endl;
+      return 1;
+    }
+
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address(options.address), options.port);
+    server.acceptor.open(endpoint.protocol());
+    server.acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+    server.acceptor.bind(endpoint);
+    server.acceptor.listen();
+    server.accept();
+
+    asio::signal_set signals(server.io, SIGINT, SIGTERM);
+    signals.async_wait([&server](const asio::error_code&, int)
+      {
+        asio::error_code ignored;
+        server.acceptor.close(ignored);
+        server.io.stop();
+      });
+
+    std::cout << "wmata_mock on https://" << options.address << ":" << options.port << ", latency " << options.latency
+      << "+" << options.jitter << " ms, error rate " << options.error_rate << std::endl;
+
+    std::vector<std::thread> threads;
+    for (size_t idx = 1; idx < options.threads; ++idx)
+    {
+      threads.emplace_back([&server]() { server.io.run(); });
+    }
+    server.io.run();
+    for (size_t idx = 0; idx < threads.size(); ++idx)
+    {
+      threads[idx].join();
+    }
+
+    std::cout << server.stats.requests << " requests, " << server.stats.errors << " injected errors, "
+      << server.stats.not_modified << " not modified, " << server.stats.bytes / 1024 << " KB sent" << std::endl;
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
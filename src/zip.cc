@@ -0,0 +1,323 @@
+#include <cstring>
+#include <algorithm>
+#include <zlib.h>
+#include "zip.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// record signatures and fixed sizes (APPNOTE.TXT)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t sig_local = 0x04034b50;
+const uint32_t sig_central = 0x02014b50;
+const uint32_t sig_end = 0x06054b50;
+const uint32_t sig_end64 = 0x06064b50;
+const uint32_t sig_locator64 = 0x07064b50;
+const size_t local_size = 30;
+const size_t central_size = 46;
+const size_t end_size = 22;
+const size_t end64_size = 56;
+const size_t locator64_size = 20;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// little endian readers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t read16(const unsigned char* p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t read32(const unsigned char* p)
+{
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+    (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t read64(const unsigned char* p)
+{
+  return static_cast<uint64_t>(read32(p)) | (static_cast<uint64_t>(read32(p + 4)) << 32);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// is_zip_path
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool is_zip_path(const std::string& path)
+{
+  return path.size() > 4 && (path.compare(path.size() - 4, 4, ".zip") == 0 || path.compare(path.size() - 4, 4, ".ZIP") == 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::zip_reader_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+zip_reader_t::zip_reader_t() :
+  buf(nullptr),
+  len(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::open
+// map an archive on disk
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int zip_reader_t::open(const std::string& file_name)
+{
+  entries.clear();
+  if (file.open(file_name) != 0)
+  {
+    return -1;
+  }
+  buf = reinterpret_cast<const unsigned char*>(file.data());
+  len = file.size();
+  return read_directory();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::open
+// archive already in memory; data must outlive the reader
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int zip_reader_t::open(const char* data, size_t size)
+{
+  entries.clear();
+  file.close();
+  buf = reinterpret_cast<const unsigned char*>(data);
+  len = size;
+  return read_directory();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::read_directory
+// locate the end of central directory record and list the members
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int zip_reader_t::read_directory()
+{
+  if (!buf || len < end_size)
+  {
+    return -1;
+  }
+
+  //the end record is followed by a comment of at most 64 KB
+  size_t end = zip_npos;
+  size_t lowest = len > end_size + 0xffff ? len - end_size - 0xffff : 0;
+  for (size_t pos = len - end_size + 1; pos-- > lowest;)
+  {
+    if (read32(buf + pos) == sig_end)
+    {
+      end = pos;
+      break;
+    }
+  }
+  if (end == zip_npos)
+  {
+    return -1;
+  }
+
+  uint64_t nbr_entries = read16(buf + end + 10);
+  uint64_t dir_size = read32(buf + end + 12);
+  uint64_t dir_offset = read32(buf + end + 16);
+  size_t dir_end = end;
+
+  if (end >= locator64_size && read32(buf + end - locator64_size) == sig_locator64)
+  {
+    size_t locator = end - locator64_size;
+    uint64_t end64 = read64(buf + locator + 8);
+    if (end64 + end64_size > locator || read32(buf + end64) != sig_end64)
+    {
+      //data prepended to the archive: the record normally sits right before the locator
+      if (locator < end64_size || read32(buf + locator - end64_size) != sig_end64)
+      {
+        return -1;
+      }
+      end64 = locator - end64_size;
+    }
+    nbr_entries = read64(buf + end64 + 32);
+    dir_size = read64(buf + end64 + 40);
+    dir_offset = read64(buf + end64 + 48);
+    dir_end = static_cast<size_t>(end64);
+  }
+
+  //offsets in the archive are relative to its first byte, which need not be the first byte of buf
+  if (dir_size > dir_end || dir_offset > dir_end - dir_size)
+  {
+    return -1;
+  }
+  uint64_t base = dir_end - dir_size - dir_offset;
+
+  size_t pos = static_cast<size_t>(base + dir_offset);
+  entries.reserve(static_cast<size_t>(std::min<uint64_t>(nbr_entries, dir_size / central_size)));
+  for (uint64_t idx = 0; idx < nbr_entries; ++idx)
+  {
+    if (pos + central_size > dir_end || read32(buf + pos) != sig_central)
+    {
+      entries.clear();
+      return -1;
+    }
+    const unsigned char* p = buf + pos;
+    uint16_t name_len = read16(p + 28);
+    uint16_t extra_len = read16(p + 30);
+    uint16_t comment_len = read16(p + 32);
+    if (pos + central_size + name_len + extra_len + comment_len > dir_end)
+    {
+      entries.clear();
+      return -1;
+    }
+
+    zip_entry_t entry;
+    entry.name.assign(reinterpret_cast<const char*>(p + central_size), name_len);
+    entry.method = read16(p + 10);
+    entry.crc = read32(p + 16);
+    entry.compressed_size = read32(p + 20);
+    entry.size = read32(p + 24);
+    entry.offset = read32(p + 42);
+
+    //zip64 extended information: 8 byte values, present only for the fields saturated above
+    const unsigned char* extra = p + central_size + name_len;
+    const unsigned char* extra_end = extra + extra_len;
+    while (extra + 4 <= extra_end)
+    {
+      uint16_t id = read16(extra);
+      uint16_t size = read16(extra + 2);
+      const unsigned char* field = extra + 4;
+      if (field + size > extra_end)
+      {
+        break;
+      }
+      if (id == 0x0001)
+      {
+        const unsigned char* value = field;
+        if (entry.size == 0xffffffff && value + 8 <= field + size)
+        {
+          entry.size = read64(value);
+          value += 8;
+        }
+        if (entry.compressed_size == 0xffffffff && value + 8 <= field + size)
+        {
+          entry.compressed_size = read64(value);
+          value += 8;
+        }
+        if (entry.offset == 0xffffffff && value + 8 <= field + size)
+        {
+          entry.offset = read64(value);
+        }
+      }
+      extra = field + size;
+    }
+    entry.offset += base;
+    entries.push_back(entry);
+    pos += central_size + name_len + extra_len + comment_len;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::find
+// member whose name, or name after the last '/', is name; zip_npos if none
+// feeds are sometimes zipped with their enclosing folder
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t zip_reader_t::find(std::string_view name) const
+{
+  size_t found = zip_npos;
+  for (size_t idx = 0; idx < entries.size(); ++idx)
+  {
+    std::string_view entry_name(entries[idx].name);
+    if (entry_name == name)
+    {
+      return idx;
+    }
+    size_t slash = entry_name.rfind('/');
+    if (found == zip_npos && slash != std::string_view::npos && entry_name.substr(slash + 1) == name)
+    {
+      found = idx;
+    }
+  }
+  return found;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t::read
+// decompress member idx into out
+// returns -1 on an unsupported method, a truncated or corrupt member, or a CRC mismatch
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int zip_reader_t::read(size_t idx, std::string& out) const
+{
+  out.clear();
+  if (idx >= entries.size())
+  {
+    return -1;
+  }
+  const zip_entry_t& entry = entries[idx];
+  if (entry.offset + local_size > len || read32(buf + entry.offset) != sig_local)
+  {
+    return -1;
+  }
+  //the local header repeats name and extra field, possibly with a different extra length
+  const unsigned char* p = buf + entry.offset;
+  uint64_t data = entry.offset + local_size + read16(p + 26) + read16(p + 28);
+  if (data > len || entry.compressed_size > len - data)
+  {
+    return -1;
+  }
+  if ((entry.method != 0 && entry.method != 8) || (entry.method == 0 && entry.compressed_size != entry.size))
+  {
+    return -1;
+  }
+  const unsigned char* src = buf + data;
+  out.resize(static_cast<size_t>(entry.size));
+
+  if (entry.method == 0)
+  {
+    std::memcpy(&out[0], src, out.size());
+  }
+  else if (entry.size > 0)
+  {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+      out.clear();
+      return -1;
+    }
+
+    //avail_in and avail_out are 32 bit; feed members over 4 GB in slices
+    const uInt slice = 1u << 30;
+    uint64_t in_left = entry.compressed_size;
+    uint64_t out_left = entry.size;
+    stream.next_in = const_cast<Bytef*>(src);
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    int result = Z_OK;
+    while (result == Z_OK)
+    {
+      if (stream.avail_in == 0)
+      {
+        stream.avail_in = static_cast<uInt>(std::min<uint64_t>(in_left, slice));
+        in_left -= stream.avail_in;
+      }
+      if (stream.avail_out == 0)
+      {
+        stream.avail_out = static_cast<uInt>(std::min<uint64_t>(out_left, slice));
+        out_left -= stream.avail_out;
+      }
+      result = inflate(&stream, Z_NO_FLUSH);
+    }
+    uint64_t produced = stream.total_out;
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || produced != entry.size)
+    {
+      out.clear();
+      return -1;
+    }
+  }
+
+  if (crc32_z(0, reinterpret_cast<const Bytef*>(out.data()), out.size()) != entry.crc)
+  {
+    out.clear();
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef ZIP_HH
+#define ZIP_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include "csv.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_entry_t
+// one member of the central directory; offset is the local file header
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct zip_entry_t
+{
+  std::string name;
+  uint16_t method; //0 stored, 8 deflate
+  uint32_t crc;
+  uint64_t compressed_size;
+  uint64_t size;
+  uint64_t offset;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// zip_reader_t
+// reads members of a ZIP archive in place, from a mapped file or from a buffer such as a
+// downloaded response body, without extracting to disk
+// read() inflates one member straight into the output string (zlib raw inflate) and checks its
+// CRC-32; only the member being read is ever decompressed
+// data before the archive (a self extracting stub, stray HTTP headers) is skipped; zip64 sizes
+// and offsets are supported, encryption and multi disk archives are not
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class zip_reader_t
+{
+public:
+  zip_reader_t();
+  int open(const std::string& file_name);
+  int open(const char* data, size_t size);
+  size_t size() const { return entries.size(); }
+  const zip_entry_t& entry(size_t idx) const { return entries[idx]; }
+  size_t find(std::string_view name) const;
+  int read(size_t idx, std::string& out) const;
+
+private:
+  zip_reader_t(const zip_reader_t&) = delete;
+  zip_reader_t& operator=(const zip_reader_t&) = delete;
+  int read_directory();
+  mmap_file_t file;
+  const unsigned char* buf;
+  size_t len;
+  std::vector<zip_entry_t> entries;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const size_t zip_npos = static_cast<size_t>(-1);
+bool is_zip_path(const std::string& path);
+
+#endif